@@ -0,0 +1,11 @@
+{
+  "targets": [
+    {
+      "target_name": "ward_statistics",
+      "sources": ["ward_statistics.cc", "ward_statistics_addon.cc"],
+      "cflags_cc": ["-std=c++14", "-O3", "-Wall"],
+      "cflags_cc!": ["-fno-exceptions"],
+      "libraries": ["-lpthread"]
+    }
+  ]
+}
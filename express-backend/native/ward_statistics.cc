@@ -0,0 +1,448 @@
+#include "ward_statistics.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+struct StatusName {
+  const char* name;
+  const char* label;
+};
+
+const StatusName kStatuses[kComplaintStatusCount] = {
+    {"Submitted", "Submitted"}, {"Under_Review", "Under Review"},
+    {"Assigned", "Assigned"},   {"In_Progress", "In Progress"},
+    {"Resolved", "Resolved"},   {"Closed", "Closed"},
+    {"Rejected", "Rejected"},
+};
+
+bool Equals(const char* text, size_t length, const char* name) {
+  return strlen(name) == length && memcmp(text, name, length) == 0;
+}
+
+// Days from 1970-01-01 to a proleptic Gregorian date.
+int32_t DaysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const int year_of_era = year - era * 400;
+  const int day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+bool ParseDigits(const char* text, int count, int* value) {
+  *value = 0;
+  for (int i = 0; i < count; ++i) {
+    if (text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+    *value = *value * 10 + (text[i] - '0');
+  }
+  return true;
+}
+
+// A field of a CSV line. Points into the file unless the field had escaped
+// quotes, in which case the unescaped text is in |unescaped|.
+struct Field {
+  const char* data = nullptr;
+  size_t length = 0;
+  std::string unescaped;
+  bool quoted = false;
+};
+
+// Reads one field starting at |p| and returns the position after it, which
+// is at a comma, a line end or |end|.
+const char* ReadField(const char* p, const char* end, Field* field) {
+  field->unescaped.clear();
+  field->quoted = p < end && *p == '"';
+  if (!field->quoted) {
+    const char* start = p;
+    while (p < end && *p != ',' && *p != '\n' && *p != '\r') {
+      ++p;
+    }
+    field->data = start;
+    field->length = p - start;
+    return p;
+  }
+  ++p;
+  const char* start = p;
+  bool escaped = false;
+  while (p < end) {
+    if (*p != '"') {
+      ++p;
+      continue;
+    }
+    if (p + 1 < end && p[1] == '"') {
+      if (!escaped) {
+        field->unescaped.assign(start, p + 1);
+        escaped = true;
+      } else {
+        field->unescaped.append(start, p + 1);
+      }
+      p += 2;
+      start = p;
+      continue;
+    }
+    break;
+  }
+  if (escaped) {
+    field->unescaped.append(start, p);
+    field->data = field->unescaped.data();
+    field->length = field->unescaped.size();
+  } else {
+    field->data = start;
+    field->length = p - start;
+  }
+  // Skip the closing quote.
+  return p < end ? p + 1 : p;
+}
+
+// Returns the start of the line after the first line break outside quotes
+// at or after |p|, given whether |p| is inside a quoted field.
+const char* NextLineStart(const char* p, const char* end, bool in_quotes) {
+  for (; p < end; ++p) {
+    if (*p == '"') {
+      in_quotes = !in_quotes;
+    } else if (*p == '\n' && !in_quotes) {
+      return p + 1;
+    }
+  }
+  return end;
+}
+
+// Positions of the columns the aggregation reads, from the header.
+struct Columns {
+  int ward_id = -1;
+  int created_at = -1;
+  int status = -1;
+  int category = -1;
+
+  int last() const {
+    return std::max(std::max(ward_id, created_at), std::max(status, category));
+  }
+};
+
+// Aggregates the lines in [begin, end), which starts at a line start.
+void AggregateLines(const char* begin, const char* end, const Columns& columns,
+                    WardStatistics* statistics, CsvAggregateStats* stats) {
+  const int last = columns.last();
+  std::vector<Field> fields(last + 1);
+  std::string category;
+  const char* p = begin;
+  while (p < end) {
+    int column = 0;
+    while (true) {
+      Field scratch;
+      Field* field = column <= last ? &fields[column] : &scratch;
+      p = ReadField(p, end, field);
+      ++column;
+      if (p >= end || *p != ',') {
+        break;
+      }
+      ++p;
+    }
+    // Skip the line break, including any \r before it.
+    while (p < end && *p != '\n') {
+      ++p;
+    }
+    if (p < end) {
+      ++p;
+    }
+    if (column == 1 && fields[0].length == 0 && !fields[0].quoted) {
+      continue;  // Blank line.
+    }
+
+    ++stats->rows;
+    if (column <= last) {
+      ++stats->invalid;
+      continue;
+    }
+    const Field& ward = fields[columns.ward_id];
+    const bool without_ward = ward.length == 0 && !ward.quoted;
+    if (without_ward) {
+      ++stats->without_ward;
+    }
+    int32_t ward_id = kUnassignedWardId;
+    bool valid = without_ward || (ward.length > 0 && ward.length <= 9);
+    for (size_t i = 0; valid && i < ward.length; ++i) {
+      valid = ward.data[i] >= '0' && ward.data[i] <= '9';
+      ward_id = ward_id * 10 + (ward.data[i] - '0');
+    }
+    const Field& created = fields[columns.created_at];
+    const Field& status = fields[columns.status];
+    const Field& category_field = fields[columns.category];
+    const int32_t day = ParseDay(created.data, created.length);
+    const int status_index = ComplaintStatusIndex(status.data, status.length);
+    category.assign(category_field.data, category_field.length);
+    if (!valid || day < 0 || status_index < 0 ||
+        !statistics->Add(ward_id, day, status_index, category, 1)) {
+      ++stats->invalid;
+    }
+  }
+}
+
+}  // namespace
+
+int ComplaintStatusIndex(const char* name, size_t length) {
+  for (int i = 0; i < kComplaintStatusCount; ++i) {
+    if (Equals(name, length, kStatuses[i].name) ||
+        Equals(name, length, kStatuses[i].label)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char* ComplaintStatusLabel(int index) {
+  return index >= 0 && index < kComplaintStatusCount ? kStatuses[index].label
+                                                     : nullptr;
+}
+
+int32_t ParseDay(const char* text, size_t length) {
+  int year;
+  int month;
+  int day;
+  if (length < 10 || text[4] != '-' || text[7] != '-' ||
+      !ParseDigits(text, 4, &year) || !ParseDigits(text + 5, 2, &month) ||
+      !ParseDigits(text + 8, 2, &day) || month < 1 || month > 12 || day < 1 ||
+      day > 31) {
+    return -1;
+  }
+  const int32_t days = DaysFromCivil(year, month, day);
+  return days >= 0 ? days : -1;
+}
+
+bool WardStatistics::Add(int32_t ward_id, int32_t day, int status,
+                         const std::string& category, int32_t delta) {
+  if (day < 0 || day > kMaxDay || status < 0 ||
+      status >= kComplaintStatusCount) {
+    return false;
+  }
+  const int category_id = CategoryId(category);
+  if (category_id < 0) {
+    return false;
+  }
+  counts_[status][Row(ward_id, day, category_id)] += delta;
+  return true;
+}
+
+void WardStatistics::Merge(const WardStatistics& other) {
+  std::vector<int> category_map(other.categories_.size());
+  for (size_t i = 0; i < other.categories_.size(); ++i) {
+    category_map[i] = CategoryId(other.categories_[i]);
+  }
+  for (size_t row = 0; row < other.rows(); ++row) {
+    const int category = category_map[other.category_ids_[row]];
+    if (category < 0) {
+      continue;
+    }
+    const size_t target =
+        Row(other.ward_ids_[row], other.days_[row], category);
+    for (int s = 0; s < kComplaintStatusCount; ++s) {
+      counts_[s][target] += other.counts_[s][row];
+    }
+  }
+}
+
+void WardStatistics::Take(StatisticsBatch* batch) {
+  batch->ward_ids.clear();
+  batch->days.clear();
+  batch->statuses.clear();
+  batch->category_ids.clear();
+  batch->counts.clear();
+  for (int s = 0; s < kComplaintStatusCount; ++s) {
+    const std::vector<int32_t>& column = counts_[s];
+    for (size_t row = 0; row < column.size(); ++row) {
+      if (column[row] == 0) {
+        continue;
+      }
+      batch->ward_ids.push_back(ward_ids_[row]);
+      batch->days.push_back(days_[row]);
+      batch->statuses.push_back(static_cast<uint8_t>(s));
+      batch->category_ids.push_back(category_ids_[row]);
+      batch->counts.push_back(column[row]);
+    }
+  }
+  batch->categories = categories_;
+
+  // Rows are dropped rather than zeroed so that memory tracks the cells that
+  // changed since the last batch, not every cell ever seen. Categories are
+  // kept; there are few of them.
+  rows_.clear();
+  ward_ids_.clear();
+  days_.clear();
+  category_ids_.clear();
+  for (std::vector<int32_t>& column : counts_) {
+    column.clear();
+  }
+}
+
+int WardStatistics::CategoryId(const std::string& category) {
+  auto it = category_index_.find(category);
+  if (it != category_index_.end()) {
+    return it->second;
+  }
+  if (categories_.size() >= static_cast<size_t>(kMaxCategories)) {
+    return -1;
+  }
+  const uint16_t id = static_cast<uint16_t>(categories_.size());
+  categories_.push_back(category);
+  category_index_.emplace(category, id);
+  return id;
+}
+
+size_t WardStatistics::Row(int32_t ward_id, int32_t day, uint16_t category) {
+  const auto inserted = rows_.emplace(RowKey(ward_id, day, category),
+                                      static_cast<uint32_t>(ward_ids_.size()));
+  if (inserted.second) {
+    ward_ids_.push_back(ward_id);
+    days_.push_back(day);
+    category_ids_.push_back(category);
+    for (std::vector<int32_t>& column : counts_) {
+      column.push_back(0);
+    }
+  }
+  return inserted.first->second;
+}
+
+bool AggregateComplaintCsv(const std::string& path, int threads,
+                           WardStatistics* statistics,
+                           CsvAggregateStats* stats, std::string* error) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    *error = path + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  const size_t size = static_cast<size_t>(info.st_size);
+  if (size == 0) {
+    close(fd);
+    *error = path + ": empty file";
+    return false;
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    *error = path + ": " + strerror(errno);
+    return false;
+  }
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  const char* const data = static_cast<const char*>(mapping);
+  const char* const end = data + size;
+
+  // The header names the columns.
+  Columns columns;
+  const char* body = NextLineStart(data, end, false);
+  {
+    Field field;
+    int column = 0;
+    const char* p = data;
+    while (p < body) {
+      p = ReadField(p, body, &field);
+      if (Equals(field.data, field.length, "ward_id")) {
+        columns.ward_id = column;
+      } else if (Equals(field.data, field.length, "created_at")) {
+        columns.created_at = column;
+      } else if (Equals(field.data, field.length, "status")) {
+        columns.status = column;
+      } else if (Equals(field.data, field.length, "category")) {
+        columns.category = column;
+      }
+      ++column;
+      if (p >= body || *p != ',') {
+        break;
+      }
+      ++p;
+    }
+  }
+  if (columns.ward_id < 0 || columns.created_at < 0 || columns.status < 0 ||
+      columns.category < 0) {
+    munmap(mapping, size);
+    *error = path +
+             ": the header must name ward_id, created_at, status and "
+             "category; export with CSV HEADER";
+    return false;
+  }
+
+  // Splitting the body into equal chunks can cut through quoted fields that
+  // contain newlines. Each thread first counts the quotes in its chunk; the
+  // running parity then tells every chunk whether it starts inside quotes,
+  // and so where its first whole line begins.
+  const size_t body_size = end - body;
+  const int chunk_count = static_cast<int>(std::max<size_t>(
+      1, std::min<size_t>(std::max(threads, 1), body_size / 4096 + 1)));
+  const size_t chunk_size = (body_size + chunk_count - 1) / chunk_count;
+  std::vector<const char*> chunk_begin(chunk_count + 1);
+  for (int i = 0; i <= chunk_count; ++i) {
+    chunk_begin[i] = body + std::min(body_size, chunk_size * i);
+  }
+
+  std::vector<uint8_t> quote_parity(chunk_count);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < chunk_count; ++i) {
+    workers.emplace_back([&, i] {
+      size_t quotes = 0;
+      for (const char* p = chunk_begin[i]; p < chunk_begin[i + 1];) {
+        p = static_cast<const char*>(
+            memchr(p, '"', chunk_begin[i + 1] - p));
+        if (p == nullptr) {
+          break;
+        }
+        ++quotes;
+        ++p;
+      }
+      quote_parity[i] = quotes & 1;
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+
+  // Each chunk starts at the first line beginning after its first byte and
+  // runs to where the next chunk starts, so the chunks tile the body.
+  std::vector<const char*> line_begin(chunk_count + 1);
+  line_begin[0] = body;
+  line_begin[chunk_count] = end;
+  bool in_quotes = false;
+  for (int i = 1; i < chunk_count; ++i) {
+    in_quotes ^= quote_parity[i - 1] != 0;
+    line_begin[i] = NextLineStart(chunk_begin[i], end, in_quotes);
+  }
+
+  std::vector<WardStatistics> partial(chunk_count);
+  std::vector<CsvAggregateStats> partial_stats(chunk_count);
+  for (int i = 0; i < chunk_count; ++i) {
+    workers.emplace_back([&, i] {
+      AggregateLines(line_begin[i], line_begin[i + 1], columns, &partial[i],
+                     &partial_stats[i]);
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  munmap(mapping, size);
+
+  for (int i = 0; i < chunk_count; ++i) {
+    statistics->Merge(partial[i]);
+    stats->rows += partial_stats[i].rows;
+    stats->without_ward += partial_stats[i].without_ward;
+    stats->invalid += partial_stats[i].invalid;
+  }
+  return true;
+}
@@ -0,0 +1,113 @@
+#ifndef WARD_STATISTICS_H_
+#define WARD_STATISTICS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Ward id under which complaints without a ward are counted. Ward ids start at
+// 1, so it never names a real ward; WardStatisticsService.js stores these
+// counts under a reserved "Unassigned" ward.
+constexpr int32_t kUnassignedWardId = 0;
+
+// Values of the ComplaintStatus enum in prisma/schema.prisma, in order.
+constexpr int kComplaintStatusCount = 7;
+
+// Index of a ComplaintStatus given either its Prisma name ("Under_Review") or
+// its database label ("Under Review"), or -1.
+int ComplaintStatusIndex(const char* name, size_t length);
+
+// The database label of status |index|, as stored in Postgres.
+const char* ComplaintStatusLabel(int index);
+
+// Days since 1970-01-01 of a "YYYY-MM-DD..." date or timestamp, or -1.
+int32_t ParseDay(const char* text, size_t length);
+
+// Nonzero counters in columnar form, one entry per ward, day, status and
+// category. |category_ids| index |categories|.
+struct StatisticsBatch {
+  std::vector<int32_t> ward_ids;
+  std::vector<int32_t> days;
+  std::vector<uint8_t> statuses;
+  std::vector<uint16_t> category_ids;
+  std::vector<int32_t> counts;
+  std::vector<std::string> categories;
+};
+
+// Complaint counts by ward, creation day, current status and category.
+//
+// Rows are keyed by ward, day and category and hold one counter per status,
+// stored column by column so that taking a batch is a linear scan. Updates
+// are a hash lookup, and counters may go negative when they hold changes
+// rather than totals. Not thread-safe.
+class WardStatistics {
+ public:
+  static constexpr int kMaxCategories = 1 << 16;
+
+  WardStatistics() = default;
+
+  WardStatistics(const WardStatistics&) = delete;
+  WardStatistics& operator=(const WardStatistics&) = delete;
+
+  // Adds |delta| to one counter. Returns false if |day| is outside the
+  // representable range or there are too many distinct categories.
+  bool Add(int32_t ward_id, int32_t day, int status,
+           const std::string& category, int32_t delta);
+
+  // Adds every counter of |other| to this one.
+  void Merge(const WardStatistics& other);
+
+  // Moves the nonzero counters into |batch| and clears them.
+  void Take(StatisticsBatch* batch);
+
+  // Rows held, including rows whose counters have all returned to zero.
+  size_t rows() const { return ward_ids_.size(); }
+
+ private:
+  // Days are stored in 16 bits, which lasts until 2149.
+  static constexpr int32_t kMaxDay = 0xffff;
+
+  static uint64_t RowKey(int32_t ward_id, int32_t day, uint16_t category) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(ward_id)) << 32 |
+           static_cast<uint64_t>(day) << 16 | category;
+  }
+
+  // Returns the id of |category|, adding it if needed, or -1 when full.
+  int CategoryId(const std::string& category);
+  size_t Row(int32_t ward_id, int32_t day, uint16_t category);
+
+  std::unordered_map<uint64_t, uint32_t> rows_;
+  std::vector<int32_t> ward_ids_;
+  std::vector<int32_t> days_;
+  std::vector<uint16_t> category_ids_;
+  // kComplaintStatusCount columns of counters, each rows() long.
+  std::vector<int32_t> counts_[kComplaintStatusCount];
+
+  std::unordered_map<std::string, uint16_t> category_index_;
+  std::vector<std::string> categories_;
+};
+
+struct CsvAggregateStats {
+  // Data rows read.
+  uint64_t rows = 0;
+  // Complaints without a ward, counted under kUnassignedWardId.
+  uint64_t without_ward = 0;
+  // Rows with a missing or unparsable column.
+  uint64_t invalid = 0;
+};
+
+// Counts the complaints in a CSV export of the Complaint table using up to
+// |threads| threads, e.g. from
+//
+//   \copy "Complaint" TO 'complaints.csv' WITH CSV HEADER
+//
+// The header must name the ward_id, created_at, status and category columns;
+// others are ignored. Quoted fields may contain commas, quotes and newlines.
+// Returns false with |error| set if the file cannot be read.
+bool AggregateComplaintCsv(const std::string& path, int threads,
+                           WardStatistics* statistics,
+                           CsvAggregateStats* stats, std::string* error);
+
+#endif  // WARD_STATISTICS_H_
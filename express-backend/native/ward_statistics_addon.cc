@@ -0,0 +1,319 @@
+// Node-API bindings for WardStatistics, used by WardStatisticsService.js.
+//
+//   const { WardStatistics, aggregateComplaintCsv, statuses, unassignedWardId } =
+//       require(...);
+//
+//   const statistics = new WardStatistics();
+//   statistics.add(wardId, day, 'Submitted', 'pothole', 1);  // -> boolean
+//   const batch = statistics.take();
+//   const totals = await aggregateComplaintCsv('complaints.csv', 8);
+//
+// A batch is { wardIds: Int32Array, days: Int32Array, statuses: Uint8Array,
+// categoryIds: Uint16Array, counts: Int32Array, categories: string[] }, where
+// statuses index the exported `statuses` labels and days count from
+// 1970-01-01. Complaints without a ward are counted under unassignedWardId.
+// aggregateComplaintCsv() runs off the event loop and its batch also has rows,
+// withoutWard and invalid counts.
+
+#include <node_api.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "ward_statistics.h"
+
+namespace {
+
+#define NAPI_CALL(env, call)                                              \
+  do {                                                                    \
+    if ((call) != napi_ok) {                                              \
+      napi_throw_error((env), nullptr, "Node-API call failed: " #call);  \
+      return nullptr;                                                     \
+    }                                                                     \
+  } while (0)
+
+bool GetString(napi_env env, napi_value value, std::string* out) {
+  size_t length = 0;
+  if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) {
+    return false;
+  }
+  out->resize(length);
+  return napi_get_value_string_utf8(env, value, &(*out)[0], length + 1,
+                                    &length) == napi_ok;
+}
+
+template <typename T>
+napi_value MakeTypedArray(napi_env env, napi_typedarray_type type,
+                          const std::vector<T>& values) {
+  void* data = nullptr;
+  napi_value buffer;
+  napi_value array;
+  NAPI_CALL(env, napi_create_arraybuffer(env, values.size() * sizeof(T), &data,
+                                         &buffer));
+  if (!values.empty()) {
+    memcpy(data, values.data(), values.size() * sizeof(T));
+  }
+  NAPI_CALL(env, napi_create_typedarray(env, type, values.size(), buffer, 0,
+                                        &array));
+  return array;
+}
+
+bool SetProperty(napi_env env, napi_value object, const char* name,
+                 napi_value value) {
+  return value != nullptr &&
+         napi_set_named_property(env, object, name, value) == napi_ok;
+}
+
+napi_value MakeBatch(napi_env env, const StatisticsBatch& batch) {
+  napi_value result;
+  napi_value categories;
+  NAPI_CALL(env, napi_create_object(env, &result));
+  NAPI_CALL(env, napi_create_array_with_length(env, batch.categories.size(),
+                                               &categories));
+  for (size_t i = 0; i < batch.categories.size(); ++i) {
+    napi_value name;
+    NAPI_CALL(env, napi_create_string_utf8(env, batch.categories[i].data(),
+                                           batch.categories[i].size(), &name));
+    NAPI_CALL(env, napi_set_element(env, categories, i, name));
+  }
+  if (!SetProperty(env, result, "wardIds",
+                   MakeTypedArray(env, napi_int32_array, batch.ward_ids)) ||
+      !SetProperty(env, result, "days",
+                   MakeTypedArray(env, napi_int32_array, batch.days)) ||
+      !SetProperty(env, result, "statuses",
+                   MakeTypedArray(env, napi_uint8_array, batch.statuses)) ||
+      !SetProperty(env, result, "categoryIds",
+                   MakeTypedArray(env, napi_uint16_array,
+                                  batch.category_ids)) ||
+      !SetProperty(env, result, "counts",
+                   MakeTypedArray(env, napi_int32_array, batch.counts)) ||
+      !SetProperty(env, result, "categories", categories)) {
+    return nullptr;
+  }
+  return result;
+}
+
+// --- WardStatistics class ----------------------------------------------------
+
+void DeleteStatistics(napi_env, void* data, void*) {
+  delete static_cast<WardStatistics*>(data);
+}
+
+napi_value Construct(napi_env env, napi_callback_info info) {
+  napi_value self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+  WardStatistics* statistics = new WardStatistics();
+  if (napi_wrap(env, self, statistics, DeleteStatistics, nullptr, nullptr) !=
+      napi_ok) {
+    delete statistics;
+    napi_throw_error(env, nullptr, "Failed to wrap WardStatistics");
+    return nullptr;
+  }
+  return self;
+}
+
+WardStatistics* Unwrap(napi_env env, napi_value self) {
+  void* data = nullptr;
+  if (napi_unwrap(env, self, &data) != napi_ok) {
+    napi_throw_type_error(env, nullptr, "Not a WardStatistics");
+    return nullptr;
+  }
+  return static_cast<WardStatistics*>(data);
+}
+
+// add(wardId, day, status, category, delta) -> boolean
+napi_value Add(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  napi_value self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, &self, nullptr));
+  WardStatistics* statistics = Unwrap(env, self);
+  if (statistics == nullptr) {
+    return nullptr;
+  }
+  int32_t ward_id = 0;
+  int32_t day = 0;
+  int32_t delta = 0;
+  std::string status;
+  std::string category;
+  if (argc < 5 || napi_get_value_int32(env, argv[0], &ward_id) != napi_ok ||
+      napi_get_value_int32(env, argv[1], &day) != napi_ok ||
+      !GetString(env, argv[2], &status) || !GetString(env, argv[3], &category) ||
+      napi_get_value_int32(env, argv[4], &delta) != napi_ok) {
+    napi_throw_type_error(
+        env, nullptr,
+        "add(wardId, day, status, category, delta) takes numbers and strings");
+    return nullptr;
+  }
+  const int status_index = ComplaintStatusIndex(status.data(), status.size());
+  napi_value result;
+  NAPI_CALL(env, napi_get_boolean(
+                     env,
+                     status_index >= 0 && statistics->Add(ward_id, day,
+                                                          status_index,
+                                                          category, delta),
+                     &result));
+  return result;
+}
+
+// take() -> batch
+napi_value Take(napi_env env, napi_callback_info info) {
+  napi_value self;
+  NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+  WardStatistics* statistics = Unwrap(env, self);
+  if (statistics == nullptr) {
+    return nullptr;
+  }
+  StatisticsBatch batch;
+  statistics->Take(&batch);
+  return MakeBatch(env, batch);
+}
+
+// --- aggregateComplaintCsv ---------------------------------------------------
+
+struct CsvWork {
+  std::string path;
+  int threads;
+  napi_deferred deferred;
+  napi_async_work work;
+
+  WardStatistics statistics;
+  CsvAggregateStats stats;
+  std::string error;
+  bool ok = false;
+};
+
+void ExecuteCsvWork(napi_env, void* data) {
+  CsvWork* work = static_cast<CsvWork*>(data);
+  work->ok = AggregateComplaintCsv(work->path, work->threads,
+                                   &work->statistics, &work->stats,
+                                   &work->error);
+}
+
+void CompleteCsvWork(napi_env env, napi_status status, void* data) {
+  CsvWork* work = static_cast<CsvWork*>(data);
+  napi_value outcome = nullptr;
+  bool resolved = false;
+  if (status == napi_ok && work->ok) {
+    StatisticsBatch batch;
+    work->statistics.Take(&batch);
+    outcome = MakeBatch(env, batch);
+    napi_value rows;
+    napi_value without_ward;
+    napi_value invalid;
+    if (outcome != nullptr &&
+        napi_create_double(env, static_cast<double>(work->stats.rows),
+                           &rows) == napi_ok &&
+        napi_create_double(env, static_cast<double>(work->stats.without_ward),
+                           &without_ward) == napi_ok &&
+        napi_create_double(env, static_cast<double>(work->stats.invalid),
+                           &invalid) == napi_ok &&
+        SetProperty(env, outcome, "rows", rows) &&
+        SetProperty(env, outcome, "withoutWard", without_ward) &&
+        SetProperty(env, outcome, "invalid", invalid)) {
+      resolved = true;
+    }
+  }
+  if (resolved) {
+    napi_resolve_deferred(env, work->deferred, outcome);
+  } else {
+    const std::string message =
+        work->error.empty() ? "aggregateComplaintCsv failed" : work->error;
+    napi_value text;
+    napi_value error;
+    napi_create_string_utf8(env, message.data(), message.size(), &text);
+    napi_create_error(env, nullptr, text, &error);
+    napi_reject_deferred(env, work->deferred, error);
+  }
+  napi_delete_async_work(env, work->work);
+  delete work;
+}
+
+// aggregateComplaintCsv(path, threads?) -> Promise<batch>
+napi_value AggregateCsv(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+  std::string path;
+  if (argc < 1 || !GetString(env, argv[0], &path)) {
+    napi_throw_type_error(env, nullptr, "aggregateComplaintCsv(path, threads)");
+    return nullptr;
+  }
+  int32_t threads = 0;
+  if (argc >= 2) {
+    napi_valuetype type;
+    NAPI_CALL(env, napi_typeof(env, argv[1], &type));
+    if (type == napi_number) {
+      NAPI_CALL(env, napi_get_value_int32(env, argv[1], &threads));
+    }
+  }
+  if (threads <= 0) {
+    threads = static_cast<int32_t>(std::thread::hardware_concurrency());
+  }
+
+  CsvWork* work = new CsvWork();
+  work->path = path;
+  work->threads = threads > 0 ? threads : 1;
+  napi_value promise;
+  napi_value name;
+  if (napi_create_promise(env, &work->deferred, &promise) != napi_ok ||
+      napi_create_string_utf8(env, "aggregateComplaintCsv", NAPI_AUTO_LENGTH,
+                              &name) != napi_ok ||
+      napi_create_async_work(env, nullptr, name, ExecuteCsvWork,
+                             CompleteCsvWork, work, &work->work) != napi_ok) {
+    delete work;
+    napi_throw_error(env, nullptr, "Failed to start aggregateComplaintCsv");
+    return nullptr;
+  }
+  if (napi_queue_async_work(env, work->work) != napi_ok) {
+    napi_delete_async_work(env, work->work);
+    delete work;
+    napi_throw_error(env, nullptr, "Failed to queue aggregateComplaintCsv");
+    return nullptr;
+  }
+  return promise;
+}
+
+napi_value Init(napi_env env, napi_value exports) {
+  const napi_property_descriptor methods[] = {
+      {"add", nullptr, Add, nullptr, nullptr, nullptr, napi_default, nullptr},
+      {"take", nullptr, Take, nullptr, nullptr, nullptr, napi_default,
+       nullptr},
+  };
+  napi_value statistics_class;
+  NAPI_CALL(env, napi_define_class(env, "WardStatistics", NAPI_AUTO_LENGTH,
+                                   Construct, nullptr,
+                                   sizeof(methods) / sizeof(methods[0]),
+                                   methods, &statistics_class));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "WardStatistics",
+                                         statistics_class));
+
+  napi_value aggregate;
+  NAPI_CALL(env, napi_create_function(env, "aggregateComplaintCsv",
+                                      NAPI_AUTO_LENGTH, AggregateCsv, nullptr,
+                                      &aggregate));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "aggregateComplaintCsv",
+                                         aggregate));
+
+  napi_value statuses;
+  NAPI_CALL(env, napi_create_array_with_length(env, kComplaintStatusCount,
+                                               &statuses));
+  for (int i = 0; i < kComplaintStatusCount; ++i) {
+    napi_value label;
+    NAPI_CALL(env, napi_create_string_utf8(env, ComplaintStatusLabel(i),
+                                           NAPI_AUTO_LENGTH, &label));
+    NAPI_CALL(env, napi_set_element(env, statuses, i, label));
+  }
+  NAPI_CALL(env, napi_set_named_property(env, exports, "statuses", statuses));
+
+  napi_value unassigned;
+  NAPI_CALL(env, napi_create_int32(env, kUnassignedWardId, &unassigned));
+  NAPI_CALL(env, napi_set_named_property(env, exports, "unassignedWardId",
+                                         unassigned));
+  return exports;
+}
+
+}  // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
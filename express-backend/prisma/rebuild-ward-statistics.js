@@ -0,0 +1,40 @@
+// Rebuilds WardStatistic from a CSV export of the Complaint table:
+//
+//   psql "$DATABASE_URL" -c "\copy \"Complaint\" TO 'complaints.csv' WITH CSV HEADER"
+//   npm run stats:rebuild -- complaints.csv [threads]
+//
+// Needs the native addon (`npm run build:native`). Complaints created by a
+// running API between the export and the rebuild are not counted.
+
+import env from 'dotenv';
+import { db } from '../src/utils/db.js';
+import { rebuildWardStatisticsFromCsv } from '../src/services/WardStatisticsService.js';
+
+env.config({
+  path: './.env',
+});
+
+async function main() {
+  const [path, threads] = process.argv.slice(2);
+  if (!path) {
+    throw new Error('Usage: npm run stats:rebuild -- <complaints.csv> [threads]');
+  }
+
+  console.log(`Rebuilding ward statistics from ${path} ...`);
+  const started = Date.now();
+  const result = await rebuildWardStatisticsFromCsv(path, Number(threads) || undefined);
+  console.log(
+    `Read ${result.rows} complaints (${result.withoutWard} unassigned to a ward, ${result.invalid} invalid), ` +
+      `wrote ${result.written} rows in ${Date.now() - started} ms`
+  );
+}
+
+main()
+  .then(async () => {
+    await db.$disconnect();
+  })
+  .catch(async (e) => {
+    console.error(e);
+    await db.$disconnect();
+    process.exit(1);
+  });
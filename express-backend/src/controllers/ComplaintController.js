@@ -1,5 +1,21 @@
 import { db } from '../utils/db.js';
 import crypto from 'crypto';
+import { recordComplaintCreated, recordComplaintStatusChange } from '../services/WardStatisticsService.js';
+
+// Status names accepted from clients, mapped to ComplaintStatus values.
+const statusMap = {
+  'pending': 'Submitted', // 'pending' in UI maps to 'Submitted' in DB
+  'submitted': 'Submitted',
+  'under_review': 'Under_Review',
+  'assigned': 'Assigned',
+  'in_progress': 'In_Progress',
+  'resolved': 'Resolved',
+  'rejected': 'Rejected',
+  'closed': 'Closed'
+};
+
+// Roles allowed to change a complaint's status.
+const STATUS_EDITOR_ROLES = ['admin', 'field_officer'];
 
 const ComplaintController = {
   create: async (req, res) => {
@@ -63,6 +79,7 @@ const ComplaintController = {
           longitude: lngNum,
         }
       });
+      recordComplaintCreated(complaint);
 
       // Add images (mock handling where images is array of URLs)
       if (images && Array.isArray(images)) {
@@ -104,16 +121,6 @@ const ComplaintController = {
       
       // Map frontend status 'all' to undefined (no filter)
       if (status && status !== 'all') {
-          const statusMap = {
-              'pending': 'Submitted', // 'pending' in UI maps to 'Submitted' in DB
-              'submitted': 'Submitted',
-              'under_review': 'Under_Review',
-              'in_progress': 'In_Progress',
-              'resolved': 'Resolved',
-              'rejected': 'Rejected', // Added rejected mapping
-              'closed': 'Closed'
-          };
-          
           const mappedStatus = statusMap[status.toLowerCase()] || statusMap[status];
 
           if (mappedStatus) {
@@ -284,6 +291,77 @@ const ComplaintController = {
     }
   },
 
+  updateStatus: async (req, res) => {
+    try {
+      const { userId } = req.payload;
+      const { complaintId } = req.params;
+      const { status, message } = req.body;
+      const id = parseInt(complaintId);
+
+      if (isNaN(id)) {
+        return res.status(400).json({ message: 'Invalid complaint ID' });
+      }
+      const newStatus = typeof status === 'string' ? statusMap[status.toLowerCase()] : undefined;
+      if (!newStatus) {
+        return res.status(400).json({ message: 'Invalid status' });
+      }
+
+      const user = await db.user.findUnique({ where: { id: userId }, select: { role: true } });
+      if (!user || !STATUS_EDITOR_ROLES.includes(user.role)) {
+        return res.status(403).json({ message: 'Not allowed to update complaint status' });
+      }
+
+      const result = await db.$transaction(async (tx) => {
+        const existing = await tx.complaint.findUnique({ where: { id }, select: { status: true } });
+        if (!existing) {
+          return { error: 404 };
+        }
+        // Only move from the status read above, so that concurrent updates
+        // each count one transition.
+        const data = { status: newStatus };
+        if (newStatus === 'Resolved') {
+          data.resolved_by = userId;
+        }
+        const { count } = await tx.complaint.updateMany({ where: { id, status: existing.status }, data });
+        if (count === 0) {
+          return { error: 409 };
+        }
+        await tx.complaintUpdate.create({
+          data: {
+            complaint_id: id,
+            updated_by: userId,
+            update_type: 'status_change',
+            message: message || `Status changed from ${existing.status} to ${newStatus}`
+          }
+        });
+        const complaint = await tx.complaint.findUnique({ where: { id } });
+        return { complaint, previousStatus: existing.status };
+      });
+
+      if (result.error === 404) {
+        return res.status(404).json({ message: 'Complaint not found' });
+      }
+      if (result.error === 409) {
+        return res.status(409).json({ message: 'Complaint status changed concurrently, retry' });
+      }
+      recordComplaintStatusChange(result.complaint, result.previousStatus);
+
+      return res.json({
+        success: true,
+        message: 'Complaint status updated',
+        data: {
+          complaint_id: result.complaint.id,
+          previous_status: result.previousStatus,
+          status: result.complaint.status,
+          updated_at: result.complaint.updated_at
+        }
+      });
+    } catch (error) {
+      console.error('Update complaint status error:', error);
+      return res.status(500).json({ message: 'Internal server error' });
+    }
+  },
+
   removeUpvote: async (req, res) => {
       try {
           const { userId } = req.payload;
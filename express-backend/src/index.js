@@ -6,6 +6,7 @@ import isAuthenticated from './middleware/isAuthenticated.js';
 import SessionController from './controllers/SessionController.js';
 import UserController from './controllers/UserController.js';
 import ComplaintController from './controllers/ComplaintController.js';
+import { startWardStatistics, stopWardStatistics } from './services/WardStatisticsService.js';
 
 env.config({
   path: './.env',
@@ -40,11 +41,23 @@ const main = async () => {
   router.post('/complaints', isAuthenticated, ComplaintController.create);
   router.get('/complaints/my-complaints', isAuthenticated, ComplaintController.getMyComplaints);
   router.get('/complaints/nearby', ComplaintController.getNearby); // Public? Or auth? Doc says nothing, usually public or auth. Let's make public for map view.
+  router.patch('/complaints/:complaintId/status', isAuthenticated, ComplaintController.updateStatus);
   router.post('/complaints/:complaintId/upvote', isAuthenticated, ComplaintController.toggleUpvote);
   router.delete('/complaints/:complaintId/upvote', isAuthenticated, ComplaintController.removeUpvote); // Use dedicated remove method
 
   app.use('/api', router);
 
+  // Counted in memory and flushed periodically; flush what is left on exit.
+  startWardStatistics();
+  for (const signal of ['SIGINT', 'SIGTERM']) {
+    process.once(signal, () => {
+      stopWardStatistics()
+        // eslint-disable-next-line no-console
+        .catch((error) => console.error('Ward statistics flush error:', error))
+        .finally(() => process.exit(0));
+    });
+  }
+
   app.listen(port, () =>
     // eslint-disable-next-line no-console
     console.log(`App listening on port ${port}`)
@@ -0,0 +1,208 @@
+// Ward Statistics Services
+//
+// Keeps WardStatistic up to date without GROUP BY queries over Complaint. Each
+// row counts the complaints of one ward created on one day that are currently
+// in one status and category. Complaints without a ward are counted under a
+// reserved "Unassigned" ward, created on first use. Changes are counted in memory by the native
+// ward_statistics addon (see native/) and flushed as batched upserts that add
+// to the stored counts, so several API instances can run side by side.
+//
+// The addon is optional: build it with `npm run build:native`. Without it the
+// recording functions do nothing and WardStatistic is only filled by
+// `npm run stats:rebuild`.
+
+import { createRequire } from 'module';
+import { db } from '../utils/db.js';
+
+const require = createRequire(import.meta.url);
+
+const MS_PER_DAY = 24 * 60 * 60 * 1000;
+const FLUSH_INTERVAL_MS = Number(process.env.WARD_STATS_FLUSH_MS) || 10000;
+// Rows per INSERT statement.
+const UPSERT_BATCH_ROWS = 1000;
+// Ward that holds the counts of complaints without one.
+const UNASSIGNED_WARD_NUMBER = 'UNASSIGNED';
+
+function loadAddon() {
+  try {
+    return require('../../native/build/Release/ward_statistics.node');
+  } catch (error) {
+    // eslint-disable-next-line no-console
+    console.warn('Ward statistics addon not built; run `npm run build:native` to enable it.');
+    return null;
+  }
+}
+
+const addon = loadAddon();
+const pending = addon ? new addon.WardStatistics() : null;
+let flushTimer = null;
+let flushing = null;
+let unassignedWardId = null;
+
+function toDay(date) {
+  return Math.floor(new Date(date).getTime() / MS_PER_DAY);
+}
+
+// Returns the id of the Unassigned ward, creating it if needed.
+async function resolveUnassignedWard() {
+  if (unassignedWardId === null) {
+    const ward = await db.ward.upsert({
+      where: { ward_number: UNASSIGNED_WARD_NUMBER },
+      update: {},
+      create: { ward_number: UNASSIGNED_WARD_NUMBER, ward_name: 'Unassigned' },
+    });
+    unassignedWardId = ward.id;
+  }
+  return unassignedWardId;
+}
+
+function record(complaint, status, delta) {
+  if (!pending) {
+    return;
+  }
+  const wardId = complaint.ward_id ?? addon.unassignedWardId;
+  if (!pending.add(wardId, toDay(complaint.created_at), status, complaint.category, delta)) {
+    // eslint-disable-next-line no-console
+    console.warn(`Ward statistics: cannot count complaint ${complaint.id} with status ${status}`);
+  }
+}
+
+// Counts a newly created complaint.
+export function recordComplaintCreated(complaint) {
+  record(complaint, complaint.status, 1);
+}
+
+// Moves a complaint from |previousStatus| to its current status.
+export function recordComplaintStatusChange(complaint, previousStatus) {
+  if (previousStatus === complaint.status) {
+    return;
+  }
+  record(complaint, previousStatus, -1);
+  record(complaint, complaint.status, 1);
+}
+
+// Writes |batch| rows [start, end) to WardStatistic, adding to the stored
+// counts, or inserting them into an emptied table when |replace| is set. Rows
+// counted without a ward are stored under |unassignedWard|.
+function upsertRows(client, batch, start, end, replace, unassignedWard) {
+  const wardIds = [];
+  const dates = [];
+  const statuses = [];
+  const categories = [];
+  const counts = [];
+  for (let i = start; i < end; i++) {
+    wardIds.push(batch.wardIds[i] === addon.unassignedWardId ? unassignedWard : batch.wardIds[i]);
+    dates.push(new Date(batch.days[i] * MS_PER_DAY).toISOString().slice(0, 10));
+    statuses.push(addon.statuses[batch.statuses[i]]);
+    categories.push(batch.categories[batch.categoryIds[i]]);
+    counts.push(batch.counts[i]);
+  }
+  if (replace) {
+    return client.$executeRaw`
+      INSERT INTO "WardStatistic" ("ward_id", "stat_date", "status", "category", "total_complaints")
+      SELECT * FROM UNNEST(${wardIds}::int[], ${dates}::date[], ${statuses}::"ComplaintStatus"[],
+                           ${categories}::text[], ${counts}::int[])`;
+  }
+  return client.$executeRaw`
+    INSERT INTO "WardStatistic" ("ward_id", "stat_date", "status", "category", "total_complaints")
+    SELECT * FROM UNNEST(${wardIds}::int[], ${dates}::date[], ${statuses}::"ComplaintStatus"[],
+                         ${categories}::text[], ${counts}::int[])
+    ON CONFLICT ("ward_id", "stat_date", "status", "category")
+    DO UPDATE SET "total_complaints" = "WardStatistic"."total_complaints" + EXCLUDED."total_complaints"`;
+}
+
+// Returns the counts of |batch| to the pending counters after a failed flush.
+function restore(batch) {
+  for (let i = 0; i < batch.counts.length; i++) {
+    pending.add(
+      batch.wardIds[i],
+      batch.days[i],
+      addon.statuses[batch.statuses[i]],
+      batch.categories[batch.categoryIds[i]],
+      batch.counts[i]
+    );
+  }
+}
+
+async function flushPending() {
+  const batch = pending.take();
+  if (batch.counts.length === 0) {
+    return 0;
+  }
+  try {
+    const unassignedWard = await resolveUnassignedWard();
+    await db.$transaction(async (tx) => {
+      for (let start = 0; start < batch.counts.length; start += UPSERT_BATCH_ROWS) {
+        const end = Math.min(start + UPSERT_BATCH_ROWS, batch.counts.length);
+        await upsertRows(tx, batch, start, end, false, unassignedWard);
+      }
+    });
+  } catch (error) {
+    restore(batch);
+    throw error;
+  }
+  return batch.counts.length;
+}
+
+// Writes the counted changes to WardStatistic. Returns the rows written.
+// Concurrent calls share one flush.
+export async function flushWardStatistics() {
+  if (!pending) {
+    return 0;
+  }
+  if (!flushing) {
+    flushing = flushPending().finally(() => {
+      flushing = null;
+    });
+  }
+  return flushing;
+}
+
+export function startWardStatistics() {
+  if (!pending || flushTimer) {
+    return;
+  }
+  flushTimer = setInterval(() => {
+    flushWardStatistics().catch((error) => {
+      // eslint-disable-next-line no-console
+      console.error('Ward statistics flush error:', error);
+    });
+  }, FLUSH_INTERVAL_MS);
+  flushTimer.unref();
+}
+
+export async function stopWardStatistics() {
+  if (flushTimer) {
+    clearInterval(flushTimer);
+    flushTimer = null;
+  }
+  await flushWardStatistics();
+}
+
+// Replaces WardStatistic with the counts from a CSV export of the Complaint
+// table, aggregated on |threads| threads (all cores by default). Returns the
+// rows read, those without a ward, those skipped as invalid and the rows
+// written.
+export async function rebuildWardStatisticsFromCsv(path, threads) {
+  if (!addon) {
+    throw new Error('Ward statistics addon not built; run `npm run build:native`');
+  }
+  const batch = await addon.aggregateComplaintCsv(path, threads);
+  const unassignedWard = await resolveUnassignedWard();
+  await db.$transaction(
+    async (tx) => {
+      await tx.$executeRaw`DELETE FROM "WardStatistic"`;
+      for (let start = 0; start < batch.counts.length; start += UPSERT_BATCH_ROWS) {
+        const end = Math.min(start + UPSERT_BATCH_ROWS, batch.counts.length);
+        await upsertRows(tx, batch, start, end, true, unassignedWard);
+      }
+    },
+    { timeout: 10 * 60 * 1000 }
+  );
+  return {
+    rows: batch.rows,
+    withoutWard: batch.withoutWard,
+    invalid: batch.invalid,
+    written: batch.counts.length,
+  };
+}
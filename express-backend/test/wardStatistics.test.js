@@ -0,0 +1,172 @@
+// Tests aggregateComplaintCsv in the native ward_statistics addon against a
+// CSV export with quoted fields that span lines and contain "" escapes,
+// complaints without a ward, and CRLF line ends. The file is split between up
+// to 16 threads, and most of every row is a quoted field, so chunk boundaries
+// land inside quotes. Needs `npm run build:native`.
+
+import assert from 'node:assert/strict';
+import { mkdtempSync, rmSync, writeFileSync } from 'node:fs';
+import { createRequire } from 'node:module';
+import { tmpdir } from 'node:os';
+import { join } from 'node:path';
+import { after, before, test } from 'node:test';
+
+const require = createRequire(import.meta.url);
+
+function loadAddon() {
+  try {
+    return require('../native/build/Release/ward_statistics.node');
+  } catch (error) {
+    return null;
+  }
+}
+
+const addon = loadAddon();
+const skip = addon ? false : 'addon not built; run `npm run build:native`';
+
+const MS_PER_DAY = 24 * 60 * 60 * 1000;
+const HEADER = 'id,complaint_number,description,ward_id,created_at,status,category\n';
+// Prisma names and database labels are both accepted.
+const STATUSES = [
+  ['Submitted', 'Submitted'],
+  ['Under Review', 'Under Review'],
+  ['Under_Review', 'Under Review'],
+  ['Assigned', 'Assigned'],
+  ['In Progress', 'In Progress'],
+  ['Resolved', 'Resolved'],
+  ['Closed', 'Closed'],
+  ['Rejected', 'Rejected'],
+];
+const CATEGORIES = ['pothole', 'street, light', 'water "supply"', 'drain'];
+const ROWS = 2000;
+
+function quote(text) {
+  return `"${text.replace(/"/g, '""')}"`;
+}
+
+// Builds the export and the counts it should produce, keyed by ward, day,
+// status label and category. Also returns where the quoted fields lie.
+function buildCsv() {
+  const expected = new Map();
+  const quoted = [];
+  let text = HEADER;
+  let withoutWard = 0;
+  let invalid = 0;
+
+  const appendQuoted = (value) => {
+    const field = quote(value);
+    quoted.push([text.length, text.length + field.length]);
+    text += field;
+  };
+
+  for (let i = 0; i < ROWS; ++i) {
+    const ward = i % 7 === 0 ? null : 1 + (i % 5);
+    const date = new Date(Date.UTC(2024, 0, 1 + (i % 40), 9, 30));
+    const [status, label] = STATUSES[i % STATUSES.length];
+    const category = CATEGORIES[i % CATEGORIES.length];
+    // Descriptions run over several lines, each with quotes and a comma and
+    // some ending in CRLF, so most of the file is inside quotes.
+    const description = Array.from(
+      { length: 8 + (i % 5) },
+      (unused, line) => `line ${line} of complaint ${i}: "deep", wide${line % 3 === 0 ? '\r' : ''}`
+    ).join('\n');
+
+    text += `${i + 1},`;
+    appendQuoted(`CMP-${i + 1}`);
+    text += ',';
+    appendQuoted(description);
+    // A quoted empty ward is an empty string, not NULL, and so not a ward.
+    const invalidWard = i % 97 === 0;
+    text += `,${invalidWard ? '""' : ward === null ? '' : ward},`;
+    text += `${date.toISOString().replace('T', ' ').replace('Z', '+00')},`;
+    text += `${status},`;
+    if (category.includes(',') || category.includes('"')) {
+      appendQuoted(category);
+    } else {
+      text += category;
+    }
+    text += i % 2 === 0 ? '\r\n' : '\n';
+
+    if (invalidWard) {
+      ++invalid;
+      continue;
+    }
+    if (ward === null) {
+      ++withoutWard;
+    }
+    const wardId = ward === null ? addon.unassignedWardId : ward;
+    const key = [wardId, Math.floor(date.getTime() / MS_PER_DAY), label, category].join('|');
+    expected.set(key, (expected.get(key) || 0) + 1);
+  }
+  // A blank CRLF line is skipped, and the last row needs no line break.
+  text += '\r\n';
+  text += `${ROWS + 1},"CMP-last","last",3,2024-03-01 00:00:00+00,Closed,drain`;
+  const lastKey = [3, Date.UTC(2024, 2, 1) / MS_PER_DAY, 'Closed', 'drain'].join('|');
+  expected.set(lastKey, (expected.get(lastKey) || 0) + 1);
+
+  return { text, quoted, expected, rows: ROWS + 1, withoutWard, invalid };
+}
+
+// Where AggregateComplaintCsv splits the body between |threads| threads.
+function chunkBoundaries(size, threads) {
+  const body = HEADER.length;
+  const bodySize = size - body;
+  const count = Math.max(1, Math.min(threads, Math.floor(bodySize / 4096) + 1));
+  const chunkSize = Math.ceil(bodySize / count);
+  return Array.from({ length: count - 1 }, (unused, i) => body + chunkSize * (i + 1));
+}
+
+function toCounts(batch) {
+  const counts = new Map();
+  for (let i = 0; i < batch.counts.length; ++i) {
+    const key = [
+      batch.wardIds[i],
+      batch.days[i],
+      addon.statuses[batch.statuses[i]],
+      batch.categories[batch.categoryIds[i]],
+    ].join('|');
+    counts.set(key, (counts.get(key) || 0) + batch.counts[i]);
+  }
+  return counts;
+}
+
+let directory;
+let csv;
+let path;
+
+before(() => {
+  if (skip) {
+    return;
+  }
+  directory = mkdtempSync(join(tmpdir(), 'ward-statistics-'));
+  path = join(directory, 'complaints.csv');
+  csv = buildCsv();
+  writeFileSync(path, csv.text);
+});
+
+after(() => {
+  if (directory) {
+    rmSync(directory, { recursive: true, force: true });
+  }
+});
+
+for (const threads of [1, 2, 3, 7, 16]) {
+  test(`aggregates the export with ${threads} thread(s)`, { skip }, async () => {
+    const boundaries = chunkBoundaries(csv.text.length, threads);
+    assert.equal(boundaries.length, threads - 1);
+    const insideQuotes = boundaries.filter((at) => csv.quoted.some(([start, end]) => at > start && at < end - 1));
+    assert.ok(threads === 1 || insideQuotes.length > 0, 'no chunk boundary falls inside a quoted field');
+
+    const batch = await addon.aggregateComplaintCsv(path, threads);
+    assert.equal(batch.rows, csv.rows);
+    assert.equal(batch.withoutWard, csv.withoutWard);
+    assert.equal(batch.invalid, csv.invalid);
+    assert.deepEqual(toCounts(batch), csv.expected);
+  });
+}
+
+test('rejects an export without the needed columns', { skip }, async () => {
+  const headerless = join(directory, 'headerless.csv');
+  writeFileSync(headerless, '1,"CMP-1",,2024-01-01,Submitted,pothole\n');
+  await assert.rejects(addon.aggregateComplaintCsv(headerless, 2), /must name ward_id/);
+});
@@ -3,10 +3,29 @@ import 'package:get/get.dart';
 import 'package:dio/dio.dart';
 import '../services/api_service.dart';
 import '../services/cloudinary_service.dart';
+import '../services/native_metrics.dart';
 
 class ComplaintController extends GetxController {
   final ApiService _apiService = ApiService();
   final CloudinaryService _cloudinaryService = CloudinaryService();
+
+  // Latency of each stage of submitComplaint, exported by the Linux runner.
+  final LatencyHistogram _submitLatency = NativeMetrics().histogram(
+    'submit_complaint_seconds',
+    'Time to upload images and create a complaint, successful or not.',
+  );
+  final LatencyHistogram _uploadLatency = NativeMetrics().histogram(
+    'submit_upload_seconds',
+    'Time to upload all images of a complaint.',
+  );
+  final LatencyHistogram _postLatency = NativeMetrics().histogram(
+    'submit_post_seconds',
+    'Time for POST /complaints to respond.',
+  );
+  final MetricCounter _submitFailures = NativeMetrics().counter(
+    'submit_complaint_failures',
+    'Complaint submissions that did not succeed.',
+  );
   
   var isLoading = false.obs;
   var isUploading = false.obs;
@@ -25,6 +44,8 @@ class ComplaintController extends GetxController {
     required List<File> imageFiles,
     bool isAnonymous = false,
   }) async {
+    final started = NativeMetrics().nowNs();
+    var succeeded = false;
     try {
       isLoading.value = true;
       isUploading.value = true;
@@ -33,7 +54,7 @@ class ComplaintController extends GetxController {
       List<String> imageUrls = [];
       if (imageFiles.isNotEmpty) {
         Get.snackbar('Uploading', 'Uploading images...');
-        imageUrls = await _cloudinaryService.uploadMultipleImages(imageFiles);
+        imageUrls = await _uploadLatency.time(() => _cloudinaryService.uploadMultipleImages(imageFiles));
         
         if (imageUrls.isEmpty) {
           Get.snackbar('Error', 'Failed to upload images');
@@ -45,7 +66,7 @@ class ComplaintController extends GetxController {
       Get.snackbar('Submitting', 'Submitting complaint...');
       
       // Submit complaint to backend
-      final response = await _apiService.submitComplaint(
+      final response = await _postLatency.time(() => _apiService.submitComplaint(
         title: title,
         description: description,
         locationAddress: locationAddress,
@@ -54,9 +75,10 @@ class ComplaintController extends GetxController {
         category: category,
         images: imageUrls,
         isAnonymous: isAnonymous,
-      );
+      ));
       
       if (response.statusCode == 201 || response.statusCode == 200) {
+        succeeded = true;
         Get.snackbar('Success', 'Complaint submitted successfully');
         return true;
       }
@@ -71,6 +93,8 @@ class ComplaintController extends GetxController {
       Get.snackbar('Error', 'An unexpected error occurred: $e');
       return false;
     } finally {
+      _submitLatency.recordNs(NativeMetrics().nowNs() - started);
+      if (!succeeded) _submitFailures.increment();
       isLoading.value = false;
       isUploading.value = false;
     }
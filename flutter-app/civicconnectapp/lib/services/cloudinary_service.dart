@@ -2,6 +2,7 @@ import 'dart:io';
 import 'package:dio/dio.dart';
 import 'package:crypto/crypto.dart';
 import 'dart:convert';
+import 'native_metrics.dart';
 
 class CloudinaryService {
   // Use environment variables or pass these in
@@ -11,15 +12,27 @@ class CloudinaryService {
   
   // Default upload preset for development - create this in Cloudinary or pass via env
   static const String defaultUploadPreset = String.fromEnvironment('CLOUDINARY_UPLOAD_PRESET', defaultValue: 'civic_connect_unsigned');
+
+  // Overrides the upload endpoint, e.g. to point at the load generator's local
+  // stand-in: --dart-define=CLOUDINARY_UPLOAD_URL=http://<host>:<port>/v1_1/local/image/upload
+  static const String uploadUrl = String.fromEnvironment('CLOUDINARY_UPLOAD_URL');
   
   final Dio _dio = Dio();
+  final LatencyHistogram _uploadLatency = NativeMetrics().histogram(
+    'cloudinary_upload_seconds',
+    'Time to upload one image to Cloudinary.',
+  );
+  final MetricCounter _uploadFailures = NativeMetrics().counter(
+    'cloudinary_upload_failures',
+    'Images that failed to upload to Cloudinary.',
+  );
 
   /// Upload image to Cloudinary using UNSIGNED upload
   /// Requires an upload preset to be configured in Cloudinary Dashboard
   Future<String> uploadImage(File imageFile, {String? uploadPreset}) async {
     try {
       final preset = uploadPreset ?? defaultUploadPreset;
-      final url = 'https://api.cloudinary.com/v1_1/$cloudName/image/upload';
+      final url = uploadUrl.isNotEmpty ? uploadUrl : 'https://api.cloudinary.com/v1_1/$cloudName/image/upload';
       
       // Create form data validation
       FormData formData = FormData.fromMap({
@@ -32,7 +45,7 @@ class CloudinaryService {
       });
 
       // Upload to Cloudinary
-      final response = await _dio.post(
+      final response = await _uploadLatency.time(() => _dio.post(
         url,
         data: formData,
         options: Options(
@@ -40,7 +53,7 @@ class CloudinaryService {
             'Content-Type': 'multipart/form-data',
           },
         ),
-      );
+      ));
 
       if (response.statusCode == 200) {
         return response.data['secure_url'];
@@ -62,6 +75,7 @@ class CloudinaryService {
         String url = await uploadImage(imageFile, uploadPreset: uploadPreset);
         uploadedUrls.add(url);
       } catch (e) {
+        _uploadFailures.increment();
         print('Failed to upload ${imageFile.path}: $e');
       }
     }
@@ -0,0 +1,50 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'package:ffi/ffi.dart';
+
+typedef _SummaryNative = Int32 Function(Pointer<Utf8>, Int32);
+typedef _Summary = int Function(Pointer<Utf8>, int);
+
+/// Frame timing collected by the Linux runner (linux/native/frame_timing.h)
+/// from the window's frame clock and main loop. The same summary is written
+/// to ~/.cache/civicconnect/frame_timing.json on exit.
+class NativeFrameTiming {
+  static final NativeFrameTiming _instance = NativeFrameTiming._internal();
+  factory NativeFrameTiming() => _instance;
+
+  NativeFrameTiming._internal() {
+    if (!Platform.isLinux) return;
+    try {
+      _summary = DynamicLibrary.process().lookupFunction<_SummaryNative, _Summary>('civic_frame_timing_summary');
+    } on ArgumentError {
+      print('Native frame timing unavailable; runner does not export civic_frame_timing_summary');
+    }
+  }
+
+  _Summary? _summary;
+
+  /// Returns frame interval percentiles (`p50_ms`, `p95_ms`, `p99_ms`,
+  /// `max_ms`), `missed_vsyncs`, `stalls`, `longest_stall_ms` and the
+  /// `longest_stall_stack` sampled during it, and the `idle_intervals` left out
+  /// of the percentiles with `longest_idle_ms`, or null when not available.
+  Map<String, dynamic>? summary() {
+    final summary = _summary;
+    if (summary == null) return null;
+
+    var capacity = 4096;
+    while (true) {
+      final buffer = malloc<Uint8>(capacity).cast<Utf8>();
+      try {
+        final length = summary(buffer, capacity);
+        if (length < 0) return null;
+        if (length < capacity) {
+          return jsonDecode(buffer.toDartString(length: length)) as Map<String, dynamic>;
+        }
+        capacity = length + 1;
+      } finally {
+        malloc.free(buffer);
+      }
+    }
+  }
+}
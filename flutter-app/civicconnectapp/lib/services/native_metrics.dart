@@ -0,0 +1,106 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'package:ffi/ffi.dart';
+
+typedef _RegisterNative = Int32 Function(Pointer<Utf8>, Pointer<Utf8>);
+typedef _Register = int Function(Pointer<Utf8>, Pointer<Utf8>);
+typedef _RecordNative = Void Function(Int32, Int64);
+typedef _Record = void Function(int, int);
+typedef _QuantileNative = Int64 Function(Int32, Double);
+typedef _Quantile = int Function(int, double);
+typedef _NowNative = Int64 Function();
+typedef _Now = int Function();
+
+/// Latency histograms and counters kept by the Linux runner
+/// (linux/native/metrics.h) and dumped to ~/.cache/civicconnect/metrics.prom.
+///
+/// On other platforms, or if the runner does not export the symbols, every
+/// call is a no-op so callers never need to check.
+class NativeMetrics {
+  static final NativeMetrics _instance = NativeMetrics._internal();
+  factory NativeMetrics() => _instance;
+
+  NativeMetrics._internal() {
+    if (!Platform.isLinux) return;
+    try {
+      final lib = DynamicLibrary.process();
+      _histogram = lib.lookupFunction<_RegisterNative, _Register>('civic_metrics_histogram');
+      _counter = lib.lookupFunction<_RegisterNative, _Register>('civic_metrics_counter');
+      _record = lib.lookupFunction<_RecordNative, _Record>('civic_metrics_record', isLeaf: true);
+      _increment = lib.lookupFunction<_RecordNative, _Record>('civic_metrics_increment', isLeaf: true);
+      _quantile = lib.lookupFunction<_QuantileNative, _Quantile>('civic_metrics_quantile');
+      _now = lib.lookupFunction<_NowNative, _Now>('civic_metrics_now_ns', isLeaf: true);
+    } on ArgumentError {
+      print('Native metrics unavailable; runner does not export civic_metrics_*');
+      _histogram = null;
+    }
+  }
+
+  _Register? _histogram;
+  _Register? _counter;
+  _Record? _record;
+  _Record? _increment;
+  _Quantile? _quantile;
+  _Now? _now;
+
+  /// Returns the histogram called [name], registering it on first use.
+  /// Names should end in their unit, e.g. `submit_upload_seconds`.
+  LatencyHistogram histogram(String name, String help) =>
+      LatencyHistogram._(this, _register(_histogram, name, help));
+
+  /// Returns the counter called [name], registering it on first use.
+  /// It is exported with a `_total` suffix.
+  MetricCounter counter(String name, String help) =>
+      MetricCounter._(this, _register(_counter, name, help));
+
+  /// Monotonic timestamp in nanoseconds, on the same clock native code uses.
+  int nowNs() => _now?.call() ?? DateTime.now().microsecondsSinceEpoch * 1000;
+
+  int _register(_Register? register, String name, String help) {
+    if (register == null) return -1;
+    final nativeName = name.toNativeUtf8();
+    final nativeHelp = help.toNativeUtf8();
+    try {
+      return register(nativeName, nativeHelp);
+    } finally {
+      malloc.free(nativeName);
+      malloc.free(nativeHelp);
+    }
+  }
+}
+
+class LatencyHistogram {
+  final NativeMetrics _metrics;
+  final int _handle;
+
+  LatencyHistogram._(this._metrics, this._handle);
+
+  void recordNs(int nanoseconds) => _metrics._record?.call(_handle, nanoseconds);
+
+  void record(Duration duration) => recordNs(duration.inMicroseconds * 1000);
+
+  /// Records how long [action] takes to complete, whether or not it throws.
+  Future<T> time<T>(Future<T> Function() action) async {
+    final start = _metrics.nowNs();
+    try {
+      return await action();
+    } finally {
+      recordNs(_metrics.nowNs() - start);
+    }
+  }
+
+  /// Value at quantile [q] (0 to 1) in milliseconds, or null if unavailable.
+  double? quantileMs(double q) {
+    final ns = _metrics._quantile?.call(_handle, q) ?? -1;
+    return ns < 0 ? null : ns / 1e6;
+  }
+}
+
+class MetricCounter {
+  final NativeMetrics _metrics;
+  final int _handle;
+
+  MetricCounter._(this._metrics, this._handle);
+
+  void increment([int delta = 1]) => _metrics._increment?.call(_handle, delta);
+}
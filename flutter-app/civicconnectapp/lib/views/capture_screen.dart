@@ -5,6 +5,7 @@ import 'package:image_picker/image_picker.dart';
 import 'package:geolocator/geolocator.dart';
 import 'package:permission_handler/permission_handler.dart';
 import '../controllers/complaint_controller.dart';
+import '../services/native_metrics.dart';
 
 class CaptureScreen extends StatefulWidget {
   const CaptureScreen({super.key});
@@ -16,6 +17,10 @@ class CaptureScreen extends StatefulWidget {
 class _CaptureScreenState extends State<CaptureScreen> {
   final ComplaintController complaintController = Get.put(ComplaintController());
   final ImagePicker _picker = ImagePicker();
+  final LatencyHistogram _pickLatency = NativeMetrics().histogram(
+    'capture_pick_seconds',
+    'Time from opening the camera or gallery picker to getting an image back, including user time.',
+  );
 
   Future<void> _captureImage() async {
     // Request camera permission
@@ -44,10 +49,10 @@ class _CaptureScreenState extends State<CaptureScreen> {
     }
 
     // Capture image
-    final XFile? photo = await _picker.pickImage(
+    final XFile? photo = await _pickLatency.time(() => _picker.pickImage(
       source: ImageSource.camera,
       imageQuality: 80,
-    );
+    ));
 
     if (photo != null) {
       // Show complaint form dialog
@@ -56,10 +61,10 @@ class _CaptureScreenState extends State<CaptureScreen> {
   }
 
   Future<void> _pickFromGallery() async {
-    final XFile? image = await _picker.pickImage(
+    final XFile? image = await _pickLatency.time(() => _picker.pickImage(
       source: ImageSource.gallery,
       imageQuality: 80,
-    );
+    ));
 
     if (image != null) {
       _showComplaintForm(File(image.path));
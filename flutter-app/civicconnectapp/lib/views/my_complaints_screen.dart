@@ -2,6 +2,7 @@ import 'package:flutter/material.dart';
 import 'package:flutter/foundation.dart';
 import 'package:get/get.dart';
 import '../controllers/complaint_controller.dart';
+import '../services/native_frame_timing.dart';
 
 class MyComplaintsScreen extends StatefulWidget {
   const MyComplaintsScreen({super.key});
@@ -26,6 +27,17 @@ class _MyComplaintsScreenState extends State<MyComplaintsScreen> {
     _loadComplaints();
   }
 
+  @override
+  void dispose() {
+    // Scrolling this list is where jank shows up on slower hardware.
+    final frameTiming = kDebugMode ? NativeFrameTiming().summary() : null;
+    if (frameTiming != null) {
+      _log('🎞️ Frame timing: p50 ${frameTiming['p50_ms']} ms, p99 ${frameTiming['p99_ms']} ms, '
+          'missed vsyncs ${frameTiming['missed_vsyncs']}, longest stall ${frameTiming['longest_stall_ms']} ms');
+    }
+    super.dispose();
+  }
+
   Future<void> _loadComplaints() async {
     try {
       _log('📥 Fetching complaints with status: $selectedStatus');
@@ -0,0 +1,213 @@
+#include "native/annotation_renderer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "native/bitmap_font.h"
+#include "native/jpeg_codec.h"
+
+namespace {
+
+// Outline width and label metrics matching _draw_box.
+constexpr int kBoxThickness = 2;
+constexpr int kLabelScale = 2;
+constexpr int kLabelPadding = 5;
+constexpr int kLegendScale = 2;
+constexpr int kLegendX = 10;
+constexpr int kLegendBaseline = 30;
+
+// Exact x / 255 for x in [0, 255 * 255], rounded to nearest.
+inline uint32_t Div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+inline void BlendPixel(uint8_t* pixel, Rgba color, uint32_t alpha) {
+  const uint32_t inverse = 255 - alpha;
+  pixel[0] = static_cast<uint8_t>(Div255(pixel[0] * inverse + color.r * alpha));
+  pixel[1] = static_cast<uint8_t>(Div255(pixel[1] * inverse + color.g * alpha));
+  pixel[2] = static_cast<uint8_t>(Div255(pixel[2] * inverse + color.b * alpha));
+  pixel[3] = static_cast<uint8_t>(Div255(pixel[3] * inverse + 255 * alpha));
+}
+
+#if defined(__SSE2__)
+inline __m128i Div255Epu16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Blends two pixels held as 16-bit lanes with per-lane |alpha|.
+inline __m128i BlendEpu16(__m128i pixels, __m128i color, __m128i alpha) {
+  const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+  return Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(pixels, inverse),
+                                   _mm_mullo_epi16(color, alpha)));
+}
+#endif
+
+// Blends |color| over |count| pixels starting at |dst|. If |coverage| is
+// non-null it holds one weight per pixel that scales the colour's alpha.
+void BlendSpan(uint8_t* dst, int count, Rgba color, const uint8_t* coverage) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  // The alpha channel blends towards opaque.
+  const __m128i color16 =
+      _mm_setr_epi16(color.r, color.g, color.b, 255, color.r, color.g, color.b,
+                     255);
+  const __m128i color_alpha = _mm_set1_epi16(color.a);
+  for (; i + 4 <= count; i += 4) {
+    uint8_t* p = dst + i * 4;
+    __m128i alpha_lo = color_alpha;
+    __m128i alpha_hi = color_alpha;
+    if (coverage != nullptr) {
+      int32_t packed;
+      memcpy(&packed, coverage + i, sizeof(packed));
+      // Replicate each coverage byte across its pixel's four channels.
+      __m128i weights = _mm_cvtsi32_si128(packed);
+      weights = _mm_unpacklo_epi8(weights, weights);
+      weights = _mm_unpacklo_epi16(weights, weights);
+      alpha_lo = Div255Epu16(
+          _mm_mullo_epi16(_mm_unpacklo_epi8(weights, zero), color_alpha));
+      alpha_hi = Div255Epu16(
+          _mm_mullo_epi16(_mm_unpackhi_epi8(weights, zero), color_alpha));
+    }
+    const __m128i pixels = _mm_loadu_si128(reinterpret_cast<__m128i*>(p));
+    const __m128i lo =
+        BlendEpu16(_mm_unpacklo_epi8(pixels, zero), color16, alpha_lo);
+    const __m128i hi =
+        BlendEpu16(_mm_unpackhi_epi8(pixels, zero), color16, alpha_hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    const uint32_t alpha =
+        coverage != nullptr ? Div255(coverage[i] * color.a) : color.a;
+    BlendPixel(dst + i * 4, color, alpha);
+  }
+}
+
+}  // namespace
+
+constexpr Rgba AnnotationRenderer::kGarbageColor;
+constexpr Rgba AnnotationRenderer::kPotholeColor;
+constexpr Rgba AnnotationRenderer::kLabelTextColor;
+
+AnnotationRenderer::AnnotationRenderer(const RgbaImage& image)
+    : image_(image), dirty_top_(image.height), dirty_bottom_(0) {}
+
+void AnnotationRenderer::FillRect(int x1, int y1, int x2, int y2, Rgba color) {
+  x1 = std::max(x1, 0);
+  y1 = std::max(y1, 0);
+  x2 = std::min(x2, image_.width);
+  y2 = std::min(y2, image_.height);
+  if (x1 >= x2 || y1 >= y2 || color.a == 0) {
+    return;
+  }
+  MarkDirty(y1, y2);
+  for (int y = y1; y < y2; ++y) {
+    BlendSpan(image_.Row(y) + x1 * 4, x2 - x1, color, nullptr);
+  }
+}
+
+void AnnotationRenderer::DrawBox(const BoundingBox& box, Rgba color,
+                                 int thickness) {
+  const int x1 = static_cast<int>(box.x1);
+  const int y1 = static_cast<int>(box.y1);
+  const int x2 = static_cast<int>(box.x2);
+  const int y2 = static_cast<int>(box.y2);
+  if (x2 - x1 <= 2 * thickness || y2 - y1 <= 2 * thickness) {
+    FillRect(x1, y1, x2, y2, color);
+    return;
+  }
+  // Edges are drawn without overlapping so translucent colours blend once.
+  FillRect(x1, y1, x2, y1 + thickness, color);
+  FillRect(x1, y2 - thickness, x2, y2, color);
+  FillRect(x1, y1 + thickness, x1 + thickness, y2 - thickness, color);
+  FillRect(x2 - thickness, y1 + thickness, x2, y2 - thickness, color);
+}
+
+void AnnotationRenderer::BlendMask(const SegmentationMask& mask, Rgba color) {
+  const int x1 = std::max(mask.x, 0);
+  const int y1 = std::max(mask.y, 0);
+  const int x2 = std::min(mask.x + mask.width, image_.width);
+  const int y2 = std::min(mask.y + mask.height, image_.height);
+  if (mask.coverage == nullptr || x1 >= x2 || y1 >= y2 || color.a == 0) {
+    return;
+  }
+  MarkDirty(y1, y2);
+  for (int y = y1; y < y2; ++y) {
+    const uint8_t* coverage = mask.coverage +
+                              static_cast<size_t>(y - mask.y) * mask.stride +
+                              (x1 - mask.x);
+    BlendSpan(image_.Row(y) + x1 * 4, x2 - x1, color, coverage);
+  }
+}
+
+void AnnotationRenderer::DrawText(int x, int y, const char* text, Rgba color,
+                                  int scale) {
+  for (int pen_x = x; *text != '\0'; ++text, pen_x += kGlyphAdvance * scale) {
+    const uint8_t* columns = GlyphColumns(*text);
+    for (int row = 0; row < kGlyphHeight; ++row) {
+      // Merge horizontally adjacent set pixels into a single span.
+      int column = 0;
+      while (column < kGlyphWidth) {
+        if ((columns[column] & (1 << row)) == 0) {
+          ++column;
+          continue;
+        }
+        const int start = column;
+        while (column < kGlyphWidth && (columns[column] & (1 << row)) != 0) {
+          ++column;
+        }
+        FillRect(pen_x + start * scale, y + row * scale, pen_x + column * scale,
+                 y + (row + 1) * scale, color);
+      }
+    }
+  }
+}
+
+void AnnotationRenderer::DrawDetection(const Detection& detection, Rgba color) {
+  DrawBox(detection.box, color, kBoxThickness);
+
+  char label[64];
+  snprintf(label, sizeof(label), "%s: %.2f", detection.class_name,
+           detection.confidence);
+  const int x1 = static_cast<int>(detection.box.x1);
+  const int y1 = static_cast<int>(detection.box.y1);
+  const int label_width = MeasureText(label, kLabelScale);
+  const int label_height = kGlyphCapHeight * kLabelScale;
+  FillRect(x1, y1 - label_height - 2 * kLabelPadding, x1 + label_width, y1,
+           color);
+  DrawText(x1, y1 - label_height - kLabelPadding, label, kLabelTextColor,
+           kLabelScale);
+}
+
+void AnnotationRenderer::DrawLegend() {
+  DrawText(kLegendX, kLegendBaseline - kGlyphCapHeight * kLegendScale,
+           "Green: Garbage | Red: Pothole", kLabelTextColor, kLegendScale);
+}
+
+void AnnotationRenderer::MarkDirty(int y1, int y2) {
+  dirty_top_ = std::min(dirty_top_, y1);
+  dirty_bottom_ = std::max(dirty_bottom_, y2);
+}
+
+bool RenderAnnotatedJpeg(const RgbaImage& image,
+                         const std::vector<Detection>& garbage_detections,
+                         const std::vector<Detection>& pothole_detections,
+                         int quality, std::vector<uint8_t>* jpeg) {
+  AnnotationRenderer renderer(image);
+  for (const Detection& detection : garbage_detections) {
+    renderer.DrawDetection(detection, AnnotationRenderer::kGarbageColor);
+  }
+  for (const Detection& detection : pothole_detections) {
+    renderer.DrawDetection(detection, AnnotationRenderer::kPotholeColor);
+  }
+  renderer.DrawLegend();
+  return EncodeJpeg(image, quality, jpeg);
+}
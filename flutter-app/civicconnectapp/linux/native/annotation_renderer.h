@@ -0,0 +1,77 @@
+#ifndef NATIVE_ANNOTATION_RENDERER_H_
+#define NATIVE_ANNOTATION_RENDERER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "native/image_types.h"
+
+// Per-pixel coverage (0-255) of a segmentation mask, positioned at (x, y) in
+// image coordinates. Usually the mask of a single detection cropped to its box.
+struct SegmentationMask {
+  const uint8_t* coverage = nullptr;
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+  size_t stride = 0;
+};
+
+// Draws detection annotations directly into a decoded RGBA buffer.
+//
+// This is the native counterpart of CivicInference.annotate/_draw_box in
+// Ai-Model/model.ipynb. Drawing happens in place, without copying the image,
+// and every operation is clipped so only the rows and columns it covers are
+// read or written. Blending uses SSE2 where available.
+class AnnotationRenderer {
+ public:
+  // Colours used by CivicInference.annotate.
+  static constexpr Rgba kGarbageColor = {0, 255, 0, 255};
+  static constexpr Rgba kPotholeColor = {255, 0, 0, 255};
+  static constexpr Rgba kLabelTextColor = {255, 255, 255, 255};
+
+  // |image| must stay valid for the lifetime of the renderer.
+  explicit AnnotationRenderer(const RgbaImage& image);
+
+  // Blends |color| over the rectangle [x1, x2) x [y1, y2).
+  void FillRect(int x1, int y1, int x2, int y2, Rgba color);
+
+  // Draws the outline of |box| |thickness| pixels wide, inside the box.
+  void DrawBox(const BoundingBox& box, Rgba color, int thickness);
+
+  // Blends |color| over the image weighted by the mask's coverage.
+  void BlendMask(const SegmentationMask& mask, Rgba color);
+
+  // Draws |text| with the embedded bitmap font, with its top-left corner at
+  // (x, y) and each font pixel |scale| pixels square.
+  void DrawText(int x, int y, const char* text, Rgba color, int scale);
+
+  // Draws |detection|'s box with a "name: 0.87" label above it.
+  void DrawDetection(const Detection& detection, Rgba color);
+
+  // Draws the "Green: Garbage | Red: Pothole" legend in the top-left corner.
+  void DrawLegend();
+
+  // The range of rows [dirty_top, dirty_bottom) modified so far. Empty when
+  // dirty_top >= dirty_bottom.
+  int dirty_top() const { return dirty_top_; }
+  int dirty_bottom() const { return dirty_bottom_; }
+
+ private:
+  void MarkDirty(int y1, int y2);
+
+  RgbaImage image_;
+  int dirty_top_;
+  int dirty_bottom_;
+};
+
+// Annotates |image| in place with all detections and the legend, then encodes
+// it as JPEG into |jpeg|. Equivalent to CivicInference.annotate_to_base64
+// without the base64 stage, for native consumers.
+bool RenderAnnotatedJpeg(const RgbaImage& image,
+                         const std::vector<Detection>& garbage_detections,
+                         const std::vector<Detection>& pothole_detections,
+                         int quality, std::vector<uint8_t>* jpeg);
+
+#endif  // NATIVE_ANNOTATION_RENDERER_H_
@@ -0,0 +1,101 @@
+// The buffer pool and tensor arena against the system allocator, for the
+// allocation patterns of the detection path.
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "native/bench/bench.h"
+#include "native/buffer_pool.h"
+#include "native/tensor_arena.h"
+
+namespace {
+
+// The 640x640 float input tensor, the largest per-image buffer.
+constexpr size_t kTensorBytes = 3 * 640 * 640 * sizeof(float);
+constexpr size_t kPageBytes = 4096;
+
+// Sizes of the temporaries one request takes from the arena, roughly those
+// of YOLO parsing: candidate indices, scores, boxes and keep flags.
+const size_t kRequestSizes[] = {33600, 33600, 134400, 8400, 4096, 1024,
+                                2048,  512,   16384,  256,  64,   33600};
+
+// Writes one byte per page, so every page is faulted in as when the buffer is
+// filled.
+void TouchPages(void* data, size_t size) {
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  for (size_t offset = 0; offset < size; offset += kPageBytes) {
+    bytes[offset] = 1;
+  }
+}
+
+bool BenchPoolTensor(BenchState* state) {
+  BufferPool pool;
+  while (state->Loop()) {
+    PooledBuffer buffer = pool.Acquire(kTensorBytes);
+    TouchPages(buffer.data(), kTensorBytes);
+  }
+  return true;
+}
+
+bool BenchMallocTensor(BenchState* state) {
+  while (state->Loop()) {
+    void* buffer = aligned_alloc(kTensorAlignment, kTensorBytes);
+    if (buffer == nullptr) {
+      return false;
+    }
+    TouchPages(buffer, kTensorBytes);
+    free(buffer);
+  }
+  return true;
+}
+
+bool BenchArenaRequest(BenchState* state) {
+  TensorArena arena;
+  state->set_items_per_iteration(sizeof(kRequestSizes) /
+                                 sizeof(kRequestSizes[0]));
+  while (state->Loop()) {
+    for (const size_t size : kRequestSizes) {
+      KeepAlive(arena.Allocate(size));
+    }
+    arena.Reset();
+  }
+  return true;
+}
+
+bool BenchNewDeleteRequest(BenchState* state) {
+  constexpr size_t kCount = sizeof(kRequestSizes) / sizeof(kRequestSizes[0]);
+  void* buffers[kCount];
+  state->set_items_per_iteration(kCount);
+  while (state->Loop()) {
+    for (size_t i = 0; i < kCount; ++i) {
+      buffers[i] = ::operator new(kRequestSizes[i]);
+      KeepAlive(buffers[i]);
+    }
+    for (size_t i = 0; i < kCount; ++i) {
+      ::operator delete(buffers[i]);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void AddAllocatorBenchmarks(const BenchCorpus& corpus,
+                            std::vector<Benchmark>* benchmarks) {
+  const struct {
+    const char* name;
+    bool (*run)(BenchState* state);
+  } kCases[] = {
+      {"alloc/buffer_pool_tensor", BenchPoolTensor},
+      {"alloc/malloc_tensor", BenchMallocTensor},
+      {"alloc/tensor_arena_request", BenchArenaRequest},
+      {"alloc/new_delete_request", BenchNewDeleteRequest},
+  };
+  for (const auto& benchmark_case : kCases) {
+    const auto run = benchmark_case.run;
+    benchmarks->push_back(
+        {benchmark_case.name,
+         [run](const BenchCorpus&, BenchState* state) { return run(state); }});
+  }
+}
@@ -0,0 +1,134 @@
+#include "native/bench/bench.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "native/jpeg_codec.h"
+#include "native/metrics.h"
+
+namespace {
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Calls |parse| with each line of |path| that is not blank or a comment.
+// Returns false if the file cannot be read or |parse| rejects a line.
+bool ForEachLine(const std::string& path,
+                 const std::function<bool(std::istringstream*)>& parse,
+                 std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = "cannot read " + path;
+    return false;
+  }
+  std::string line;
+  int number = 0;
+  while (std::getline(file, line)) {
+    ++number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    if (!parse(&fields) || fields.fail()) {
+      *error = path + ":" + std::to_string(number) + ": malformed line";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseModel(std::istringstream* fields, bool* pothole) {
+  std::string model;
+  *fields >> model;
+  *pothole = model == "pothole";
+  return *pothole || model == "garbage";
+}
+
+}  // namespace
+
+bool BenchState::Loop() {
+  if (!started_) {
+    started_ = true;
+    start_ns_ = MetricsNowNs();
+  }
+  if (remaining_-- > 0) {
+    return true;
+  }
+  end_ns_ = MetricsNowNs();
+  return false;
+}
+
+bool LoadBenchCorpus(const std::string& dir, BenchCorpus* corpus,
+                     std::string* error) {
+  std::vector<std::string> names;
+  DIR* handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    *error = "cannot open " + dir;
+    return false;
+  }
+  while (dirent* entry = readdir(handle)) {
+    const std::string name = entry->d_name;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".jpg") == 0) {
+      names.push_back(name.substr(0, name.size() - 4));
+    }
+  }
+  closedir(handle);
+  std::sort(names.begin(), names.end());
+  if (names.empty()) {
+    *error = "no JPEGs in " + dir;
+    return false;
+  }
+  for (const std::string& name : names) {
+    BenchCorpus::Jpeg jpeg;
+    jpeg.name = name;
+    const std::string path = dir + "/" + name + ".jpg";
+    if (!ReadFile(path, &jpeg.data) ||
+        !ReadJpegSize(jpeg.data.data(), jpeg.data.size(), &jpeg.width,
+                      &jpeg.height)) {
+      *error = "cannot read " + path;
+      return false;
+    }
+    corpus->jpegs.push_back(std::move(jpeg));
+  }
+
+  if (!ForEachLine(
+          dir + "/yolo_objects.txt",
+          [corpus](std::istringstream* fields) {
+            BenchCorpus::YoloObject object;
+            if (!ParseModel(fields, &object.pothole)) {
+              return false;
+            }
+            *fields >> object.class_id >> object.cx >> object.cy >>
+                object.width >> object.height >> object.score;
+            corpus->yolo_objects.push_back(object);
+            return true;
+          },
+          error)) {
+    return false;
+  }
+  return ForEachLine(
+      dir + "/dashcam_tracks.txt",
+      [corpus](std::istringstream* fields) {
+        BenchCorpus::TrackObject object;
+        if (!ParseModel(fields, &object.pothole)) {
+          return false;
+        }
+        *fields >> object.class_id >> object.first_frame >>
+            object.last_frame >> object.box.x1 >> object.box.y1 >>
+            object.box.x2 >> object.box.y2 >> object.dx >> object.dy >>
+            object.growth;
+        corpus->track_objects.push_back(object);
+        return object.first_frame <= object.last_frame;
+      },
+      error);
+}
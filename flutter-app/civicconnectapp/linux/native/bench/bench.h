@@ -0,0 +1,137 @@
+#ifndef NATIVE_BENCH_BENCH_H_
+#define NATIVE_BENCH_BENCH_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "native/image_types.h"
+
+// Fixed inputs for the benchmarks, loaded from bench/corpus so that results
+// from different builds and machines measure the same work.
+struct BenchCorpus {
+  struct Jpeg {
+    // File name without the extension, e.g. "dashcam_1280x720".
+    std::string name;
+    std::vector<uint8_t> data;
+    int width;
+    int height;
+  };
+
+  // An object in a YOLO output tensor; see yolo_objects.txt.
+  struct YoloObject {
+    bool pothole;
+    int class_id;
+    float cx;
+    float cy;
+    float width;
+    float height;
+    float score;
+  };
+
+  // An object in the dashcam sequence; see dashcam_tracks.txt.
+  struct TrackObject {
+    bool pothole;
+    int class_id;
+    int first_frame;
+    int last_frame;
+    BoundingBox box;
+    float dx;
+    float dy;
+    float growth;
+  };
+
+  std::vector<Jpeg> jpegs;
+  std::vector<YoloObject> yolo_objects;
+  std::vector<TrackObject> track_objects;
+};
+
+// Loads the corpus in |dir|. Returns false with |error| set if a file is
+// missing or malformed.
+bool LoadBenchCorpus(const std::string& dir, BenchCorpus* corpus,
+                     std::string* error);
+
+// Drives the timed loop of one benchmark run:
+//
+//   // Setup, not timed.
+//   while (state->Loop()) {
+//     // The operation being measured.
+//   }
+//
+// The clock starts on the first call to Loop() and stops when it returns
+// false.
+class BenchState {
+ public:
+  explicit BenchState(int64_t iterations) : remaining_(iterations) {}
+
+  bool Loop();
+
+  // Units of work per iteration, e.g. images or boxes, for throughput.
+  void set_items_per_iteration(int64_t items) { items_ = items; }
+  // Bytes processed per iteration, for throughput, and what they are:
+  // "jpeg" for compressed data, "rgba" for decoded pixels or "tensor" for
+  // model tensors. Printed next to the MB/s figure, since MB/s of compressed
+  // and of decoded bytes are not comparable.
+  void set_bytes_per_iteration(int64_t bytes, const char* kind) {
+    bytes_ = bytes;
+    bytes_kind_ = kind;
+  }
+
+  uint64_t elapsed_ns() const { return end_ns_ - start_ns_; }
+  int64_t items_per_iteration() const { return items_; }
+  int64_t bytes_per_iteration() const { return bytes_; }
+  const char* bytes_kind() const { return bytes_kind_; }
+
+ private:
+  int64_t remaining_;
+  bool started_ = false;
+  uint64_t start_ns_ = 0;
+  uint64_t end_ns_ = 0;
+  int64_t items_ = 1;
+  int64_t bytes_ = 0;
+  const char* bytes_kind_ = "";
+};
+
+struct Benchmark {
+  std::string name;
+  // Runs the loop in |state| over |corpus|. Returns false if the benchmark
+  // could not run, e.g. because an input failed to decode.
+  std::function<bool(const BenchCorpus& corpus, BenchState* state)> run;
+};
+
+// Keeps the compiler from optimizing away a result that is otherwise unused.
+template <typename T>
+inline void KeepAlive(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+// A small deterministic generator for synthesizing inputs from the corpus.
+class BenchRandom {
+ public:
+  explicit BenchRandom(uint64_t seed) : state_(seed | 1) {}
+
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return static_cast<uint32_t>(state_ >> 32);
+  }
+  // Uniform in [0, 1).
+  float Uniform() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+ private:
+  uint64_t state_;
+};
+
+// Benchmarks by area, appended to |benchmarks| in the order they are run.
+void AddImageBenchmarks(const BenchCorpus& corpus,
+                        std::vector<Benchmark>* benchmarks);
+void AddDetectionBenchmarks(const BenchCorpus& corpus,
+                            std::vector<Benchmark>* benchmarks);
+void AddGeoBenchmarks(const BenchCorpus& corpus,
+                      std::vector<Benchmark>* benchmarks);
+void AddAllocatorBenchmarks(const BenchCorpus& corpus,
+                            std::vector<Benchmark>* benchmarks);
+
+#endif  // NATIVE_BENCH_BENCH_H_
@@ -0,0 +1,612 @@
+// Microbenchmarks of the native image, detection, distance and allocation
+// code:
+//
+//   civicconnect_bench [--filter SUBSTRING] [--min-time-ms 200]
+//                      [--repetitions 5] [--corpus DIR] [--json FILE]
+//   civicconnect_bench --list
+//   civicconnect_bench --compare BASELINE.json CURRENT.json [--threshold 10]
+//
+// Inputs come from the fixed corpus in bench/corpus. Each benchmark is first
+// run with growing iteration counts until one run takes --min-time-ms, then
+// timed --repetitions more times at that count. The median time per
+// iteration is reported, with the fastest and slowest repetition as a guide
+// to the noise. Throughput is in MB/s of the bytes the benchmark names: "jpeg"
+// (compressed), "rgba" (decoded pixels) or "tensor"; otherwise in items/s.
+//
+// --compare matches the benchmarks of two --json result files by name and
+// exits with status 1 if any became slower by more than --threshold percent.
+// The files are parsed as JSON, so ones reformatted or rewritten by other
+// tools still compare. Compare results from the same machine and build type
+// only.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native/bench/bench.h"
+#include "native/int8_kernels.h"
+
+#ifndef CIVICCONNECT_BENCH_CORPUS_DIR
+#define CIVICCONNECT_BENCH_CORPUS_DIR "bench/corpus"
+#endif
+
+namespace {
+
+constexpr int64_t kMaxIterations = int64_t{1} << 30;
+
+struct Options {
+  std::string filter;
+  int min_time_ms = 200;
+  int repetitions = 5;
+  std::string corpus_dir = CIVICCONNECT_BENCH_CORPUS_DIR;
+  std::string json_path;
+  bool list = false;
+  std::string baseline_path;
+  std::string current_path;
+  double threshold_percent = 10;
+};
+
+struct Result {
+  std::string name;
+  int64_t iterations = 0;
+  double ns_per_op = 0;
+  double min_ns_per_op = 0;
+  double max_ns_per_op = 0;
+  double items_per_second = 0;
+  double bytes_per_second = 0;
+  std::string bytes_kind;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "usage: civicconnect_bench [--filter SUBSTRING] [--min-time-ms N] "
+          "[--repetitions N]\n"
+          "                          [--corpus DIR] [--json FILE]\n"
+          "       civicconnect_bench --list\n"
+          "       civicconnect_bench --compare BASELINE.json CURRENT.json "
+          "[--threshold PERCENT]\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* flag = argv[i];
+    if (strcmp(flag, "--list") == 0) {
+      options->list = true;
+      continue;
+    }
+    if (strcmp(flag, "--compare") == 0) {
+      if (i + 2 >= argc) {
+        return false;
+      }
+      options->baseline_path = argv[++i];
+      options->current_path = argv[++i];
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(flag, "--filter") == 0) {
+      options->filter = value;
+    } else if (strcmp(flag, "--min-time-ms") == 0) {
+      options->min_time_ms = atoi(value);
+    } else if (strcmp(flag, "--repetitions") == 0) {
+      options->repetitions = atoi(value);
+    } else if (strcmp(flag, "--corpus") == 0) {
+      options->corpus_dir = value;
+    } else if (strcmp(flag, "--json") == 0) {
+      options->json_path = value;
+    } else if (strcmp(flag, "--threshold") == 0) {
+      options->threshold_percent = atof(value);
+    } else {
+      return false;
+    }
+  }
+  return options->min_time_ms > 0 && options->repetitions > 0 &&
+         options->threshold_percent >= 0;
+}
+
+// Runs |benchmark| as described at the top of the file.
+bool Measure(const Benchmark& benchmark, const BenchCorpus& corpus,
+             const Options& options, Result* result) {
+  const uint64_t min_time_ns = static_cast<uint64_t>(options.min_time_ms) *
+                               1000000;
+  int64_t iterations = 1;
+  while (true) {
+    BenchState state(iterations);
+    if (!benchmark.run(corpus, &state)) {
+      return false;
+    }
+    const uint64_t elapsed_ns = std::max<uint64_t>(state.elapsed_ns(), 1);
+    if (elapsed_ns >= min_time_ns || iterations >= kMaxIterations) {
+      break;
+    }
+    // Aim a little past the target so that noise does not cost a round.
+    const double scale = std::min(
+        10.0, std::max(1.5, 1.2 * static_cast<double>(min_time_ns) /
+                                elapsed_ns));
+    iterations = std::min(
+        kMaxIterations,
+        static_cast<int64_t>(std::ceil(static_cast<double>(iterations) *
+                                       scale)));
+  }
+
+  std::vector<double> samples;
+  int64_t items = 1;
+  int64_t bytes = 0;
+  const char* bytes_kind = "";
+  for (int i = 0; i < options.repetitions; ++i) {
+    BenchState state(iterations);
+    if (!benchmark.run(corpus, &state)) {
+      return false;
+    }
+    samples.push_back(static_cast<double>(state.elapsed_ns()) / iterations);
+    items = state.items_per_iteration();
+    bytes = state.bytes_per_iteration();
+    bytes_kind = state.bytes_kind();
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t middle = samples.size() / 2;
+  result->name = benchmark.name;
+  result->iterations = iterations;
+  result->ns_per_op = samples.size() % 2 == 1
+                          ? samples[middle]
+                          : (samples[middle - 1] + samples[middle]) / 2;
+  result->min_ns_per_op = samples.front();
+  result->max_ns_per_op = samples.back();
+  result->items_per_second = items * 1e9 / result->ns_per_op;
+  result->bytes_per_second = bytes * 1e9 / result->ns_per_op;
+  result->bytes_kind = bytes_kind;
+  return true;
+}
+
+// Formats |ns| with a unit that keeps it readable.
+std::string FormatDuration(double ns) {
+  char text[32];
+  if (ns >= 1e6) {
+    snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+  } else if (ns >= 1e3) {
+    snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+  } else {
+    snprintf(text, sizeof(text), "%.1f ns", ns);
+  }
+  return text;
+}
+
+void PrintResult(const Result& result) {
+  char throughput[48];
+  if (result.bytes_per_second > 0) {
+    snprintf(throughput, sizeof(throughput), "%8.1f MB/s %s",
+             result.bytes_per_second / 1e6, result.bytes_kind.c_str());
+  } else {
+    snprintf(throughput, sizeof(throughput), "%8.3g items/s",
+             result.items_per_second);
+  }
+  printf("%-44s %12s  (%s - %s)  %s\n", result.name.c_str(),
+         FormatDuration(result.ns_per_op).c_str(),
+         FormatDuration(result.min_ns_per_op).c_str(),
+         FormatDuration(result.max_ns_per_op).c_str(), throughput);
+  fflush(stdout);
+}
+
+std::string CpuModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t colon = line.find(':');
+      return colon == std::string::npos ? std::string()
+                                        : line.substr(colon + 2);
+    }
+  }
+  return std::string();
+}
+
+// Writes |results| as JSON, one benchmark per line so that the files diff
+// and grep well.
+bool WriteJson(const std::string& path, const std::vector<Result>& results) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  char date[32];
+  const time_t now = time(nullptr);
+  tm utc;
+  gmtime_r(&now, &utc);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  std::string cpu = CpuModel();
+  std::replace(cpu.begin(), cpu.end(), '"', '\'');
+#ifdef NDEBUG
+  const char* build = "release";
+#else
+  const char* build = "debug";
+#endif
+  fprintf(file,
+          "{\n  \"context\": {\"date\": \"%s\", \"host\": \"%s\", "
+          "\"cpu\": \"%s\", \"cpus\": %u, \"int8_isa\": \"%s\", "
+          "\"build\": \"%s\"},\n  \"benchmarks\": [\n",
+          date, host, cpu.c_str(), std::thread::hardware_concurrency(),
+          Int8IsaName(BestInt8Isa()), build);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    fprintf(file,
+            "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": "
+            "%.3f, \"min_ns_per_op\": %.3f, \"max_ns_per_op\": %.3f, "
+            "\"items_per_second\": %.3f, \"bytes_per_second\": %.3f, "
+            "\"bytes_kind\": \"%s\"}%s\n",
+            result.name.c_str(), static_cast<long long>(result.iterations),
+            result.ns_per_op, result.min_ns_per_op, result.max_ns_per_op,
+            result.items_per_second, result.bytes_per_second,
+            result.bytes_kind.c_str(), i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+// Reads a JSON document a value at a time. Callers walk the structure they
+// expect and skip everything else with SkipValue(), so --compare does not
+// depend on how the file is laid out or on fields it does not use.
+class JsonReader {
+ public:
+  explicit JsonReader(const std::string& text) : text_(text) {}
+
+  // True once only whitespace is left.
+  bool AtEnd() {
+    SkipSpace();
+    return position_ == text_.size();
+  }
+
+  bool ReadString(std::string* value) {
+    if (!Consume('"')) {
+      return false;
+    }
+    value->clear();
+    while (position_ < text_.size()) {
+      const char c = text_[position_++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        value->push_back(c);
+        continue;
+      }
+      if (position_ == text_.size()) {
+        return false;
+      }
+      const char escape = text_[position_++];
+      switch (escape) {
+        case 'b':
+          value->push_back('\b');
+          break;
+        case 'f':
+          value->push_back('\f');
+          break;
+        case 'n':
+          value->push_back('\n');
+          break;
+        case 'r':
+          value->push_back('\r');
+          break;
+        case 't':
+          value->push_back('\t');
+          break;
+        case 'u':
+          if (!ReadCodeUnit(value)) {
+            return false;
+          }
+          break;
+        default:
+          value->push_back(escape);
+      }
+    }
+    return false;
+  }
+
+  bool ReadNumber(double* value) {
+    SkipSpace();
+    const char* start = text_.c_str() + position_;
+    if (*start != '-' && (*start < '0' || *start > '9')) {
+      return false;
+    }
+    char* end = nullptr;
+    *value = strtod(start, &end);
+    position_ += end - start;
+    return end != start;
+  }
+
+  // Reads an object, calling |member| with each key; |member| must read or
+  // skip the value and return false on error.
+  template <typename Member>
+  bool ReadObject(Member member) {
+    if (!Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+    std::string key;
+    do {
+      if (!ReadString(&key) || !Consume(':') || !member(key)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  // Reads an array, calling |element| for each value as ReadObject does.
+  template <typename Element>
+  bool ReadArray(Element element) {
+    if (!Consume('[')) {
+      return false;
+    }
+    if (Consume(']')) {
+      return true;
+    }
+    do {
+      if (!element()) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  bool SkipValue() {
+    SkipSpace();
+    if (position_ == text_.size()) {
+      return false;
+    }
+    switch (text_[position_]) {
+      case '{':
+        return ReadObject([this](const std::string&) { return SkipValue(); });
+      case '[':
+        return ReadArray([this] { return SkipValue(); });
+      case '"': {
+        std::string ignored;
+        return ReadString(&ignored);
+      }
+      case 't':
+        return ConsumeWord("true");
+      case 'f':
+        return ConsumeWord("false");
+      case 'n':
+        return ConsumeWord("null");
+      default: {
+        double ignored;
+        return ReadNumber(&ignored);
+      }
+    }
+  }
+
+ private:
+  void SkipSpace() {
+    while (position_ < text_.size() &&
+           (text_[position_] == ' ' || text_[position_] == '\t' ||
+            text_[position_] == '\n' || text_[position_] == '\r')) {
+      ++position_;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipSpace();
+    if (position_ < text_.size() && text_[position_] == c) {
+      ++position_;
+      return true;
+    }
+    return false;
+  }
+
+  bool ConsumeWord(const char* word) {
+    const size_t length = strlen(word);
+    if (text_.compare(position_, length, word) != 0) {
+      return false;
+    }
+    position_ += length;
+    return true;
+  }
+
+  // Appends the \uXXXX escape after the "\u" as UTF-8. Surrogate pairs are
+  // kept as two three-byte sequences, which is enough to match names.
+  bool ReadCodeUnit(std::string* value) {
+    if (position_ + 4 > text_.size()) {
+      return false;
+    }
+    unsigned code = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = text_[position_++];
+      code <<= 4;
+      if (c >= '0' && c <= '9') {
+        code |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        code |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        code |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    if (code < 0x80) {
+      value->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      value->push_back(static_cast<char>(0xc0 | (code >> 6)));
+      value->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      value->push_back(static_cast<char>(0xe0 | (code >> 12)));
+      value->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      value->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+    return true;
+  }
+
+  const std::string& text_;
+  size_t position_ = 0;
+};
+
+// Reads the benchmark times and CPU model from a result file: an object with
+// "context": {"cpu": ...} and "benchmarks": [{"name": ..., "ns_per_op": ...}],
+// as WriteJson writes it. Returns false if the file is not valid JSON or has
+// no benchmarks.
+bool ReadJson(const std::string& path, std::map<std::string, double>* times,
+              std::vector<std::string>* order, std::string* cpu) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string text = contents.str();
+  JsonReader reader(text);
+
+  const auto read_benchmark = [&] {
+    std::string name;
+    double ns_per_op = -1;
+    const bool read = reader.ReadObject([&](const std::string& key) {
+      if (key == "name") {
+        return reader.ReadString(&name);
+      }
+      if (key == "ns_per_op") {
+        return reader.ReadNumber(&ns_per_op);
+      }
+      return reader.SkipValue();
+    });
+    if (read && !name.empty() && ns_per_op >= 0) {
+      if (times->count(name) == 0) {
+        order->push_back(name);
+      }
+      (*times)[name] = ns_per_op;
+    }
+    return read;
+  };
+  const bool read = reader.ReadObject([&](const std::string& key) {
+    if (key == "context") {
+      return reader.ReadObject([&](const std::string& context_key) {
+        return context_key == "cpu" ? reader.ReadString(cpu)
+                                    : reader.SkipValue();
+      });
+    }
+    if (key == "benchmarks") {
+      return reader.ReadArray(read_benchmark);
+    }
+    return reader.SkipValue();
+  });
+  return read && reader.AtEnd() && !times->empty();
+}
+
+int Compare(const Options& options) {
+  std::map<std::string, double> baseline;
+  std::map<std::string, double> current;
+  std::vector<std::string> baseline_order;
+  std::vector<std::string> current_order;
+  std::string baseline_cpu;
+  std::string current_cpu;
+  if (!ReadJson(options.baseline_path, &baseline, &baseline_order,
+                &baseline_cpu)) {
+    fprintf(stderr, "error: no results could be read from %s\n",
+            options.baseline_path.c_str());
+    return 2;
+  }
+  if (!ReadJson(options.current_path, &current, &current_order,
+                &current_cpu)) {
+    fprintf(stderr, "error: no results could be read from %s\n",
+            options.current_path.c_str());
+    return 2;
+  }
+  if (baseline_cpu != current_cpu) {
+    printf("warning: results are from different CPUs:\n  %s\n  %s\n\n",
+           baseline_cpu.c_str(), current_cpu.c_str());
+  }
+
+  printf("%-44s %12s %12s %8s\n", "benchmark", "baseline", "current",
+         "change");
+  int regressions = 0;
+  for (const std::string& name : baseline_order) {
+    const auto found = current.find(name);
+    if (found == current.end()) {
+      printf("%-44s %12s %12s\n", name.c_str(),
+             FormatDuration(baseline[name]).c_str(), "missing");
+      continue;
+    }
+    const double change = (found->second / baseline[name] - 1) * 100;
+    const bool regressed = change > options.threshold_percent;
+    const bool improved = change < -options.threshold_percent;
+    regressions += regressed ? 1 : 0;
+    printf("%-44s %12s %12s %+7.1f%%%s\n", name.c_str(),
+           FormatDuration(baseline[name]).c_str(),
+           FormatDuration(found->second).c_str(), change,
+           regressed ? "  REGRESSION" : improved ? "  improved" : "");
+  }
+  for (const std::string& name : current_order) {
+    if (baseline.count(name) == 0) {
+      printf("%-44s %12s %12s\n", name.c_str(), "new",
+             FormatDuration(current[name]).c_str());
+    }
+  }
+  if (regressions > 0) {
+    printf("\n%d benchmark%s slower by more than %g%%\n", regressions,
+           regressions == 1 ? "" : "s", options.threshold_percent);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+  if (!options.baseline_path.empty()) {
+    return Compare(options);
+  }
+
+  BenchCorpus corpus;
+  std::string error;
+  if (!LoadBenchCorpus(options.corpus_dir, &corpus, &error)) {
+    fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+  std::vector<Benchmark> benchmarks;
+  AddImageBenchmarks(corpus, &benchmarks);
+  AddDetectionBenchmarks(corpus, &benchmarks);
+  AddGeoBenchmarks(corpus, &benchmarks);
+  AddAllocatorBenchmarks(corpus, &benchmarks);
+
+  std::vector<Result> results;
+  bool failed = false;
+  for (const Benchmark& benchmark : benchmarks) {
+    if (benchmark.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    if (options.list) {
+      printf("%s\n", benchmark.name.c_str());
+      continue;
+    }
+    Result result;
+    if (!Measure(benchmark, corpus, options, &result)) {
+      fprintf(stderr, "error: %s failed\n", benchmark.name.c_str());
+      failed = true;
+      continue;
+    }
+    PrintResult(result);
+    results.push_back(result);
+  }
+  if (!options.json_path.empty() && !WriteJson(options.json_path, results)) {
+    fprintf(stderr, "error: cannot write %s\n", options.json_path.c_str());
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
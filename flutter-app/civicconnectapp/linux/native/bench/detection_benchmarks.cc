@@ -0,0 +1,304 @@
+// YOLO output parsing and NMS, box overlap, tracking, frame gating, INT8
+// convolution and the detection pipeline around a model.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "native/bench/bench.h"
+#include "native/detection_pipeline.h"
+#include "native/frame_gate.h"
+#include "native/int8_kernels.h"
+#include "native/jpeg_codec.h"
+#include "native/object_tracker.h"
+#include "native/tensor_arena.h"
+#include "native/yolo_postprocess.h"
+
+namespace {
+
+constexpr int kInputSize = 640;
+constexpr int kAnchors = 8400;
+// Anchors each corpus object fires.
+constexpr int kAnchorsPerObject = 24;
+constexpr int kSequenceFrames = 300;
+
+const char* const kGarbageClasses[] = {"garbage", "trash", "waste", "debris",
+                                       "litter"};
+const char* const kPotholeClasses[] = {"pothole", "crack", "damage", "hole"};
+constexpr int kGarbageClassCount = 5;
+constexpr int kPotholeClassCount = 4;
+
+int ClassCount(bool pothole) {
+  return pothole ? kPotholeClassCount : kGarbageClassCount;
+}
+
+// Builds the output tensor of the garbage or pothole model from the corpus
+// objects: sub-threshold noise on every anchor, and a cluster of jittered,
+// overlapping candidates around each object.
+std::vector<float> BuildYoloOutput(const BenchCorpus& corpus, bool pothole) {
+  const int classes = ClassCount(pothole);
+  std::vector<float> output(static_cast<size_t>(4 + classes) * kAnchors);
+  BenchRandom random(pothole ? 2 : 1);
+  for (int anchor = 0; anchor < kAnchors; ++anchor) {
+    output[0 * kAnchors + anchor] = random.Uniform() * kInputSize;
+    output[1 * kAnchors + anchor] = random.Uniform() * kInputSize;
+    output[2 * kAnchors + anchor] = 8 + random.Uniform() * 120;
+    output[3 * kAnchors + anchor] = 8 + random.Uniform() * 120;
+    for (int c = 0; c < classes; ++c) {
+      output[(4 + c) * kAnchors + anchor] = random.Uniform() * 0.05f;
+    }
+  }
+  int anchor = 0;
+  for (const BenchCorpus::YoloObject& object : corpus.yolo_objects) {
+    if (object.pothole != pothole) {
+      continue;
+    }
+    for (int i = 0; i < kAnchorsPerObject; ++i) {
+      // Spread clusters over the anchor grid as the detection heads do.
+      anchor = (anchor + 337) % kAnchors;
+      const float jitter = 0.1f * (random.Uniform() - 0.5f);
+      output[0 * kAnchors + anchor] = object.cx + jitter * object.width;
+      output[1 * kAnchors + anchor] = object.cy - jitter * object.height;
+      output[2 * kAnchors + anchor] = object.width * (1 + jitter);
+      output[3 * kAnchors + anchor] = object.height * (1 - jitter);
+      output[(4 + object.class_id % classes) * kAnchors + anchor] =
+          object.score * (i == 0 ? 1.0f : 0.5f + 0.5f * random.Uniform());
+    }
+  }
+  return output;
+}
+
+// Returns the detections of each frame of the dashcam sequence for one
+// model.
+std::vector<std::vector<Detection>> BuildSequence(const BenchCorpus& corpus,
+                                                  bool pothole) {
+  const char* const* names = pothole ? kPotholeClasses : kGarbageClasses;
+  std::vector<std::vector<Detection>> frames(kSequenceFrames);
+  BenchRandom random(pothole ? 4 : 3);
+  for (size_t o = 0; o < corpus.track_objects.size(); ++o) {
+    const BenchCorpus::TrackObject& object = corpus.track_objects[o];
+    if (object.pothole != pothole) {
+      continue;
+    }
+    for (int frame = object.first_frame;
+         frame <= std::min(object.last_frame, kSequenceFrames - 1); ++frame) {
+      const float t = static_cast<float>(frame - object.first_frame);
+      // The detector misses an object now and then.
+      if (random.Next() % 15 == 0) {
+        continue;
+      }
+      const float scale = std::pow(1 + object.growth, t);
+      const float cx = (object.box.x1 + object.box.x2) / 2 + object.dx * t +
+                       3 * (random.Uniform() - 0.5f);
+      const float cy = (object.box.y1 + object.box.y2) / 2 + object.dy * t +
+                       3 * (random.Uniform() - 0.5f);
+      const float half_w = object.box.width() * scale / 2;
+      const float half_h = object.box.height() * scale / 2;
+      // Scores dip under motion blur.
+      const float score = (frame + static_cast<int>(o)) % 9 == 0
+                              ? 0.3f
+                              : 0.6f + 0.3f * random.Uniform();
+      const int class_id = object.class_id % ClassCount(pothole);
+      frames[frame].push_back(Detection{
+          class_id, names[class_id], score,
+          BoundingBox{cx - half_w, cy - half_h, cx + half_w, cy + half_h}});
+    }
+  }
+  return frames;
+}
+
+bool BenchParse(const BenchCorpus& corpus, bool pothole, BenchState* state) {
+  const int classes = ClassCount(pothole);
+  const std::vector<float> tensor = BuildYoloOutput(corpus, pothole);
+  const YoloOutput output{tensor.data(), 4 + classes, kAnchors, classes};
+  YoloParseOptions options;
+  options.class_names = pothole ? kPotholeClasses : kGarbageClasses;
+  options.class_name_count = classes;
+  TensorArena arena;
+  std::vector<Detection> detections;
+  state->set_bytes_per_iteration(tensor.size() * sizeof(float), "tensor");
+  while (state->Loop()) {
+    ParseYoloDetections(output, options, &arena, &detections);
+    arena.Reset();
+  }
+  return !detections.empty();
+}
+
+// IoU of every pair of candidate boxes, the inner loop of NMS and tracking.
+bool BenchBoxIou(const BenchCorpus& corpus, BenchState* state) {
+  std::vector<BoundingBox> boxes;
+  for (const std::vector<Detection>& frame : BuildSequence(corpus, true)) {
+    for (const Detection& detection : frame) {
+      boxes.push_back(detection.box);
+    }
+  }
+  boxes.resize(std::min<size_t>(boxes.size(), 512));
+  state->set_items_per_iteration(static_cast<int64_t>(boxes.size()) *
+                                 boxes.size());
+  while (state->Loop()) {
+    float total = 0;
+    for (const BoundingBox& a : boxes) {
+      for (const BoundingBox& b : boxes) {
+        total += BoxIou(a, b);
+      }
+    }
+    KeepAlive(total);
+  }
+  return !boxes.empty();
+}
+
+// Both trackers over the whole dashcam sequence, the detector running on
+// every frame.
+bool BenchTracker(const BenchCorpus& corpus, BenchState* state) {
+  const std::vector<std::vector<Detection>> sequences[] = {
+      BuildSequence(corpus, false), BuildSequence(corpus, true)};
+  std::vector<ConsolidatedDetection> finished;
+  std::vector<int> improved;
+  state->set_items_per_iteration(kSequenceFrames);
+  while (state->Loop()) {
+    for (const std::vector<std::vector<Detection>>& frames : sequences) {
+      ObjectTracker tracker{TrackerOptions()};
+      finished.clear();
+      for (int frame = 0; frame < kSequenceFrames; ++frame) {
+        tracker.Predict(frame, &finished);
+        improved.clear();
+        tracker.Update(frames[frame], &improved);
+      }
+      tracker.Flush(&finished);
+    }
+  }
+  return !finished.empty();
+}
+
+// Frame gating over a panning crop of the dashcam frame's 1/8-scale luma, as
+// the dashcam pipeline does for every frame.
+bool BenchFrameGate(const BenchCorpus& corpus, BenchState* state) {
+  std::vector<uint8_t> luma;
+  int width;
+  int height;
+  const BenchCorpus::Jpeg& jpeg = corpus.jpegs.front();
+  if (!DecodeJpegLuma(jpeg.data.data(), jpeg.data.size(), 8, &luma, &width,
+                      &height)) {
+    return false;
+  }
+  const int crop_width = width * 7 / 8;
+  const int crop_height = height * 7 / 8;
+  FrameGate gate{FrameGateOptions()};
+  state->set_items_per_iteration(kSequenceFrames);
+  while (state->Loop()) {
+    gate.Reset();
+    for (int frame = 0; frame < kSequenceFrames; ++frame) {
+      const int x = frame % (width - crop_width);
+      const int y = (frame / 3) % (height - crop_height);
+      KeepAlive(gate.Classify(luma.data() + y * width + x, crop_width,
+                              crop_height, static_cast<size_t>(width)));
+    }
+  }
+  return true;
+}
+
+// A 3x3 convolution the size of an early YOLOv8n layer.
+bool BenchInt8Conv(BenchState* state) {
+  ConvShape shape;
+  shape.in_channels = 32;
+  shape.in_height = 80;
+  shape.in_width = 80;
+  shape.out_channels = 64;
+  shape.kernel = 3;
+  shape.stride = 1;
+  shape.padding = 1;
+  BenchRandom random(5);
+  std::vector<float> weights(static_cast<size_t>(shape.out_channels) *
+                             shape.depth());
+  for (float& weight : weights) {
+    weight = random.Uniform() - 0.5f;
+  }
+  std::vector<float> input(static_cast<size_t>(shape.in_channels) *
+                           shape.in_height * shape.in_width);
+  for (float& value : input) {
+    value = random.Uniform();
+  }
+  std::vector<float> output(static_cast<size_t>(shape.out_channels) *
+                            shape.out_height() * shape.out_width());
+  Int8Conv2d conv(shape, weights.data(), nullptr);
+  const ActivationQuantization quantization =
+      ActivationQuantizationForRange(0.0f, 1.0f);
+  const Int8Isa isa = BestInt8Isa();
+  state->set_items_per_iteration(static_cast<int64_t>(output.size()) *
+                                 shape.depth());
+  while (state->Loop()) {
+    conv.Run(input.data(), quantization, output.data(), isa);
+    KeepAlive(output[0]);
+  }
+  return true;
+}
+
+// Serves a fixed output tensor, so the pipeline is measured without the
+// inference runtime.
+class CorpusModel : public DetectionModel {
+ public:
+  CorpusModel(const BenchCorpus& corpus, bool pothole)
+      : output_(BuildYoloOutput(corpus, pothole)),
+        channels_(4 + ClassCount(pothole)) {}
+
+  int output_channels() const override { return channels_; }
+  int output_anchors() const override { return kAnchors; }
+
+  bool Run(const float* input, int input_size, float* output) override {
+    memcpy(output, output_.data(), output_.size() * sizeof(float));
+    return true;
+  }
+
+ private:
+  const std::vector<float> output_;
+  const int channels_;
+};
+
+// Decode, preprocess and parse around the two models.
+bool BenchPipeline(const BenchCorpus& corpus, size_t jpeg_index,
+                   BenchState* state) {
+  const BenchCorpus::Jpeg& jpeg = corpus.jpegs[jpeg_index];
+  CorpusModel garbage_model(corpus, false);
+  CorpusModel pothole_model(corpus, true);
+  DetectionPipeline pipeline(DetectionConfig(), &garbage_model,
+                             &pothole_model);
+  DetectionResult result;
+  state->set_bytes_per_iteration(jpeg.data.size(), "jpeg");
+  bool ok = true;
+  while (state->Loop()) {
+    ok &= pipeline.DetectJpeg(jpeg.data.data(), jpeg.data.size(), &result);
+  }
+  return ok;
+}
+
+}  // namespace
+
+void AddDetectionBenchmarks(const BenchCorpus& corpus,
+                            std::vector<Benchmark>* benchmarks) {
+  benchmarks->push_back(
+      {"yolo/parse_nms/garbage", [](const BenchCorpus& corpus,
+                                    BenchState* state) {
+         return BenchParse(corpus, false, state);
+       }});
+  benchmarks->push_back(
+      {"yolo/parse_nms/pothole", [](const BenchCorpus& corpus,
+                                    BenchState* state) {
+         return BenchParse(corpus, true, state);
+       }});
+  benchmarks->push_back({"yolo/box_iou_pairs", BenchBoxIou});
+  benchmarks->push_back({"tracker/dashcam_sequence", BenchTracker});
+  benchmarks->push_back({"frame_gate/classify_sequence", BenchFrameGate});
+  benchmarks->push_back(
+      {"int8/conv3x3_32x64_80x80",
+       [](const BenchCorpus&, BenchState* state) {
+         return BenchInt8Conv(state);
+       }});
+  for (size_t i = 0; i < corpus.jpegs.size(); ++i) {
+    benchmarks->push_back(
+        {"pipeline/detect_jpeg/" + corpus.jpegs[i].name,
+         [i](const BenchCorpus& corpus, BenchState* state) {
+           return BenchPipeline(corpus, i, state);
+         }});
+  }
+}
@@ -0,0 +1,64 @@
+// Distances from a user to every complaint, as GET /complaints/nearby
+// computes them before filtering by radius.
+
+#include <algorithm>
+#include <vector>
+
+#include "native/bench/bench.h"
+#include "native/geo_distance.h"
+
+namespace {
+
+// Complaints spread over a city about 40 km across, around Bengaluru.
+constexpr double kCenterLatitude = 12.9716;
+constexpr double kCenterLongitude = 77.5946;
+constexpr double kSpreadDegrees = 0.36;
+constexpr size_t kComplaints = 10000;
+// The endpoint's default radius and result limit.
+constexpr double kRadiusMeters = 1000;
+constexpr size_t kNearbyLimit = 20;
+
+// Distances to |kComplaints| complaints, then the nearest within the radius
+// as the endpoint selects them.
+bool BenchNearby(BenchState* state) {
+  BenchRandom random(5);
+  std::vector<double> latitudes(kComplaints);
+  std::vector<double> longitudes(kComplaints);
+  for (size_t i = 0; i < kComplaints; ++i) {
+    latitudes[i] = kCenterLatitude + (random.Uniform() - 0.5) * kSpreadDegrees;
+    longitudes[i] =
+        kCenterLongitude + (random.Uniform() - 0.5) * kSpreadDegrees;
+  }
+  std::vector<double> meters(kComplaints);
+  std::vector<size_t> nearby;
+  nearby.reserve(kComplaints);
+  state->set_items_per_iteration(kComplaints);
+  while (state->Loop()) {
+    HaversineDistances(kCenterLatitude, kCenterLongitude, latitudes.data(),
+                       longitudes.data(), kComplaints, meters.data());
+    nearby.clear();
+    for (size_t i = 0; i < kComplaints; ++i) {
+      if (meters[i] <= kRadiusMeters) {
+        nearby.push_back(i);
+      }
+    }
+    const size_t kept = std::min(nearby.size(), kNearbyLimit);
+    std::partial_sort(
+        nearby.begin(), nearby.begin() + kept, nearby.end(),
+        [&meters](size_t a, size_t b) { return meters[a] < meters[b]; });
+    nearby.resize(kept);
+    KeepAlive(nearby);
+  }
+  return !nearby.empty();
+}
+
+}  // namespace
+
+void AddGeoBenchmarks(const BenchCorpus& corpus,
+                      std::vector<Benchmark>* benchmarks) {
+  benchmarks->push_back(
+      {"geo/nearby_haversine_10k",
+       [](const BenchCorpus&, BenchState* state) {
+         return BenchNearby(state);
+       }});
+}
@@ -0,0 +1,139 @@
+// Image decode, preprocessing, annotation and encode.
+
+#include <vector>
+
+#include "native/annotation_renderer.h"
+#include "native/bench/bench.h"
+#include "native/image_preprocess.h"
+#include "native/jpeg_codec.h"
+
+namespace {
+
+// Decoded pixels of a corpus JPEG.
+class DecodedImage {
+ public:
+  bool Decode(const BenchCorpus::Jpeg& jpeg) {
+    pixels_.resize(static_cast<size_t>(jpeg.width) * jpeg.height * 4);
+    image_ = RgbaImage{pixels_.data(), jpeg.width, jpeg.height,
+                       static_cast<size_t>(jpeg.width) * 4};
+    return DecodeJpeg(jpeg.data.data(), jpeg.data.size(), image_);
+  }
+
+  const RgbaImage& image() const { return image_; }
+
+ private:
+  std::vector<uint8_t> pixels_;
+  RgbaImage image_;
+};
+
+bool BenchDecode(const BenchCorpus::Jpeg& jpeg, BenchState* state) {
+  DecodedImage decoded;
+  if (!decoded.Decode(jpeg)) {
+    return false;
+  }
+  state->set_bytes_per_iteration(jpeg.data.size(), "jpeg");
+  bool ok = true;
+  while (state->Loop()) {
+    int width;
+    int height;
+    ok &= ReadJpegSize(jpeg.data.data(), jpeg.data.size(), &width, &height) &&
+          DecodeJpeg(jpeg.data.data(), jpeg.data.size(), decoded.image());
+  }
+  return ok;
+}
+
+// The frame gate's decode: luma only, at 1/8 scale.
+bool BenchDecodeLuma(const BenchCorpus::Jpeg& jpeg, BenchState* state) {
+  std::vector<uint8_t> luma;
+  state->set_bytes_per_iteration(jpeg.data.size(), "jpeg");
+  bool ok = true;
+  while (state->Loop()) {
+    int width;
+    int height;
+    ok &= DecodeJpegLuma(jpeg.data.data(), jpeg.data.size(), 8, &luma, &width,
+                         &height);
+  }
+  return ok;
+}
+
+bool BenchEncode(const BenchCorpus::Jpeg& jpeg, BenchState* state) {
+  DecodedImage decoded;
+  if (!decoded.Decode(jpeg)) {
+    return false;
+  }
+  std::vector<uint8_t> out;
+  state->set_bytes_per_iteration(
+      decoded.image().stride * decoded.image().height, "rgba");
+  bool ok = true;
+  while (state->Loop()) {
+    ok &= EncodeJpeg(decoded.image(), 80, &out);
+  }
+  return ok;
+}
+
+// Resize, normalize and transpose into the 640x640 model input.
+bool BenchPreprocess(const BenchCorpus::Jpeg& jpeg, BenchState* state) {
+  DecodedImage decoded;
+  if (!decoded.Decode(jpeg)) {
+    return false;
+  }
+  constexpr int kInputSize = 640;
+  std::vector<float> tensor(3 * kInputSize * kInputSize);
+  while (state->Loop()) {
+    ResizeToChwTensor(decoded.image(), kInputSize, kInputSize, tensor.data());
+    KeepAlive(tensor[0]);
+  }
+  return true;
+}
+
+// Annotates with a typical set of detections and encodes the result, as for
+// every image the app shows with detections.
+bool BenchAnnotate(const BenchCorpus::Jpeg& jpeg, BenchState* state) {
+  DecodedImage decoded;
+  if (!decoded.Decode(jpeg)) {
+    return false;
+  }
+  const float w = static_cast<float>(jpeg.width);
+  const float h = static_cast<float>(jpeg.height);
+  const std::vector<Detection> garbage = {
+      {0, "garbage", 0.91f, {0.05f * w, 0.70f * h, 0.20f * w, 0.86f * h}},
+      {2, "waste", 0.64f, {0.80f * w, 0.66f * h, 0.95f * w, 0.80f * h}},
+  };
+  const std::vector<Detection> potholes = {
+      {0, "pothole", 0.88f, {0.53f * w, 0.72f * h, 0.67f * w, 0.81f * h}},
+      {0, "pothole", 0.73f, {0.69f * w, 0.91f * h, 0.77f * w, 0.95f * h}},
+      {1, "crack", 0.47f, {0.30f * w, 0.60f * h, 0.45f * w, 0.63f * h}},
+  };
+  std::vector<uint8_t> out;
+  bool ok = true;
+  while (state->Loop()) {
+    ok &= RenderAnnotatedJpeg(decoded.image(), garbage, potholes, 80, &out);
+  }
+  return ok;
+}
+
+}  // namespace
+
+void AddImageBenchmarks(const BenchCorpus& corpus,
+                        std::vector<Benchmark>* benchmarks) {
+  const struct {
+    const char* prefix;
+    bool (*run)(const BenchCorpus::Jpeg& jpeg, BenchState* state);
+  } kCases[] = {
+      {"jpeg/decode/", BenchDecode},
+      {"jpeg/decode_luma_1_8/", BenchDecodeLuma},
+      {"jpeg/encode_q80/", BenchEncode},
+      {"preprocess/resize_chw_640/", BenchPreprocess},
+      {"annotate/render_jpeg/", BenchAnnotate},
+  };
+  for (const auto& benchmark_case : kCases) {
+    for (size_t i = 0; i < corpus.jpegs.size(); ++i) {
+      const auto run = benchmark_case.run;
+      benchmarks->push_back(
+          {benchmark_case.prefix + corpus.jpegs[i].name,
+           [run, i](const BenchCorpus& corpus, BenchState* state) {
+             return run(corpus.jpegs[i], state);
+           }});
+    }
+  }
+}
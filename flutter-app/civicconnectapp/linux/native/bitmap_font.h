@@ -0,0 +1,22 @@
+#ifndef NATIVE_BITMAP_FONT_H_
+#define NATIVE_BITMAP_FONT_H_
+
+#include <cstdint>
+
+// A fixed 5x8 bitmap font covering printable ASCII, used for detection labels
+// so the annotation path needs no font rendering library.
+constexpr int kGlyphWidth = 5;
+constexpr int kGlyphHeight = 8;
+// Horizontal distance between the origins of two consecutive glyphs.
+constexpr int kGlyphAdvance = kGlyphWidth + 1;
+// Height of a capital letter; rows below this are only used by descenders.
+constexpr int kGlyphCapHeight = 7;
+
+// Returns the |kGlyphWidth| column bitmaps for |c|, least significant bit at
+// the top. Characters outside printable ASCII map to '?'.
+const uint8_t* GlyphColumns(char c);
+
+// Returns the width in pixels of |text| rendered at |scale|.
+int MeasureText(const char* text, int scale);
+
+#endif  // NATIVE_BITMAP_FONT_H_
@@ -0,0 +1,143 @@
+#include "native/buffer_pool.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other)
+    : pool_(other.pool_),
+      data_(other.data_),
+      size_(other.size_),
+      size_class_(other.size_class_) {
+  other.pool_ = nullptr;
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+  if (this != &other) {
+    Reset();
+    pool_ = other.pool_;
+    data_ = other.data_;
+    size_ = other.size_;
+    size_class_ = other.size_class_;
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+PooledBuffer::~PooledBuffer() {
+  Reset();
+}
+
+void PooledBuffer::Reset() {
+  if (pool_ != nullptr) {
+    pool_->Release(data_, size_class_);
+  }
+  pool_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+constexpr size_t BufferPool::kMinBufferSize;
+constexpr size_t BufferPool::kLargeBufferSize;
+
+BufferPool::~BufferPool() {
+  Trim();
+}
+
+PooledBuffer BufferPool::Acquire(size_t size) {
+  int size_class = 0;
+  while (ClassSize(size_class) < size) {
+    if (++size_class == kSizeClasses) {
+      throw std::bad_alloc();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  void* data = free_lists_[size_class];
+  if (data != nullptr) {
+    free_lists_[size_class] = free_lists_[size_class]->next;
+    ++stats_.reuses;
+  } else {
+    data = AllocateFromSystem(size_class);
+  }
+  stats_.bytes_in_use += ClassSize(size_class);
+  stats_.high_water_bytes =
+      std::max(stats_.high_water_bytes, stats_.bytes_in_use);
+  return PooledBuffer(this, data, size, size_class);
+}
+
+void BufferPool::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int size_class = 0; size_class < kSizeClasses; ++size_class) {
+    while (free_lists_[size_class] != nullptr) {
+      FreeBuffer* buffer = free_lists_[size_class];
+      free_lists_[size_class] = buffer->next;
+      FreeToSystem(buffer, size_class);
+    }
+  }
+}
+
+BufferPoolStats BufferPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BufferPool::Release(void* data, int size_class) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FreeBuffer* buffer = static_cast<FreeBuffer*>(data);
+  buffer->next = free_lists_[size_class];
+  free_lists_[size_class] = buffer;
+  stats_.bytes_in_use -= ClassSize(size_class);
+}
+
+size_t BufferPool::ClassSize(int size_class) {
+  return kMinBufferSize << size_class;
+}
+
+void* BufferPool::AllocateFromSystem(int size_class) {
+  const size_t size = ClassSize(size_class);
+  void* data = nullptr;
+  if (size >= kLargeBufferSize) {
+#ifdef MAP_HUGETLB
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+      ++stats_.huge_page_allocations;
+    }
+#else
+    data = MAP_FAILED;
+#endif
+    if (data == MAP_FAILED) {
+      // No reserved huge pages; fall back to transparent huge pages.
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (data == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(data, size, MADV_HUGEPAGE);
+#endif
+    }
+  } else if (posix_memalign(&data, kTensorAlignment, size) != 0) {
+    throw std::bad_alloc();
+  }
+  stats_.bytes_reserved += size;
+  ++stats_.system_allocations;
+  return data;
+}
+
+void BufferPool::FreeToSystem(void* data, int size_class) {
+  const size_t size = ClassSize(size_class);
+  if (size >= kLargeBufferSize) {
+    munmap(data, size);
+  } else {
+    free(data);
+  }
+  stats_.bytes_reserved -= size;
+}
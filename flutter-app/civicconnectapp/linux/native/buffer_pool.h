@@ -0,0 +1,115 @@
+#ifndef NATIVE_BUFFER_POOL_H_
+#define NATIVE_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "native/tensor_arena.h"
+
+class BufferPool;
+
+// A buffer on loan from a BufferPool, returned to it on destruction.
+class PooledBuffer {
+ public:
+  PooledBuffer() = default;
+  PooledBuffer(PooledBuffer&& other);
+  PooledBuffer& operator=(PooledBuffer&& other);
+  ~PooledBuffer();
+
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+  void* data() const { return data_; }
+  // The size that was requested; the underlying buffer may be larger.
+  size_t size() const { return size_; }
+
+  template <typename T>
+  T* as() const {
+    return static_cast<T*>(data_);
+  }
+
+  // Returns the buffer to its pool early.
+  void Reset();
+
+ private:
+  friend class BufferPool;
+
+  PooledBuffer(BufferPool* pool, void* data, size_t size, int size_class)
+      : pool_(pool), data_(data), size_(size), size_class_(size_class) {}
+
+  BufferPool* pool_ = nullptr;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+  int size_class_ = 0;
+};
+
+struct BufferPoolStats {
+  // Bytes currently on loan, counted by size class.
+  size_t bytes_in_use = 0;
+  // Most bytes ever on loan at once.
+  size_t high_water_bytes = 0;
+  // Bytes owned by the pool, on loan or cached.
+  size_t bytes_reserved = 0;
+  // Buffers obtained from the system rather than the free lists.
+  uint64_t system_allocations = 0;
+  // Buffers served from the free lists.
+  uint64_t reuses = 0;
+  // Large buffers that were backed by explicit huge pages.
+  uint64_t huge_page_allocations = 0;
+};
+
+// Size-classed pools of kTensorAlignment-aligned buffers, reused across
+// requests for the large per-image tensors of the detection path.
+//
+// Sizes are rounded up to a power of two. Released buffers are kept on a
+// per-class free list instead of being returned to the system, so a steady
+// workload is served entirely from the free lists. Classes of
+// kLargeBufferSize and up are mapped directly, from explicit huge pages if the
+// system has any reserved and otherwise with transparent huge pages
+// requested. Thread-safe.
+class BufferPool {
+ public:
+  // The smallest size class.
+  static constexpr size_t kMinBufferSize = 4096;
+  // Size classes from here up are mmap()ed and huge-page backed.
+  static constexpr size_t kLargeBufferSize = 2 * 1024 * 1024;
+
+  BufferPool() = default;
+  ~BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Returns a buffer of at least |size| bytes. The contents are unspecified.
+  PooledBuffer Acquire(size_t size);
+
+  // Returns all cached buffers to the system. Buffers on loan are unaffected.
+  void Trim();
+
+  BufferPoolStats stats() const;
+
+ private:
+  friend class PooledBuffer;
+
+  // Size classes 2^12 .. 2^(12 + kSizeClasses - 1).
+  static constexpr int kSizeClasses = 20;
+
+  // Free buffers form an intrusive singly linked list through their first
+  // bytes, so caching never allocates.
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  void Release(void* data, int size_class);
+
+  static size_t ClassSize(int size_class);
+  void* AllocateFromSystem(int size_class);
+  void FreeToSystem(void* data, int size_class);
+
+  mutable std::mutex mutex_;
+  FreeBuffer* free_lists_[kSizeClasses] = {};
+  BufferPoolStats stats_;
+};
+
+#endif  // NATIVE_BUFFER_POOL_H_
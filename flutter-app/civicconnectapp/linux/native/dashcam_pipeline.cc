@@ -0,0 +1,136 @@
+#include "native/dashcam_pipeline.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "native/jpeg_codec.h"
+#include "native/memory_tag.h"
+
+DetectionConfig DashcamDetectionConfig(const DashcamOptions& options,
+                                       const DetectionConfig& base) {
+  DetectionConfig config = base;
+  config.conf_threshold =
+      std::min(config.conf_threshold, options.tracker.low_threshold);
+  return config;
+}
+
+DashcamPipeline::DashcamPipeline(const DashcamOptions& options,
+                                 DetectionPipeline* detector)
+    : options_(options),
+      detector_(detector),
+      gate_(options.gate),
+      garbage_(options.tracker),
+      pothole_(options.tracker),
+      skipped_counter_(MetricsRegistry::Get()->GetCounter(
+          "dashcam_frames_skipped",
+          "Dashcam frames skipped as near-duplicates of the previous one.")),
+      tracked_counter_(MetricsRegistry::Get()->GetCounter(
+          "dashcam_frames_tracked",
+          "Dashcam frames whose objects were carried forward by tracking.")),
+      detected_counter_(MetricsRegistry::Get()->GetCounter(
+          "dashcam_frames_detected",
+          "Dashcam frames the detection models ran on.")) {}
+
+bool DashcamPipeline::ProcessJpeg(const uint8_t* data, size_t size,
+                                  std::vector<DashcamReport>* reports) {
+  MemoryTagScope tag("dashcam");
+  const int64_t frame = next_frame_++;
+  ++stats_.frames;
+  int width = 0;
+  int height = 0;
+  if (!DecodeJpegLuma(data, size, options_.gate_scale_denom, &luma_, &width,
+                      &height) ||
+      width <= 0 || height <= 0) {
+    return false;
+  }
+
+  const FrameAction action =
+      gate_.Classify(luma_.data(), width, height, static_cast<size_t>(width));
+  if (action == FrameAction::kSkip) {
+    ++stats_.skipped;
+    if (skipped_counter_ != nullptr) {
+      skipped_counter_->Increment();
+    }
+    return true;
+  }
+
+  finished_.clear();
+  garbage_.tracker.Predict(frame, &finished_);
+  Report(&garbage_, false, reports);
+  finished_.clear();
+  pothole_.tracker.Predict(frame, &finished_);
+  Report(&pothole_, true, reports);
+
+  if (action == FrameAction::kTrack) {
+    ++stats_.tracked;
+    if (tracked_counter_ != nullptr) {
+      tracked_counter_->Increment();
+    }
+    return true;
+  }
+
+  ++stats_.detected;
+  if (detected_counter_ != nullptr) {
+    detected_counter_->Increment();
+  }
+  if (!detector_->DetectJpeg(data, size, &result_)) {
+    return false;
+  }
+  garbage_.tracker.Update(result_.garbage_detections, &improved_);
+  KeepBestFrames(&garbage_, data, size);
+  pothole_.tracker.Update(result_.pothole_detections, &improved_);
+  KeepBestFrames(&pothole_, data, size);
+  return true;
+}
+
+void DashcamPipeline::Finish(std::vector<DashcamReport>* reports) {
+  finished_.clear();
+  garbage_.tracker.Flush(&finished_);
+  Report(&garbage_, false, reports);
+  finished_.clear();
+  pothole_.tracker.Flush(&finished_);
+  Report(&pothole_, true, reports);
+  gate_.Reset();
+  next_frame_ = 0;
+}
+
+void DashcamPipeline::GetObjects(std::vector<TrackedObject>* objects) const {
+  std::vector<TrackedObject> potholes;
+  garbage_.tracker.GetObjects(objects);
+  pothole_.tracker.GetObjects(&potholes);
+  objects->insert(objects->end(), potholes.begin(), potholes.end());
+}
+
+void DashcamPipeline::Report(ModelTracks* tracks, bool is_pothole,
+                             std::vector<DashcamReport>* reports) {
+  for (const ConsolidatedDetection& detection : finished_) {
+    DashcamReport report;
+    report.detection = detection;
+    report.is_pothole = is_pothole;
+    auto it = tracks->best_frames.find(detection.track_id);
+    if (it != tracks->best_frames.end()) {
+      report.best_frame_jpeg.swap(it->second);
+      tracks->best_frames.erase(it);
+    }
+    reports->push_back(std::move(report));
+  }
+  // Tracks that ended with too few hits to report still hold a frame.
+  for (auto it = tracks->best_frames.begin();
+       it != tracks->best_frames.end();) {
+    if (tracks->tracker.HasTrack(it->first)) {
+      ++it;
+    } else {
+      it = tracks->best_frames.erase(it);
+    }
+  }
+}
+
+void DashcamPipeline::KeepBestFrames(ModelTracks* tracks, const uint8_t* data,
+                                     size_t size) {
+  if (!options_.keep_best_frames) {
+    return;
+  }
+  for (int track_id : improved_) {
+    tracks->best_frames[track_id].assign(data, data + size);
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef NATIVE_DASHCAM_PIPELINE_H_
+#define NATIVE_DASHCAM_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "native/detection_pipeline.h"
+#include "native/frame_gate.h"
+#include "native/metrics.h"
+#include "native/object_tracker.h"
+
+struct DashcamOptions {
+  FrameGateOptions gate;
+  TrackerOptions tracker;
+  // Scale the gate decodes frames at; see DecodeJpegLuma.
+  int gate_scale_denom = 8;
+  // Whether reports carry a copy of the JPEG their best detection came from.
+  bool keep_best_frames = true;
+};
+
+// The detector configuration for a DashcamPipeline, from |base|. The trackers
+// continue tracks from detections down to tracker.low_threshold, so the
+// detector has to keep candidates that far down instead of dropping them at
+// the still-image threshold. Only detections at or above
+// tracker.new_track_threshold start tracks, so this adds no reports.
+DetectionConfig DashcamDetectionConfig(const DashcamOptions& options,
+                                       const DetectionConfig& base);
+
+// One object seen in a sequence, reported once when its track ends.
+struct DashcamReport {
+  ConsolidatedDetection detection;
+  // Which of the two models found it.
+  bool is_pothole;
+  // The frame |detection.best| was found in, as passed to ProcessJpeg().
+  std::vector<uint8_t> best_frame_jpeg;
+};
+
+struct DashcamStats {
+  uint64_t frames = 0;
+  // Near-duplicate frames that were not processed at all.
+  uint64_t skipped = 0;
+  // Frames whose objects were carried forward by the trackers.
+  uint64_t tracked = 0;
+  // Frames the detector ran on.
+  uint64_t detected = 0;
+};
+
+// Runs detection over continuous dashcam footage and reports each pothole or
+// piece of litter once rather than once per frame.
+//
+// A FrameGate looks at a cheap 1/8 scale luma decode of every frame and only
+// lets keyframes through to the full decode and both models. One
+// ObjectTracker per model carries detections forward across the frames in
+// between and merges repeated detections of an object into a single report
+// holding its best frame. Not thread-safe.
+class DashcamPipeline {
+ public:
+  // |detector| must outlive the pipeline. Unless it was configured with
+  // DashcamDetectionConfig(), low score detections never reach the trackers.
+  DashcamPipeline(const DashcamOptions& options, DetectionPipeline* detector);
+
+  DashcamPipeline(const DashcamPipeline&) = delete;
+  DashcamPipeline& operator=(const DashcamPipeline&) = delete;
+
+  // Feeds the next JPEG frame of the sequence. Objects whose tracks ended are
+  // appended to |reports|. Returns false if the frame could not be decoded or
+  // the detector failed; the sequence can continue with the next frame.
+  bool ProcessJpeg(const uint8_t* data, size_t size,
+                   std::vector<DashcamReport>* reports);
+
+  // Ends the sequence, reporting every object still tracked, and resets the
+  // pipeline for a new one.
+  void Finish(std::vector<DashcamReport>* reports);
+
+  // Objects visible in the latest frame, with garbage before potholes.
+  void GetObjects(std::vector<TrackedObject>* objects) const;
+
+  const DashcamStats& stats() const { return stats_; }
+
+ private:
+  // The tracking state for one of the two models.
+  struct ModelTracks {
+    explicit ModelTracks(const TrackerOptions& options) : tracker(options) {}
+
+    ObjectTracker tracker;
+    // Best frame of each live track, by track id.
+    std::unordered_map<int, std::vector<uint8_t>> best_frames;
+  };
+
+  void Report(ModelTracks* tracks, bool is_pothole,
+              std::vector<DashcamReport>* reports);
+  void KeepBestFrames(ModelTracks* tracks, const uint8_t* data, size_t size);
+
+  const DashcamOptions options_;
+  DetectionPipeline* detector_;
+  FrameGate gate_;
+  ModelTracks garbage_;
+  ModelTracks pothole_;
+  // Index of the next frame within the current sequence.
+  int64_t next_frame_ = 0;
+  DashcamStats stats_;
+  Counter* skipped_counter_;
+  Counter* tracked_counter_;
+  Counter* detected_counter_;
+
+  // Reused between frames.
+  std::vector<uint8_t> luma_;
+  DetectionResult result_;
+  std::vector<ConsolidatedDetection> finished_;
+  std::vector<int> improved_;
+};
+
+#endif  // NATIVE_DASHCAM_PIPELINE_H_
@@ -0,0 +1,122 @@
+#include "native/detection_pipeline.h"
+
+#include <chrono>
+
+#include "native/image_preprocess.h"
+#include "native/memory_tag.h"
+#include "native/yolo_postprocess.h"
+
+namespace {
+
+// Class names from CivicInference.
+const char* const kGarbageClasses[] = {"garbage", "trash", "waste", "debris",
+                                       "litter"};
+const char* const kPotholeClasses[] = {"pothole", "crack", "damage", "hole"};
+
+template <typename T, size_t N>
+constexpr int ArraySize(const T (&)[N]) {
+  return static_cast<int>(N);
+}
+
+}  // namespace
+
+DetectionPipeline::DetectionPipeline(const DetectionConfig& config,
+                                     DetectionModel* garbage_model,
+                                     DetectionModel* pothole_model)
+    : config_(config),
+      garbage_model_(garbage_model),
+      pothole_model_(pothole_model),
+      decode_latency_(MetricsRegistry::Get()->GetHistogram(
+          "detection_decode_seconds", "Time to decode a JPEG for detection.")),
+      detect_latency_(MetricsRegistry::Get()->GetHistogram(
+          "detection_seconds",
+          "Time to preprocess, run both models on and parse one image.")) {}
+
+bool DetectionPipeline::DetectJpeg(const uint8_t* data, size_t size,
+                                   DetectionResult* result) {
+  MemoryTagScope tag("detection");
+  if (!decoder_.ReadHeader(data, size) || decoder_.width() <= 0 ||
+      decoder_.height() <= 0) {
+    return false;
+  }
+  const int width = decoder_.width();
+  const int height = decoder_.height();
+  const size_t stride = static_cast<size_t>(width) * 4;
+  PooledBuffer pixels = pool_.Acquire(stride * height);
+  const RgbaImage image{pixels.as<uint8_t>(), width, height, stride};
+  {
+    ScopedLatency latency(decode_latency_);
+    if (!decoder_.Decode(image)) {
+      return false;
+    }
+  }
+  return Detect(image, result);
+}
+
+bool DetectionPipeline::Detect(const RgbaImage& image,
+                               DetectionResult* result) {
+  const auto start = std::chrono::steady_clock::now();
+  result->garbage_detections.clear();
+  result->pothole_detections.clear();
+  result->image_width = image.width;
+  result->image_height = image.height;
+
+  const int size = config_.input_size;
+  PooledBuffer tensor =
+      pool_.Acquire(static_cast<size_t>(3) * size * size * sizeof(float));
+  ResizeToChwTensor(image, size, size, tensor.as<float>());
+
+  const float scale_x = static_cast<float>(image.width) / size;
+  const float scale_y = static_cast<float>(image.height) / size;
+  const bool ok =
+      RunModel(garbage_model_, tensor.as<float>(), kGarbageClasses,
+               ArraySize(kGarbageClasses), scale_x, scale_y,
+               &result->garbage_detections) &&
+      RunModel(pothole_model_, tensor.as<float>(), kPotholeClasses,
+               ArraySize(kPotholeClasses), scale_x, scale_y,
+               &result->pothole_detections);
+  arena_.Reset();
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  result->inference_time_ms =
+      std::chrono::duration<double, std::milli>(elapsed).count();
+  if (detect_latency_ != nullptr) {
+    detect_latency_->Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+  return ok;
+}
+
+DetectionMemoryStats DetectionPipeline::memory_stats() const {
+  DetectionMemoryStats stats;
+  stats.arena = arena_.stats();
+  stats.pool = pool_.stats();
+  stats.decoder = decoder_.memory_stats();
+  return stats;
+}
+
+bool DetectionPipeline::RunModel(DetectionModel* model, const float* tensor,
+                                 const char* const* class_names,
+                                 int class_name_count, float scale_x,
+                                 float scale_y,
+                                 std::vector<Detection>* detections) {
+  const YoloOutput shape{nullptr, model->output_channels(),
+                         model->output_anchors(), model->num_classes()};
+  PooledBuffer output = pool_.Acquire(static_cast<size_t>(shape.channels) *
+                                      shape.anchors * sizeof(float));
+  if (!model->Run(tensor, config_.input_size, output.as<float>())) {
+    return false;
+  }
+
+  YoloOutput parsed = shape;
+  parsed.data = output.as<float>();
+  YoloParseOptions options;
+  options.conf_threshold = config_.conf_threshold;
+  options.iou_threshold = config_.iou_threshold;
+  options.scale_x = scale_x;
+  options.scale_y = scale_y;
+  options.class_names = class_names;
+  options.class_name_count = class_name_count;
+  ParseYoloDetections(parsed, options, &arena_, detections);
+  return true;
+}
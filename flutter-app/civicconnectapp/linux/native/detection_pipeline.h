@@ -0,0 +1,96 @@
+#ifndef NATIVE_DETECTION_PIPELINE_H_
+#define NATIVE_DETECTION_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "native/buffer_pool.h"
+#include "native/image_types.h"
+#include "native/jpeg_codec.h"
+#include "native/metrics.h"
+#include "native/tensor_arena.h"
+
+// One of the two YOLO models run by the pipeline. Implementations wrap
+// whatever inference runtime is linked in.
+class DetectionModel {
+ public:
+  virtual ~DetectionModel() = default;
+
+  // Shape of the model's output tensor without the batch dimension.
+  virtual int output_channels() const = 0;
+  virtual int output_anchors() const = 0;
+  // Number of class score rows following the four box rows.
+  virtual int num_classes() const { return output_channels() - 4; }
+
+  // Runs the model on the 1 x 3 x |input_size| x |input_size| tensor |input|,
+  // writing output_channels() * output_anchors() floats to |output|.
+  virtual bool Run(const float* input, int input_size, float* output) = 0;
+};
+
+struct DetectionConfig {
+  int input_size = 640;
+  float conf_threshold = 0.25f;
+  float iou_threshold = 0.45f;
+};
+
+// Mirrors InferenceResult in Ai-Model/model.ipynb. Reusing one result across
+// calls lets the detection vectors keep their capacity.
+struct DetectionResult {
+  std::vector<Detection> garbage_detections;
+  std::vector<Detection> pothole_detections;
+  double inference_time_ms = 0.0;
+  int image_width = 0;
+  int image_height = 0;
+};
+
+struct DetectionMemoryStats {
+  ArenaStats arena;
+  BufferPoolStats pool;
+  // libjpeg's per-image working memory.
+  ArenaStats decoder;
+};
+
+// The native detection path of CivicInference.detect: decode, preprocess,
+// run both models and parse their outputs.
+//
+// Large per-image buffers (decoded pixels, input tensor, model outputs) come
+// from a BufferPool and per-request temporaries from a TensorArena reset after
+// every image. JPEGs go through one JpegDecoder, which keeps libjpeg's
+// working memory in an arena of its own, so once warmed up the pipeline makes
+// no heap allocations at all. Not thread-safe; use one pipeline per worker.
+class DetectionPipeline {
+ public:
+  // The models must outlive the pipeline.
+  DetectionPipeline(const DetectionConfig& config,
+                    DetectionModel* garbage_model,
+                    DetectionModel* pothole_model);
+
+  DetectionPipeline(const DetectionPipeline&) = delete;
+  DetectionPipeline& operator=(const DetectionPipeline&) = delete;
+
+  // Decodes the JPEG in |data| and runs detection on it.
+  bool DetectJpeg(const uint8_t* data, size_t size, DetectionResult* result);
+
+  // Runs detection on an already decoded image.
+  bool Detect(const RgbaImage& image, DetectionResult* result);
+
+  DetectionMemoryStats memory_stats() const;
+
+ private:
+  bool RunModel(DetectionModel* model, const float* tensor,
+                const char* const* class_names, int class_name_count,
+                float scale_x, float scale_y,
+                std::vector<Detection>* detections);
+
+  DetectionConfig config_;
+  DetectionModel* garbage_model_;
+  DetectionModel* pothole_model_;
+  JpegDecoder decoder_;
+  BufferPool pool_;
+  TensorArena arena_;
+  Histogram* decode_latency_;
+  Histogram* detect_latency_;
+};
+
+#endif  // NATIVE_DETECTION_PIPELINE_H_
@@ -0,0 +1,75 @@
+#include "native/frame_gate.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrameGate::FrameGate(const FrameGateOptions& options)
+    : options_(options),
+      grid_(static_cast<size_t>(std::max(options.grid_width, 1)) *
+            std::max(options.grid_height, 1)),
+      previous_(grid_.size()),
+      keyframe_(grid_.size()) {}
+
+FrameAction FrameGate::Classify(const uint8_t* luma, int width, int height,
+                                size_t stride) {
+  ComputeGrid(luma, width, height, stride);
+  if (!has_keyframe_) {
+    has_keyframe_ = true;
+    frames_since_keyframe_ = 0;
+    last_difference_ = 0.0f;
+    previous_ = grid_;
+    keyframe_ = grid_;
+    return FrameAction::kDetect;
+  }
+
+  last_difference_ = Difference(previous_);
+  if (last_difference_ < options_.duplicate_threshold) {
+    return FrameAction::kSkip;
+  }
+  const float keyframe_difference = Difference(keyframe_);
+  previous_.swap(grid_);
+
+  ++frames_since_keyframe_;
+  if (frames_since_keyframe_ >= options_.keyframe_interval ||
+      keyframe_difference >= options_.scene_change_threshold) {
+    keyframe_ = previous_;
+    frames_since_keyframe_ = 0;
+    return FrameAction::kDetect;
+  }
+  return FrameAction::kTrack;
+}
+
+void FrameGate::Reset() {
+  has_keyframe_ = false;
+}
+
+void FrameGate::ComputeGrid(const uint8_t* luma, int width, int height,
+                            size_t stride) {
+  const int grid_width = std::max(options_.grid_width, 1);
+  const int grid_height = std::max(options_.grid_height, 1);
+  for (int gy = 0; gy < grid_height; ++gy) {
+    const int y0 = std::min(gy * height / grid_height, height - 1);
+    const int y1 = std::max((gy + 1) * height / grid_height, y0 + 1);
+    for (int gx = 0; gx < grid_width; ++gx) {
+      const int x0 = std::min(gx * width / grid_width, width - 1);
+      const int x1 = std::max((gx + 1) * width / grid_width, x0 + 1);
+      uint32_t sum = 0;
+      for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = luma + static_cast<size_t>(y) * stride;
+        for (int x = x0; x < x1; ++x) {
+          sum += row[x];
+        }
+      }
+      grid_[gy * grid_width + gx] =
+          static_cast<float>(sum) / ((y1 - y0) * (x1 - x0));
+    }
+  }
+}
+
+float FrameGate::Difference(const std::vector<float>& other) const {
+  float total = 0.0f;
+  for (size_t i = 0; i < grid_.size(); ++i) {
+    total += std::fabs(grid_[i] - other[i]);
+  }
+  return total / grid_.size();
+}
@@ -0,0 +1,63 @@
+#ifndef NATIVE_FRAME_GATE_H_
+#define NATIVE_FRAME_GATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct FrameGateOptions {
+  // Frames are compared as a grid of mean luma values, which makes the check
+  // independent of resolution and insensitive to sensor noise.
+  int grid_width = 32;
+  int grid_height = 18;
+  // Mean absolute grid difference (0-255) to the previous frame below which
+  // a frame is a near-duplicate and skipped outright, e.g. while stopped.
+  float duplicate_threshold = 1.5f;
+  // Difference to the last keyframe at or above which the scene has changed
+  // enough that detections can no longer be carried forward.
+  float scene_change_threshold = 12.0f;
+  // Most non-duplicate frames between keyframes, so that new objects are
+  // picked up even while the scene changes slowly.
+  int keyframe_interval = 6;
+};
+
+enum class FrameAction {
+  // A near-duplicate of the previous frame; nothing to do.
+  kSkip,
+  // Carry tracked objects forward without running the detector.
+  kTrack,
+  // Run the detector.
+  kDetect,
+};
+
+// Decides per frame of a video sequence whether the detector needs to run,
+// from a cheap comparison of low-resolution luma. Not thread-safe.
+class FrameGate {
+ public:
+  explicit FrameGate(const FrameGateOptions& options);
+
+  // Classifies the next frame from its |width| x |height| luma plane, rows
+  // |stride| bytes apart. The first frame is always a keyframe.
+  FrameAction Classify(const uint8_t* luma, int width, int height,
+                       size_t stride);
+
+  // Forgets previous frames so the next one is a keyframe.
+  void Reset();
+
+  // Difference of the last classified frame to the previous one.
+  float last_difference() const { return last_difference_; }
+
+ private:
+  void ComputeGrid(const uint8_t* luma, int width, int height, size_t stride);
+  float Difference(const std::vector<float>& other) const;
+
+  const FrameGateOptions options_;
+  std::vector<float> grid_;
+  std::vector<float> previous_;
+  std::vector<float> keyframe_;
+  bool has_keyframe_ = false;
+  int frames_since_keyframe_ = 0;
+  float last_difference_ = 0.0f;
+};
+
+#endif  // NATIVE_FRAME_GATE_H_
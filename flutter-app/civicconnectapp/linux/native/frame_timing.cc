@@ -0,0 +1,377 @@
+#include "native/frame_timing.h"
+
+#include <execinfo.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+constexpr int kMaxStackFrames = 48;
+
+// The signal handler and the kernel's signal trampoline at the top of every
+// sample.
+constexpr int kSignalFrames = 2;
+
+// How long the watchdog waits for the main thread to run the signal handler.
+constexpr auto kSampleTimeout = std::chrono::milliseconds(100);
+
+// The process-wide stack sample slot. Each request gets a sequence number,
+// packed with the slot's state into one word so that the signal handler can
+// claim the slot for exactly the request it answers, and the watchdog can
+// tell a sample written for its request from a late one for an abandoned
+// request.
+enum SampleState : uint64_t {
+  kSampleIdle,
+  kSampleRequested,
+  // The handler is filling g_sample_frames; nobody else may touch them.
+  kSampleWriting,
+  kSampleDone,
+};
+constexpr uint64_t kSampleStateMask = 3;
+std::atomic<uint64_t> g_sample_slot(kSampleIdle);
+void* g_sample_frames[kMaxStackFrames];
+int g_sample_depth = 0;
+
+uint64_t SampleSlot(uint64_t sequence, SampleState state) {
+  return sequence << 2 | state;
+}
+
+struct sigaction g_previous_action;
+
+// SIGRTMIN itself and SIGPROF are taken by glibc and the Dart VM profiler.
+int StackSampleSignal() {
+  return SIGRTMIN + 4;
+}
+
+void HandleStackSampleSignal(int) {
+  uint64_t slot = g_sample_slot.load(std::memory_order_acquire);
+  const uint64_t sequence = slot >> 2;
+  if ((slot & kSampleStateMask) != kSampleRequested ||
+      !g_sample_slot.compare_exchange_strong(
+          slot, SampleSlot(sequence, kSampleWriting),
+          std::memory_order_acq_rel)) {
+    return;
+  }
+  const int saved_errno = errno;
+  g_sample_depth = backtrace(g_sample_frames, kMaxStackFrames);
+  g_sample_slot.store(SampleSlot(sequence, kSampleDone),
+                      std::memory_order_release);
+  errno = saved_errno;
+}
+
+double NanosToMillis(uint64_t nanos) {
+  return static_cast<double>(nanos) / 1e6;
+}
+
+void AppendJsonString(const std::string& value, std::string* out) {
+  out->push_back('"');
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out->append(escaped);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendJsonNumber(const char* key, double value, std::string* out) {
+  char field[64];
+  snprintf(field, sizeof(field), "\"%s\":%.3f,", key, value);
+  out->append(field);
+}
+
+void AppendJsonCount(const char* key, uint64_t value, std::string* out) {
+  char field[64];
+  snprintf(field, sizeof(field), "\"%s\":%" PRIu64 ",", key, value);
+  out->append(field);
+}
+
+}  // namespace
+
+std::string FrameTimingSummary::ToJson() const {
+  std::string json = "{";
+  AppendJsonCount("frames", frames, &json);
+  AppendJsonCount("window", window, &json);
+  AppendJsonNumber("p50_ms", p50_ms, &json);
+  AppendJsonNumber("p95_ms", p95_ms, &json);
+  AppendJsonNumber("p99_ms", p99_ms, &json);
+  AppendJsonNumber("max_ms", max_ms, &json);
+  AppendJsonNumber("refresh_ms", refresh_ms, &json);
+  AppendJsonCount("missed_vsyncs", missed_vsyncs, &json);
+  AppendJsonCount("stalls", stalls, &json);
+  AppendJsonNumber("longest_stall_ms", longest_stall_ms, &json);
+  AppendJsonCount("idle_intervals", idle_intervals, &json);
+  AppendJsonNumber("longest_idle_ms", longest_idle_ms, &json);
+  json.append("\"longest_stall_stack\":[");
+  for (size_t i = 0; i < longest_stall_stack.size(); ++i) {
+    if (i != 0) {
+      json.push_back(',');
+    }
+    AppendJsonString(longest_stall_stack[i], &json);
+  }
+  json.append("]}");
+  return json;
+}
+
+FrameTimingMonitor::FrameTimingMonitor(const FrameTimingOptions& options)
+    : options_(options),
+      heartbeat_interval_ns_(
+          std::chrono::nanoseconds(options.heartbeat_interval).count()),
+      stall_threshold_ns_(
+          std::chrono::nanoseconds(options.stall_threshold).count()),
+      frame_interval_histogram_(MetricsRegistry::Get()->GetHistogram(
+          "frame_interval_seconds",
+          "Time between consecutive painted frames while animating.")),
+      stall_histogram_(MetricsRegistry::Get()->GetHistogram(
+          "main_loop_stall_seconds",
+          "How late main-loop heartbeats ran when over the stall threshold.")),
+      missed_vsync_counter_(MetricsRegistry::Get()->GetCounter(
+          "missed_vsyncs", "Vsyncs that passed without a new frame.")),
+      ring_(std::max<size_t>(options.capacity, 1)),
+      heartbeats_(0),
+      last_heartbeat_ns_(0),
+      main_thread_() {}
+
+FrameTimingMonitor::~FrameTimingMonitor() {
+  Stop();
+}
+
+void FrameTimingMonitor::Start() {
+  std::lock_guard<std::mutex> lock(watchdog_mutex_);
+  if (running_) {
+    return;
+  }
+  main_thread_ = pthread_self();
+
+  // The first backtrace() loads libgcc_s, which is not safe to do inside a
+  // signal handler.
+  void* warmup[1];
+  backtrace(warmup, 1);
+  struct sigaction action = {};
+  action.sa_handler = HandleStackSampleSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(StackSampleSignal(), &action, &g_previous_action);
+
+  last_heartbeat_ns_.store(MetricsNowNs(), std::memory_order_release);
+  running_ = true;
+  watchdog_ = std::thread(&FrameTimingMonitor::RunWatchdog, this);
+}
+
+void FrameTimingMonitor::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  watchdog_wake_.notify_all();
+  watchdog_.join();
+  sigaction(StackSampleSignal(), &g_previous_action, nullptr);
+}
+
+void FrameTimingMonitor::OnFrame(uint64_t frame_time_ns,
+                                 uint64_t refresh_interval_ns) {
+  const uint64_t idle_gap_ns =
+      std::chrono::nanoseconds(options_.idle_gap).count();
+  uint64_t interval = 0;
+  uint32_t missed = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (refresh_interval_ns != 0) {
+      refresh_interval_ns_ = refresh_interval_ns;
+    }
+    const uint64_t previous = last_frame_ns_;
+    last_frame_ns_ = frame_time_ns;
+    if (previous == 0 || frame_time_ns <= previous) {
+      return;
+    }
+    interval = frame_time_ns - previous;
+    if (interval > idle_gap_ns) {
+      // A stall that ended during the interval, or one still going by the
+      // heartbeats, kept the main loop from painting: that is jank. Without
+      // one, nothing asked for a frame.
+      const uint64_t last_heartbeat =
+          last_heartbeat_ns_.load(std::memory_order_acquire);
+      const bool stalled =
+          last_stall_end_ns_ > previous ||
+          (last_heartbeat != 0 && frame_time_ns > last_heartbeat &&
+           frame_time_ns - last_heartbeat >
+               heartbeat_interval_ns_ + stall_threshold_ns_);
+      if (!stalled) {
+        ++idle_intervals_;
+        longest_idle_ns_ = std::max(longest_idle_ns_, interval);
+        return;
+      }
+    }
+    if (refresh_interval_ns_ != 0) {
+      // Rounded so that jitter around a single vsync does not count.
+      const uint64_t vsyncs =
+          (interval + refresh_interval_ns_ / 2) / refresh_interval_ns_;
+      missed = vsyncs > 1 ? static_cast<uint32_t>(vsyncs - 1) : 0;
+    }
+    ring_[ring_next_] = FrameSample{frame_time_ns,
+                                    static_cast<uint32_t>(interval / 1000),
+                                    missed};
+    ring_next_ = (ring_next_ + 1) % ring_.size();
+    ++frames_;
+    missed_vsyncs_ += missed;
+  }
+  if (frame_interval_histogram_ != nullptr) {
+    frame_interval_histogram_->Record(interval);
+  }
+  if (missed != 0 && missed_vsync_counter_ != nullptr) {
+    missed_vsync_counter_->Increment(missed);
+  }
+}
+
+void FrameTimingMonitor::OnMainLoopHeartbeat(uint64_t now_ns) {
+  const uint64_t heartbeat = heartbeats_.load(std::memory_order_relaxed);
+  const uint64_t previous = last_heartbeat_ns_.load(std::memory_order_relaxed);
+  const uint64_t expected = previous + heartbeat_interval_ns_;
+  if (previous != 0 && now_ns > expected &&
+      now_ns - expected > stall_threshold_ns_) {
+    const uint64_t stall = now_ns - expected;
+    if (stall_histogram_ != nullptr) {
+      stall_histogram_->Record(stall);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stalls_;
+    last_stall_end_ns_ = now_ns;
+    if (stall > longest_stall_ns_) {
+      longest_stall_ns_ = stall;
+      if (sampled_for_ == heartbeat && !sampled_stack_.empty()) {
+        longest_stall_stack_.swap(sampled_stack_);
+      } else {
+        longest_stall_stack_.clear();
+      }
+    }
+  }
+  last_heartbeat_ns_.store(now_ns, std::memory_order_release);
+  heartbeats_.store(heartbeat + 1, std::memory_order_release);
+}
+
+FrameTimingSummary FrameTimingMonitor::Summarize() const {
+  FrameTimingSummary summary;
+  std::vector<uint32_t> intervals;
+  std::vector<void*> stack;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    summary.frames = frames_;
+    summary.window = std::min<uint64_t>(frames_, ring_.size());
+    intervals.reserve(summary.window);
+    for (size_t i = 0; i < summary.window; ++i) {
+      intervals.push_back(ring_[i].interval_us);
+    }
+    summary.refresh_ms = NanosToMillis(refresh_interval_ns_);
+    summary.missed_vsyncs = missed_vsyncs_;
+    summary.stalls = stalls_;
+    summary.longest_stall_ms = NanosToMillis(longest_stall_ns_);
+    summary.idle_intervals = idle_intervals_;
+    summary.longest_idle_ms = NanosToMillis(longest_idle_ns_);
+    stack = longest_stall_stack_;
+  }
+
+  if (!intervals.empty()) {
+    std::sort(intervals.begin(), intervals.end());
+    const auto at = [&intervals](double q) {
+      const size_t rank = static_cast<size_t>(std::ceil(q * intervals.size()));
+      return intervals[std::max<size_t>(rank, 1) - 1] / 1000.0;
+    };
+    summary.p50_ms = at(0.50);
+    summary.p95_ms = at(0.95);
+    summary.p99_ms = at(0.99);
+    summary.max_ms = intervals.back() / 1000.0;
+  }
+
+  if (!stack.empty()) {
+    char** symbols = backtrace_symbols(stack.data(), stack.size());
+    if (symbols != nullptr) {
+      summary.longest_stall_stack.assign(symbols, symbols + stack.size());
+      free(symbols);
+    }
+  }
+  return summary;
+}
+
+void FrameTimingMonitor::RunWatchdog() {
+  const auto period = std::max<std::chrono::milliseconds>(
+      options_.stall_threshold / 4, std::chrono::milliseconds(5));
+  uint64_t sampled_heartbeat = UINT64_MAX;
+  std::unique_lock<std::mutex> lock(watchdog_mutex_);
+  while (running_) {
+    if (watchdog_wake_.wait_for(lock, period, [this] { return !running_; })) {
+      break;
+    }
+    const uint64_t heartbeat = heartbeats_.load(std::memory_order_acquire);
+    const uint64_t last = last_heartbeat_ns_.load(std::memory_order_acquire);
+    const uint64_t now = MetricsNowNs();
+    if (heartbeat == sampled_heartbeat || now < last ||
+        now - last <= heartbeat_interval_ns_ + stall_threshold_ns_) {
+      continue;
+    }
+    // The main loop is stuck; one sample per stall is enough.
+    sampled_heartbeat = heartbeat;
+    lock.unlock();
+    SampleMainThread(heartbeat);
+    lock.lock();
+  }
+}
+
+void FrameTimingMonitor::SampleMainThread(uint64_t heartbeat) {
+  // A handler still writing for an abandoned request owns the frames; skip
+  // this stall rather than race it.
+  uint64_t slot = g_sample_slot.load(std::memory_order_acquire);
+  if ((slot & kSampleStateMask) == kSampleWriting) {
+    return;
+  }
+  const uint64_t sequence = (slot >> 2) + 1;
+  if (!g_sample_slot.compare_exchange_strong(
+          slot, SampleSlot(sequence, kSampleRequested),
+          std::memory_order_acq_rel)) {
+    return;
+  }
+  uint64_t requested = SampleSlot(sequence, kSampleRequested);
+  if (pthread_kill(main_thread_, StackSampleSignal()) != 0) {
+    g_sample_slot.compare_exchange_strong(requested,
+                                          SampleSlot(sequence, kSampleIdle),
+                                          std::memory_order_acq_rel);
+    return;
+  }
+  const auto deadline = std::chrono::steady_clock::now() + kSampleTimeout;
+  while (g_sample_slot.load(std::memory_order_acquire) !=
+         SampleSlot(sequence, kSampleDone)) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      // Withdraw the request if the handler has not claimed it. If it has,
+      // it finishes into a Done slot for this sequence that nobody reads, and
+      // the next request replaces it.
+      g_sample_slot.compare_exchange_strong(requested,
+                                            SampleSlot(sequence, kSampleIdle),
+                                            std::memory_order_acq_rel);
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int skipped = std::min(g_sample_depth, kSignalFrames);
+    sampled_stack_.assign(g_sample_frames + skipped,
+                          g_sample_frames + g_sample_depth);
+    sampled_for_ = heartbeat;
+  }
+  g_sample_slot.store(SampleSlot(sequence, kSampleIdle),
+                      std::memory_order_release);
+}
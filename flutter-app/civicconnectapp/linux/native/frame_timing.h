@@ -0,0 +1,141 @@
+#ifndef NATIVE_FRAME_TIMING_H_
+#define NATIVE_FRAME_TIMING_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native/metrics.h"
+
+struct FrameTimingOptions {
+  // Frames kept for percentiles; older ones are overwritten.
+  size_t capacity = 4096;
+  // How often the runner calls OnMainLoopHeartbeat().
+  std::chrono::milliseconds heartbeat_interval{20};
+  // A heartbeat this much later than expected counts as a main-loop stall,
+  // and the main thread's stack is sampled while it lasts.
+  std::chrono::milliseconds stall_threshold{100};
+  // Frame intervals longer than this are taken as idle time between bursts of
+  // animation rather than jank, unless the main loop stalled during them: a
+  // frame the app wanted could not have been produced then. Idle intervals
+  // are counted but kept out of the percentiles.
+  std::chrono::milliseconds idle_gap{250};
+};
+
+struct FrameSample {
+  uint64_t frame_time_ns;
+  uint32_t interval_us;
+  // Vsyncs between this frame and the previous one that produced no frame.
+  uint32_t missed_vsyncs;
+};
+
+struct FrameTimingSummary {
+  // Frames recorded since Start(), and how many of them the percentiles
+  // cover.
+  uint64_t frames = 0;
+  size_t window = 0;
+  double p50_ms = 0.0;
+  double p95_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+  double refresh_ms = 0.0;
+  uint64_t missed_vsyncs = 0;
+  uint64_t stalls = 0;
+  double longest_stall_ms = 0.0;
+  // Intervals over idle_gap with no main-loop stall, which are not in
+  // |frames|.
+  uint64_t idle_intervals = 0;
+  double longest_idle_ms = 0.0;
+  // Symbolized main-thread stack sampled during the longest stall, innermost
+  // frame first. Empty if the stall ended before it could be sampled.
+  std::vector<std::string> longest_stall_stack;
+
+  std::string ToJson() const;
+};
+
+// Collects per-frame timing for a window and detects main-loop stalls.
+//
+// The owner forwards frame clock paints to OnFrame() and calls
+// OnMainLoopHeartbeat() from a main-loop timer every heartbeat_interval. A
+// watchdog thread notices heartbeats that are overdue and signals the main
+// thread to record its stack, so the longest stall comes with a sample of
+// what was blocking it. Timestamps are CLOCK_MONOTONIC nanoseconds, the clock
+// of MetricsNowNs() and g_get_monotonic_time().
+//
+// Frame intervals and stalls are also recorded into the frame_interval_seconds
+// and main_loop_stall_seconds histograms of MetricsRegistry. Only one monitor
+// may be started at a time, since stack samples go through a process-wide
+// signal handler.
+class FrameTimingMonitor {
+ public:
+  explicit FrameTimingMonitor(const FrameTimingOptions& options);
+  ~FrameTimingMonitor();
+
+  FrameTimingMonitor(const FrameTimingMonitor&) = delete;
+  FrameTimingMonitor& operator=(const FrameTimingMonitor&) = delete;
+
+  // Starts the watchdog. Must be called on the main-loop thread, which is the
+  // one whose stack is sampled.
+  void Start();
+  void Stop();
+
+  // Records a frame painted at |frame_time_ns| on a display refreshing every
+  // |refresh_interval_ns|, or 0 if unknown.
+  void OnFrame(uint64_t frame_time_ns, uint64_t refresh_interval_ns);
+
+  void OnMainLoopHeartbeat(uint64_t now_ns);
+
+  // Safe to call from any thread.
+  FrameTimingSummary Summarize() const;
+
+ private:
+  void RunWatchdog();
+  void SampleMainThread(uint64_t heartbeat);
+
+  const FrameTimingOptions options_;
+  const uint64_t heartbeat_interval_ns_;
+  const uint64_t stall_threshold_ns_;
+  Histogram* frame_interval_histogram_;
+  Histogram* stall_histogram_;
+  Counter* missed_vsync_counter_;
+
+  // Written on the main thread and read by Summarize().
+  mutable std::mutex mutex_;
+  std::vector<FrameSample> ring_;
+  size_t ring_next_ = 0;
+  uint64_t frames_ = 0;
+  uint64_t last_frame_ns_ = 0;
+  uint64_t refresh_interval_ns_ = 0;
+  uint64_t missed_vsyncs_ = 0;
+  uint64_t stalls_ = 0;
+  uint64_t longest_stall_ns_ = 0;
+  // Time of the heartbeat that ended the last stall.
+  uint64_t last_stall_end_ns_ = 0;
+  uint64_t idle_intervals_ = 0;
+  uint64_t longest_idle_ns_ = 0;
+  std::vector<void*> longest_stall_stack_;
+
+  // Sampled by the watchdog for the stall after heartbeat |sampled_for_|.
+  std::vector<void*> sampled_stack_;
+  uint64_t sampled_for_ = 0;
+
+  // Heartbeat count and time of the last one, read by the watchdog.
+  std::atomic<uint64_t> heartbeats_;
+  std::atomic<uint64_t> last_heartbeat_ns_;
+
+  pthread_t main_thread_;
+  std::mutex watchdog_mutex_;
+  std::condition_variable watchdog_wake_;
+  bool running_ = false;
+  std::thread watchdog_;
+};
+
+#endif  // NATIVE_FRAME_TIMING_H_
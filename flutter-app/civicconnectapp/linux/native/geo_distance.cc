@@ -0,0 +1,31 @@
+#include "native/geo_distance.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kRadiansPerDegree = M_PI / 180;
+
+}  // namespace
+
+void HaversineDistances(double latitude, double longitude,
+                        const double* latitudes, const double* longitudes,
+                        size_t count, double* meters) {
+  const double origin_latitude = latitude * kRadiansPerDegree;
+  const double cos_origin_latitude = std::cos(origin_latitude);
+  for (size_t i = 0; i < count; ++i) {
+    const double point_latitude = latitudes[i] * kRadiansPerDegree;
+    const double sin_half_dlat =
+        std::sin((point_latitude - origin_latitude) / 2);
+    const double sin_half_dlng =
+        std::sin((longitudes[i] - longitude) * kRadiansPerDegree / 2);
+    const double a =
+        sin_half_dlat * sin_half_dlat +
+        cos_origin_latitude * std::cos(point_latitude) * sin_half_dlng *
+            sin_half_dlng;
+    // 2 * atan2(sqrt(a), sqrt(1 - a)) as the backend writes it, in the
+    // cheaper asin form; rounding can push |a| a hair past 1.
+    meters[i] = 2 * kEarthRadiusMeters * std::asin(std::sqrt(std::min(a, 1.0)));
+  }
+}
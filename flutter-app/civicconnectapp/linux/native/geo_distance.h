@@ -0,0 +1,19 @@
+#ifndef NATIVE_GEO_DISTANCE_H_
+#define NATIVE_GEO_DISTANCE_H_
+
+#include <cstddef>
+
+// Mean Earth radius used by the backend's distance calculations.
+constexpr double kEarthRadiusMeters = 6371e3;
+
+// Writes to |meters|[i] the great-circle distance in metres from
+// (|latitude|, |longitude|) to (|latitudes|[i], |longitudes|[i]), all in
+// degrees, for |count| points. Uses the haversine formula of GET
+// /complaints/nearby, so the results match its distance_meters before
+// rounding. The coordinates are separate arrays so that the loop streams
+// through them; the origin's terms are computed once per batch.
+void HaversineDistances(double latitude, double longitude,
+                        const double* latitudes, const double* longitudes,
+                        size_t count, double* meters);
+
+#endif  // NATIVE_GEO_DISTANCE_H_
@@ -0,0 +1,65 @@
+#include "native/image_preprocess.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+// Maps output coordinate |dst| to the two source samples it interpolates
+// between and the weight of the second one.
+inline void SourceCoordinate(int dst, float scale, int limit, int* first,
+                             int* second, float* weight) {
+  float src = (dst + 0.5f) * scale - 0.5f;
+  if (src < 0.0f) {
+    src = 0.0f;
+  }
+  int index = static_cast<int>(src);
+  if (index >= limit - 1) {
+    index = limit - 1;
+    src = static_cast<float>(index);
+  }
+  *first = index;
+  *second = std::min(index + 1, limit - 1);
+  *weight = src - index;
+}
+
+}  // namespace
+
+void ResizeToChwTensor(const RgbaImage& image, int width, int height,
+                       float* tensor) {
+  const size_t plane = static_cast<size_t>(width) * height;
+  float* red = tensor;
+  float* green = tensor + plane;
+  float* blue = tensor + 2 * plane;
+  const float scale_x = static_cast<float>(image.width) / width;
+  const float scale_y = static_cast<float>(image.height) / height;
+  constexpr float kNormalize = 1.0f / 255.0f;
+
+  for (int y = 0; y < height; ++y) {
+    int y0, y1;
+    float fy;
+    SourceCoordinate(y, scale_y, image.height, &y0, &y1, &fy);
+    const uint8_t* top = image.Row(y0);
+    const uint8_t* bottom = image.Row(y1);
+    const float wy0 = (1.0f - fy) * kNormalize;
+    const float wy1 = fy * kNormalize;
+
+    for (int x = 0; x < width; ++x) {
+      int x0, x1;
+      float fx;
+      SourceCoordinate(x, scale_x, image.width, &x0, &x1, &fx);
+      const uint8_t* tl = top + x0 * 4;
+      const uint8_t* tr = top + x1 * 4;
+      const uint8_t* bl = bottom + x0 * 4;
+      const uint8_t* br = bottom + x1 * 4;
+      const float w00 = (1.0f - fx) * wy0;
+      const float w01 = fx * wy0;
+      const float w10 = (1.0f - fx) * wy1;
+      const float w11 = fx * wy1;
+      const size_t i = static_cast<size_t>(y) * width + x;
+      red[i] = tl[0] * w00 + tr[0] * w01 + bl[0] * w10 + br[0] * w11;
+      green[i] = tl[1] * w00 + tr[1] * w01 + bl[1] * w10 + br[1] * w11;
+      blue[i] = tl[2] * w00 + tr[2] * w01 + bl[2] * w10 + br[2] * w11;
+    }
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef NATIVE_IMAGE_PREPROCESS_H_
+#define NATIVE_IMAGE_PREPROCESS_H_
+
+#include "native/image_types.h"
+
+// Resizes |image| to |width| x |height| with bilinear sampling and writes it
+// as a planar RGB float tensor in [0, 1], i.e. the 1x3xHxW input of the YOLO
+// models. |tensor| must hold 3 * width * height floats.
+//
+// This is CivicInference._preprocess (cvtColor, resize, /255, transpose) fused
+// into a single pass over the output, with cv2.INTER_LINEAR's half-pixel
+// sampling.
+void ResizeToChwTensor(const RgbaImage& image, int width, int height,
+                       float* tensor);
+
+#endif  // NATIVE_IMAGE_PREPROCESS_H_
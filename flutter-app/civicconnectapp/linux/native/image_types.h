@@ -0,0 +1,46 @@
+#ifndef NATIVE_IMAGE_TYPES_H_
+#define NATIVE_IMAGE_TYPES_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// A non-owning view over a tightly or loosely packed 8-bit RGBA image.
+// |stride| is the distance in bytes between the starts of two rows.
+struct RgbaImage {
+  uint8_t* pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  size_t stride = 0;
+
+  uint8_t* Row(int y) const { return pixels + static_cast<size_t>(y) * stride; }
+};
+
+// An RGBA colour. Alpha is only used by blending operations.
+struct Rgba {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+};
+
+// Axis-aligned box in image pixel coordinates, corner format.
+struct BoundingBox {
+  float x1;
+  float y1;
+  float x2;
+  float y2;
+
+  float width() const { return x2 - x1; }
+  float height() const { return y2 - y1; }
+};
+
+// A single detection, mirroring the Detection dataclass in
+// Ai-Model/model.ipynb. |class_name| must outlive the detection.
+struct Detection {
+  int class_id;
+  const char* class_name;
+  float confidence;
+  BoundingBox box;
+};
+
+#endif  // NATIVE_IMAGE_TYPES_H_
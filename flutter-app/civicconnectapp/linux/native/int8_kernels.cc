@@ -0,0 +1,297 @@
+#include "native/int8_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INT8_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Number of weight rows each kernel call reduces against one activation row,
+// so that every activation load is shared.
+constexpr int kRowBlock = 4;
+
+// Computes |Rows| dot products of consecutive weight rows, |stride| bytes
+// apart, with the activation row |a|. |depth| is a multiple of
+// kInt8DepthAlignment.
+template <int Rows>
+void DotPortable(const int8_t* w, size_t stride, const uint8_t* a, int depth,
+                 int32_t* out) {
+  for (int r = 0; r < Rows; ++r) {
+    const int8_t* row = w + r * stride;
+    int32_t sum = 0;
+    for (int k = 0; k < depth; ++k) {
+      sum += static_cast<int32_t>(a[k]) * row[k];
+    }
+    out[r] = sum;
+  }
+}
+
+#if INT8_KERNELS_X86
+__attribute__((target("avx2"))) inline int32_t HorizontalSumAvx2(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Widens both operands to 16 bits and uses madd, which is exact. The
+// narrower maddubs instruction would saturate on u8 x s8 pairs.
+template <int Rows>
+__attribute__((target("avx2"))) void DotAvx2(const int8_t* w, size_t stride,
+                                             const uint8_t* a, int depth,
+                                             int32_t* out) {
+  __m256i acc[Rows];
+  for (int r = 0; r < Rows; ++r) {
+    acc[r] = _mm256_setzero_si256();
+  }
+  for (int k = 0; k < depth; k += 16) {
+    const __m256i a16 = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k)));
+    for (int r = 0; r < Rows; ++r) {
+      const __m256i w16 = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + r * stride + k)));
+      acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(a16, w16));
+    }
+  }
+  for (int r = 0; r < Rows; ++r) {
+    out[r] = HorizontalSumAvx2(acc[r]);
+  }
+}
+
+// vpdpbusd multiplies u8 by s8 and accumulates into s32 without saturation.
+template <int Rows>
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) void DotAvx512Vnni(
+    const int8_t* w, size_t stride, const uint8_t* a, int depth,
+    int32_t* out) {
+  __m512i acc[Rows];
+  for (int r = 0; r < Rows; ++r) {
+    acc[r] = _mm512_setzero_si512();
+  }
+  for (int k = 0; k < depth; k += 64) {
+    const __m512i a8 = _mm512_loadu_si512(a + k);
+    for (int r = 0; r < Rows; ++r) {
+      acc[r] =
+          _mm512_dpbusd_epi32(acc[r], a8, _mm512_loadu_si512(w + r * stride + k));
+    }
+  }
+  for (int r = 0; r < Rows; ++r) {
+    // GCC's unmasked 512-to-256 bit extracts trip -Wuninitialized, which
+    // rules out _mm512_reduce_add_epi32; use zero-masked extracts instead.
+    out[r] = HorizontalSumAvx2(
+        _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xFF, acc[r], 0),
+                         _mm512_maskz_extracti64x4_epi64(0xFF, acc[r], 1)));
+  }
+}
+#endif
+
+using DotKernel = void (*)(const int8_t*, size_t, const uint8_t*, int,
+                           int32_t*);
+
+struct KernelPair {
+  DotKernel block;
+  DotKernel single;
+};
+
+KernelPair KernelsFor(Int8Isa isa) {
+#if INT8_KERNELS_X86
+  if (isa == Int8Isa::kAvx512Vnni) {
+    return {DotAvx512Vnni<kRowBlock>, DotAvx512Vnni<1>};
+  }
+  if (isa == Int8Isa::kAvx2) {
+    return {DotAvx2<kRowBlock>, DotAvx2<1>};
+  }
+#endif
+  return {DotPortable<kRowBlock>, DotPortable<1>};
+}
+
+}  // namespace
+
+bool Int8IsaSupported(Int8Isa isa) {
+  if (isa == Int8Isa::kPortable) {
+    return true;
+  }
+#if INT8_KERNELS_X86
+  __builtin_cpu_init();
+  if (isa == Int8Isa::kAvx2) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (isa == Int8Isa::kAvx512Vnni) {
+    return __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vnni");
+  }
+#endif
+  return false;
+}
+
+Int8Isa BestInt8Isa() {
+  if (Int8IsaSupported(Int8Isa::kAvx512Vnni)) {
+    return Int8Isa::kAvx512Vnni;
+  }
+  if (Int8IsaSupported(Int8Isa::kAvx2)) {
+    return Int8Isa::kAvx2;
+  }
+  return Int8Isa::kPortable;
+}
+
+const char* Int8IsaName(Int8Isa isa) {
+  switch (isa) {
+    case Int8Isa::kPortable:
+      return "portable";
+    case Int8Isa::kAvx2:
+      return "avx2";
+    case Int8Isa::kAvx512Vnni:
+      return "avx512-vnni";
+  }
+  return "unknown";
+}
+
+ActivationQuantization ActivationQuantizationForRange(float min, float max) {
+  min = std::min(min, 0.0f);
+  max = std::max(max, 0.0f);
+  ActivationQuantization quantization;
+  quantization.scale = max > min ? (max - min) / 255.0f : 1.0f;
+  const float zero_point = std::round(-min / quantization.scale);
+  quantization.zero_point =
+      static_cast<int32_t>(std::min(std::max(zero_point, 0.0f), 255.0f));
+  return quantization;
+}
+
+void QuantizeActivations(const float* values, size_t count,
+                         ActivationQuantization quantization, uint8_t* out) {
+  const float inverse_scale = 1.0f / quantization.scale;
+  const float zero_point = static_cast<float>(quantization.zero_point);
+  for (size_t i = 0; i < count; ++i) {
+    const float q = std::nearbyint(values[i] * inverse_scale) + zero_point;
+    out[i] = static_cast<uint8_t>(std::min(std::max(q, 0.0f), 255.0f));
+  }
+}
+
+Int8Weights QuantizeWeightsPerChannel(const float* weights, int rows,
+                                      int depth) {
+  Int8Weights result;
+  result.rows = rows;
+  result.depth = depth;
+  result.padded_depth = PadInt8Depth(depth);
+  result.values.assign(static_cast<size_t>(rows) * result.padded_depth, 0);
+  result.scales.resize(rows);
+  result.row_sums.resize(rows);
+
+  for (int r = 0; r < rows; ++r) {
+    const float* row = weights + static_cast<size_t>(r) * depth;
+    float max_abs = 0.0f;
+    for (int k = 0; k < depth; ++k) {
+      max_abs = std::max(max_abs, std::fabs(row[k]));
+    }
+    const float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+    int8_t* out = &result.values[static_cast<size_t>(r) * result.padded_depth];
+    int32_t sum = 0;
+    for (int k = 0; k < depth; ++k) {
+      const float q = std::nearbyint(row[k] / scale);
+      out[k] = static_cast<int8_t>(std::min(std::max(q, -127.0f), 127.0f));
+      sum += out[k];
+    }
+    result.scales[r] = scale;
+    result.row_sums[r] = sum;
+  }
+  return result;
+}
+
+void Int8Gemm(const Int8Weights& weights, const uint8_t* activations,
+              int columns, ActivationQuantization quantization,
+              const float* bias, float* out, Int8Isa isa) {
+  const KernelPair kernels = KernelsFor(isa);
+  const size_t stride = weights.padded_depth;
+  const int blocked_rows = weights.rows / kRowBlock * kRowBlock;
+
+  for (int c = 0; c < columns; ++c) {
+    const uint8_t* a = activations + static_cast<size_t>(c) * stride;
+    int32_t dots[kRowBlock];
+    for (int r = 0; r < weights.rows;) {
+      const int8_t* w = &weights.values[static_cast<size_t>(r) * stride];
+      int count = kRowBlock;
+      if (r < blocked_rows) {
+        kernels.block(w, stride, a, weights.padded_depth, dots);
+      } else {
+        kernels.single(w, stride, a, weights.padded_depth, dots);
+        count = 1;
+      }
+      for (int i = 0; i < count; ++i, ++r) {
+        const int32_t centered =
+            dots[i] - quantization.zero_point * weights.row_sums[r];
+        float value = centered * (quantization.scale * weights.scales[r]);
+        if (bias != nullptr) {
+          value += bias[r];
+        }
+        out[static_cast<size_t>(r) * columns + c] = value;
+      }
+    }
+  }
+}
+
+Int8Conv2d::Int8Conv2d(const ConvShape& shape, const float* weights,
+                       const float* bias)
+    : shape_(shape),
+      weights_(QuantizeWeightsPerChannel(weights, shape.out_channels,
+                                         shape.depth())) {
+  if (bias != nullptr) {
+    bias_.assign(bias, bias + shape.out_channels);
+  }
+}
+
+void Int8Conv2d::Run(const float* input, ActivationQuantization quantization,
+                     float* output, Int8Isa isa) {
+  Pack(input, quantization);
+  Multiply(output, isa);
+}
+
+void Int8Conv2d::Pack(const float* input, ActivationQuantization quantization) {
+  const ConvShape& s = shape_;
+  packed_quantization_ = quantization;
+  const size_t input_size =
+      static_cast<size_t>(s.in_channels) * s.in_height * s.in_width;
+  quantized_input_.resize(input_size);
+  QuantizeActivations(input, input_size, quantization, quantized_input_.data());
+
+  const int out_height = s.out_height();
+  const int out_width = s.out_width();
+  const int columns = out_height * out_width;
+  const size_t stride = weights_.padded_depth;
+  patches_.resize(static_cast<size_t>(columns) * stride);
+
+  // im2col: one row of in_channels x kernel x kernel values per output pixel,
+  // in the same order as the weights. Taps that fall into the padding take the
+  // zero point, i.e. real zero.
+  const uint8_t pad = static_cast<uint8_t>(quantization.zero_point);
+  for (int oy = 0; oy < out_height; ++oy) {
+    for (int ox = 0; ox < out_width; ++ox) {
+      uint8_t* patch =
+          &patches_[(static_cast<size_t>(oy) * out_width + ox) * stride];
+      for (int c = 0; c < s.in_channels; ++c) {
+        const uint8_t* plane = &quantized_input_[static_cast<size_t>(c) *
+                                                 s.in_height * s.in_width];
+        for (int ky = 0; ky < s.kernel; ++ky) {
+          const int iy = oy * s.stride - s.padding + ky;
+          for (int kx = 0; kx < s.kernel; ++kx) {
+            const int ix = ox * s.stride - s.padding + kx;
+            const bool inside =
+                iy >= 0 && iy < s.in_height && ix >= 0 && ix < s.in_width;
+            *patch++ = inside ? plane[iy * s.in_width + ix] : pad;
+          }
+        }
+      }
+      memset(patch, 0, stride - s.depth());
+    }
+  }
+}
+
+void Int8Conv2d::Multiply(float* output, Int8Isa isa) {
+  Int8Gemm(weights_, patches_.data(), shape_.out_height() * shape_.out_width(),
+           packed_quantization_, bias_.empty() ? nullptr : bias_.data(),
+           output, isa);
+}
@@ -0,0 +1,130 @@
+#ifndef NATIVE_INT8_KERNELS_H_
+#define NATIVE_INT8_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// INT8 GEMM and convolution kernels for running the YOLO models quantized.
+//
+// Weights are quantized symmetrically to int8 with one scale per output
+// channel. Activations are quantized asymmetrically to uint8 with a single
+// scale and zero point per tensor, chosen by calibration (see
+// tools/int8_calibrate.cc). Accumulation is exact in int32.
+
+// Instruction set used by the kernels.
+enum class Int8Isa {
+  kPortable,
+  kAvx2,
+  kAvx512Vnni,
+};
+
+// Returns whether the running CPU can execute kernels for |isa|.
+bool Int8IsaSupported(Int8Isa isa);
+
+// Returns the fastest instruction set the running CPU supports.
+Int8Isa BestInt8Isa();
+
+// Returns a short name for |isa|, e.g. "avx2".
+const char* Int8IsaName(Int8Isa isa);
+
+// The reduction depth of weights and activation rows is zero-padded to a
+// multiple of this so the SIMD kernels never need a scalar tail.
+constexpr int kInt8DepthAlignment = 64;
+
+inline int PadInt8Depth(int depth) {
+  return (depth + kInt8DepthAlignment - 1) / kInt8DepthAlignment *
+         kInt8DepthAlignment;
+}
+
+// Affine mapping real = scale * (quantized - zero_point).
+struct ActivationQuantization {
+  float scale;
+  int32_t zero_point;
+};
+
+// Chooses the uint8 mapping covering [min, max], widened to include zero so
+// that zero padding is exact.
+ActivationQuantization ActivationQuantizationForRange(float min, float max);
+
+// Quantizes |count| values to uint8 with |quantization|.
+void QuantizeActivations(const float* values, size_t count,
+                         ActivationQuantization quantization, uint8_t* out);
+
+// A row-major int8 weight matrix with per-row scales.
+struct Int8Weights {
+  int rows = 0;
+  int depth = 0;
+  int padded_depth = 0;
+  // rows x padded_depth, zero padded.
+  std::vector<int8_t> values;
+  // One scale per row.
+  std::vector<float> scales;
+  // Sum of each row's quantized values, for the zero point correction.
+  std::vector<int32_t> row_sums;
+};
+
+// Quantizes the |rows| x |depth| row-major matrix |weights|, one symmetric
+// scale per row.
+Int8Weights QuantizeWeightsPerChannel(const float* weights, int rows,
+                                      int depth);
+
+// Computes out[r * columns + c] = dot(weights[r], activations[c]) + bias[r] in
+// real units, where |activations| holds |columns| rows of
+// weights.padded_depth quantized values each. |bias| may be null.
+void Int8Gemm(const Int8Weights& weights, const uint8_t* activations,
+              int columns, ActivationQuantization quantization,
+              const float* bias, float* out, Int8Isa isa);
+
+// Geometry of a square-kernel 2D convolution over a CHW tensor.
+struct ConvShape {
+  int in_channels;
+  int in_height;
+  int in_width;
+  int out_channels;
+  int kernel;
+  int stride;
+  int padding;
+
+  int out_height() const {
+    return (in_height + 2 * padding - kernel) / stride + 1;
+  }
+  int out_width() const {
+    return (in_width + 2 * padding - kernel) / stride + 1;
+  }
+  // Length of one im2col patch, in_channels * kernel * kernel.
+  int depth() const { return in_channels * kernel * kernel; }
+};
+
+// A quantized 2D convolution. Weights use the ONNX [out][in][kh][kw] layout.
+class Int8Conv2d {
+ public:
+  // |bias| may be null.
+  Int8Conv2d(const ConvShape& shape, const float* weights, const float* bias);
+
+  const ConvShape& shape() const { return shape_; }
+  const Int8Weights& weights() const { return weights_; }
+
+  // Runs the convolution on the CHW float tensor |input|, quantized with
+  // |quantization|, writing a CHW float tensor to |output|. Equivalent to
+  // Pack() followed by Multiply().
+  void Run(const float* input, ActivationQuantization quantization,
+           float* output, Int8Isa isa);
+
+  // Quantizes |input| and lays it out as one padded patch per output pixel.
+  void Pack(const float* input, ActivationQuantization quantization);
+  // Runs the GEMM over the patches of the last Pack(), writing a CHW float
+  // tensor to |output|.
+  void Multiply(float* output, Int8Isa isa);
+
+ private:
+  ConvShape shape_;
+  Int8Weights weights_;
+  std::vector<float> bias_;
+  // Scratch reused across runs.
+  std::vector<uint8_t> quantized_input_;
+  std::vector<uint8_t> patches_;
+  ActivationQuantization packed_quantization_ = {1.0f, 0};
+};
+
+#endif  // NATIVE_INT8_KERNELS_H_
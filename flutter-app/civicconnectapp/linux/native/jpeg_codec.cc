@@ -0,0 +1,566 @@
+#include "native/jpeg_codec.h"
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+// libjpeg declares the virtual array types but leaves their definition to the
+// memory manager; these belong to ImagePoolMemory below.
+struct jvirt_sarray_control {
+  JSAMPARRAY rows;
+  JDIMENSION samples_per_row;
+  JDIMENSION row_count;
+  bool pre_zero;
+  jvirt_sarray_control* next;
+};
+
+struct jvirt_barray_control {
+  JBLOCKARRAY rows;
+  JDIMENSION blocks_per_row;
+  JDIMENSION row_count;
+  bool pre_zero;
+  jvirt_barray_control* next;
+};
+
+namespace {
+
+// Smallest destination buffer handed to libjpeg on the first encode.
+constexpr size_t kInitialOutputSize = 64 * 1024;
+
+// libjpeg's default error handler calls exit(); route errors back to the
+// caller instead.
+struct ErrorManager {
+  jpeg_error_mgr base;
+  jmp_buf jump;
+};
+
+void HandleError(j_common_ptr cinfo) {
+  ErrorManager* errors = reinterpret_cast<ErrorManager*>(cinfo->err);
+  longjmp(errors->jump, 1);
+}
+
+void SilenceMessage(j_common_ptr cinfo) {}
+
+// A destination manager that writes into a std::vector, doubling it when the
+// encoder runs out of room.
+struct VectorDestination {
+  jpeg_destination_mgr base;
+  std::vector<uint8_t>* out;
+};
+
+void InitDestination(j_compress_ptr cinfo) {
+  VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+  std::vector<uint8_t>* out = dest->out;
+  out->resize(out->capacity() > kInitialOutputSize ? out->capacity()
+                                                   : kInitialOutputSize);
+  dest->base.next_output_byte = out->data();
+  dest->base.free_in_buffer = out->size();
+}
+
+boolean EmptyOutputBuffer(j_compress_ptr cinfo) {
+  VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+  std::vector<uint8_t>* out = dest->out;
+  // libjpeg only calls this once the whole buffer is full.
+  const size_t used = out->size();
+  out->resize(used * 2);
+  dest->base.next_output_byte = out->data() + used;
+  dest->base.free_in_buffer = out->size() - used;
+  return TRUE;
+}
+
+void TermDestination(j_compress_ptr cinfo) {
+  VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+  dest->out->resize(dest->out->size() - dest->base.free_in_buffer);
+}
+
+// A libjpeg memory manager that serves the image pool from a TensorArena and
+// leaves the permanent pool to libjpeg's own manager. The image pool is freed
+// between images, which resets the arena; virtual arrays are always held in
+// memory, as libjpeg's manager does when nothing limits its memory.
+struct ImagePoolMemory {
+  // First, so the jpeg_memory_mgr pointer libjpeg passes around is this.
+  jpeg_memory_mgr base;
+  // libjpeg's manager, which owns the permanent pool.
+  jpeg_memory_mgr* system;
+  TensorArena* arena;
+  // Requested but not yet realized virtual arrays.
+  jvirt_sarray_control* sarrays;
+  jvirt_barray_control* barrays;
+};
+
+ImagePoolMemory* MemoryOf(j_common_ptr cinfo) {
+  return reinterpret_cast<ImagePoolMemory*>(cinfo->mem);
+}
+
+// Calls |method| of libjpeg's own manager with |args|. Its methods find
+// their state through cinfo->mem, so that points at it for the call. If the
+// call fails, the error exit leaves it there; JpegDecoder puts it back before
+// using the object again.
+template <typename Method, typename... Args>
+auto CallSystem(j_common_ptr cinfo, Method jpeg_memory_mgr::*method,
+                Args... args)
+    -> decltype((cinfo->mem->*method)(cinfo, args...)) {
+  ImagePoolMemory* memory = MemoryOf(cinfo);
+  cinfo->mem = memory->system;
+  auto result = (memory->system->*method)(cinfo, args...);
+  cinfo->mem = &memory->base;
+  return result;
+}
+
+[[noreturn]] void MemoryError(j_common_ptr cinfo, int code) {
+  cinfo->err->msg_code = code;
+  (*cinfo->err->error_exit)(cinfo);
+  abort();  // error_exit does not return.
+}
+
+// Returns |size| bytes from the arena, aligned for libjpeg-turbo's SIMD code.
+void* ArenaAllocate(j_common_ptr cinfo, size_t size) {
+  void* data = nullptr;
+  try {
+    data = MemoryOf(cinfo)->arena->Allocate(size);
+  } catch (const std::bad_alloc&) {
+  }
+  if (data == nullptr) {
+    // Outside the handler: the error exit longjmps.
+    MemoryError(cinfo, JERR_OUT_OF_MEMORY);
+  }
+  return data;
+}
+
+void* AllocSmall(j_common_ptr cinfo, int pool_id, size_t size) {
+  if (pool_id == JPOOL_PERMANENT) {
+    return CallSystem(cinfo, &jpeg_memory_mgr::alloc_small, pool_id, size);
+  }
+  return ArenaAllocate(cinfo, size);
+}
+
+void* AllocLarge(j_common_ptr cinfo, int pool_id, size_t size) {
+  if (pool_id == JPOOL_PERMANENT) {
+    return CallSystem(cinfo, &jpeg_memory_mgr::alloc_large, pool_id, size);
+  }
+  return ArenaAllocate(cinfo, size);
+}
+
+// One block for the row pointers and one for the rows, each row starting on
+// an alignment boundary and padded to a whole number of them, as libjpeg-turbo
+// expects of sample arrays.
+JSAMPARRAY AllocSarray(j_common_ptr cinfo, int pool_id,
+                       JDIMENSION samples_per_row, JDIMENSION row_count) {
+  if (pool_id == JPOOL_PERMANENT) {
+    return CallSystem(cinfo, &jpeg_memory_mgr::alloc_sarray, pool_id,
+                      samples_per_row, row_count);
+  }
+  const size_t row_bytes =
+      (samples_per_row * sizeof(JSAMPLE) + kTensorAlignment - 1) &
+      ~(kTensorAlignment - 1);
+  JSAMPARRAY rows = static_cast<JSAMPARRAY>(
+      ArenaAllocate(cinfo, row_count * sizeof(JSAMPROW)));
+  JSAMPLE* data =
+      static_cast<JSAMPLE*>(ArenaAllocate(cinfo, row_count * row_bytes));
+  for (JDIMENSION row = 0; row < row_count; ++row) {
+    rows[row] = data + row * row_bytes / sizeof(JSAMPLE);
+  }
+  return rows;
+}
+
+JBLOCKARRAY AllocBarray(j_common_ptr cinfo, int pool_id,
+                        JDIMENSION blocks_per_row, JDIMENSION row_count) {
+  if (pool_id == JPOOL_PERMANENT) {
+    return CallSystem(cinfo, &jpeg_memory_mgr::alloc_barray, pool_id,
+                      blocks_per_row, row_count);
+  }
+  JBLOCKARRAY rows = static_cast<JBLOCKARRAY>(
+      ArenaAllocate(cinfo, row_count * sizeof(JBLOCKROW)));
+  JBLOCK* data = static_cast<JBLOCK*>(
+      ArenaAllocate(cinfo, static_cast<size_t>(row_count) * blocks_per_row *
+                               sizeof(JBLOCK)));
+  for (JDIMENSION row = 0; row < row_count; ++row) {
+    rows[row] = data + static_cast<size_t>(row) * blocks_per_row;
+  }
+  return rows;
+}
+
+jvirt_sarray_ptr RequestVirtSarray(j_common_ptr cinfo, int pool_id,
+                                   boolean pre_zero, JDIMENSION samples_per_row,
+                                   JDIMENSION row_count,
+                                   JDIMENSION /*max_access*/) {
+  if (pool_id != JPOOL_IMAGE) {
+    MemoryError(cinfo, JERR_BAD_POOL_ID);
+  }
+  ImagePoolMemory* memory = MemoryOf(cinfo);
+  jvirt_sarray_control* array = static_cast<jvirt_sarray_control*>(
+      ArenaAllocate(cinfo, sizeof(jvirt_sarray_control)));
+  *array = {nullptr, samples_per_row, row_count, pre_zero != FALSE,
+            memory->sarrays};
+  memory->sarrays = array;
+  return array;
+}
+
+jvirt_barray_ptr RequestVirtBarray(j_common_ptr cinfo, int pool_id,
+                                   boolean pre_zero, JDIMENSION blocks_per_row,
+                                   JDIMENSION row_count,
+                                   JDIMENSION /*max_access*/) {
+  if (pool_id != JPOOL_IMAGE) {
+    MemoryError(cinfo, JERR_BAD_POOL_ID);
+  }
+  ImagePoolMemory* memory = MemoryOf(cinfo);
+  jvirt_barray_control* array = static_cast<jvirt_barray_control*>(
+      ArenaAllocate(cinfo, sizeof(jvirt_barray_control)));
+  *array = {nullptr, blocks_per_row, row_count, pre_zero != FALSE,
+            memory->barrays};
+  memory->barrays = array;
+  return array;
+}
+
+// Gives every requested virtual array its whole contents in memory. Arrays
+// requested pre-zeroed are cleared here rather than row by row on first
+// access.
+void RealizeVirtArrays(j_common_ptr cinfo) {
+  ImagePoolMemory* memory = MemoryOf(cinfo);
+  for (jvirt_sarray_control* array = memory->sarrays; array != nullptr;
+       array = array->next) {
+    array->rows = AllocSarray(cinfo, JPOOL_IMAGE, array->samples_per_row,
+                              array->row_count);
+    if (array->pre_zero) {
+      for (JDIMENSION row = 0; row < array->row_count; ++row) {
+        memset(array->rows[row], 0, array->samples_per_row * sizeof(JSAMPLE));
+      }
+    }
+  }
+  for (jvirt_barray_control* array = memory->barrays; array != nullptr;
+       array = array->next) {
+    array->rows = AllocBarray(cinfo, JPOOL_IMAGE, array->blocks_per_row,
+                              array->row_count);
+    if (array->pre_zero) {
+      memset(array->rows[0], 0,
+             static_cast<size_t>(array->row_count) * array->blocks_per_row *
+                 sizeof(JBLOCK));
+    }
+  }
+  memory->sarrays = nullptr;
+  memory->barrays = nullptr;
+}
+
+JSAMPARRAY AccessVirtSarray(j_common_ptr cinfo, jvirt_sarray_ptr array,
+                            JDIMENSION start_row, JDIMENSION row_count,
+                            boolean /*writable*/) {
+  if (array->rows == nullptr || start_row + row_count > array->row_count) {
+    MemoryError(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+  }
+  return array->rows + start_row;
+}
+
+JBLOCKARRAY AccessVirtBarray(j_common_ptr cinfo, jvirt_barray_ptr array,
+                             JDIMENSION start_row, JDIMENSION row_count,
+                             boolean /*writable*/) {
+  if (array->rows == nullptr || start_row + row_count > array->row_count) {
+    MemoryError(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+  }
+  return array->rows + start_row;
+}
+
+void FreePool(j_common_ptr cinfo, int pool_id) {
+  ImagePoolMemory* memory = MemoryOf(cinfo);
+  if (pool_id == JPOOL_PERMANENT) {
+    cinfo->mem = memory->system;
+    memory->system->free_pool(cinfo, pool_id);
+    cinfo->mem = &memory->base;
+    return;
+  }
+  memory->arena->Reset();
+  memory->sarrays = nullptr;
+  memory->barrays = nullptr;
+}
+
+// Hands the object back to libjpeg's manager, which frees the permanent pool
+// and itself. The arena belongs to the JpegDecoder.
+void SelfDestruct(j_common_ptr cinfo) {
+  jpeg_memory_mgr* system = MemoryOf(cinfo)->system;
+  cinfo->mem = system;
+  system->self_destruct(cinfo);
+}
+
+// Routes the image pool of |cinfo|, just created, to |arena| through
+// |memory|, which must outlive it.
+void InstallImagePoolMemory(j_common_ptr cinfo, TensorArena* arena,
+                            ImagePoolMemory* memory) {
+  memory->base = *cinfo->mem;
+  memory->base.alloc_small = AllocSmall;
+  memory->base.alloc_large = AllocLarge;
+  memory->base.alloc_sarray = AllocSarray;
+  memory->base.alloc_barray = AllocBarray;
+  memory->base.request_virt_sarray = RequestVirtSarray;
+  memory->base.request_virt_barray = RequestVirtBarray;
+  memory->base.realize_virt_arrays = RealizeVirtArrays;
+  memory->base.access_virt_sarray = AccessVirtSarray;
+  memory->base.access_virt_barray = AccessVirtBarray;
+  memory->base.free_pool = FreePool;
+  memory->base.self_destruct = SelfDestruct;
+  memory->system = cinfo->mem;
+  memory->arena = arena;
+  memory->sarrays = nullptr;
+  memory->barrays = nullptr;
+  cinfo->mem = &memory->base;
+}
+
+// Points |cinfo| at an in-memory JPEG. Older libjpeg releases take a non-const
+// buffer even though they never write to it.
+void SetMemorySource(j_decompress_ptr cinfo, const uint8_t* data, size_t size) {
+  jpeg_mem_src(cinfo, const_cast<unsigned char*>(data),
+               static_cast<unsigned long>(size));
+}
+
+// Decompresses the image whose header |cinfo| has read into |image|, which
+// has its dimensions, and finishes the decompression.
+void ReadRgbaScanlines(j_decompress_ptr cinfo, const RgbaImage& image) {
+#ifdef JCS_ALPHA_EXTENSIONS
+  cinfo->out_color_space = JCS_EXT_RGBA;
+#else
+  cinfo->out_color_space = JCS_RGB;
+#endif
+  jpeg_start_decompress(cinfo);
+
+  while (cinfo->output_scanline < cinfo->output_height) {
+    uint8_t* row = image.Row(cinfo->output_scanline);
+    JSAMPROW rows[] = {row};
+    jpeg_read_scanlines(cinfo, rows, 1);
+#ifndef JCS_ALPHA_EXTENSIONS
+    // Expand RGB to RGBA in place, back to front so no pixel is overwritten
+    // before it has been read.
+    for (int x = image.width - 1; x >= 0; --x) {
+      row[x * 4 + 3] = 255;
+      row[x * 4 + 2] = row[x * 3 + 2];
+      row[x * 4 + 1] = row[x * 3 + 1];
+      row[x * 4 + 0] = row[x * 3 + 0];
+    }
+#endif
+  }
+
+  jpeg_finish_decompress(cinfo);
+}
+
+}  // namespace
+
+bool ReadJpegSize(const uint8_t* data, size_t size, int* width, int* height) {
+  jpeg_decompress_struct cinfo;
+  ErrorManager errors;
+  cinfo.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = HandleError;
+  errors.base.output_message = SilenceMessage;
+  if (setjmp(errors.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_create_decompress(&cinfo);
+  SetMemorySource(&cinfo, data, size);
+  jpeg_read_header(&cinfo, TRUE);
+  *width = static_cast<int>(cinfo.image_width);
+  *height = static_cast<int>(cinfo.image_height);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+bool DecodeJpeg(const uint8_t* data, size_t size, const RgbaImage& image) {
+  jpeg_decompress_struct cinfo;
+  ErrorManager errors;
+  cinfo.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = HandleError;
+  errors.base.output_message = SilenceMessage;
+  if (setjmp(errors.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_create_decompress(&cinfo);
+  SetMemorySource(&cinfo, data, size);
+  jpeg_read_header(&cinfo, TRUE);
+  if (static_cast<int>(cinfo.image_width) != image.width ||
+      static_cast<int>(cinfo.image_height) != image.height) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  ReadRgbaScanlines(&cinfo, image);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+// Per-image working memory for a baseline 12 MP photo is about 150 KB. A
+// progressive one buffers every DCT coefficient, tens of MB, and the arena
+// grows to fit it.
+constexpr size_t kDecoderArenaBytes = 256 * 1024;
+
+struct JpegDecoder::State {
+  jpeg_decompress_struct cinfo;
+  ErrorManager errors;
+  TensorArena arena{kDecoderArenaBytes};
+  ImagePoolMemory memory;
+  bool created = false;
+  bool header_read = false;
+};
+
+JpegDecoder::JpegDecoder() : state_(new State) {
+  State& state = *state_;
+  state.cinfo.err = jpeg_std_error(&state.errors.base);
+  state.errors.base.error_exit = HandleError;
+  state.errors.base.output_message = SilenceMessage;
+  if (setjmp(state.errors.jump)) {
+    return;
+  }
+  jpeg_create_decompress(&state.cinfo);
+  InstallImagePoolMemory(reinterpret_cast<j_common_ptr>(&state.cinfo),
+                         &state.arena, &state.memory);
+  state.created = true;
+}
+
+JpegDecoder::~JpegDecoder() {
+  if (state_->created) {
+    jpeg_destroy_decompress(&state_->cinfo);
+  }
+}
+
+const ArenaStats& JpegDecoder::memory_stats() const {
+  return state_->arena.stats();
+}
+
+bool JpegDecoder::ReadHeader(const uint8_t* data, size_t size) {
+  State& state = *state_;
+  state.header_read = false;
+  if (!state.created) {
+    return false;
+  }
+  if (setjmp(state.errors.jump)) {
+    // An error inside a call forwarded to libjpeg's manager leaves it
+    // installed.
+    state.cinfo.mem = &state.memory.base;
+    jpeg_abort_decompress(&state.cinfo);
+    return false;
+  }
+  // Returns the decompressor to its initial state whatever the previous image
+  // left it in, releasing that image's working memory.
+  jpeg_abort_decompress(&state.cinfo);
+  SetMemorySource(&state.cinfo, data, size);
+  jpeg_read_header(&state.cinfo, TRUE);
+  width_ = static_cast<int>(state.cinfo.image_width);
+  height_ = static_cast<int>(state.cinfo.image_height);
+  state.header_read = true;
+  return true;
+}
+
+bool JpegDecoder::Decode(const RgbaImage& image) {
+  State& state = *state_;
+  if (!state.header_read || image.width != width_ ||
+      image.height != height_) {
+    return false;
+  }
+  state.header_read = false;
+  if (setjmp(state.errors.jump)) {
+    // An error inside a call forwarded to libjpeg's manager leaves it
+    // installed.
+    state.cinfo.mem = &state.memory.base;
+    jpeg_abort_decompress(&state.cinfo);
+    return false;
+  }
+  ReadRgbaScanlines(&state.cinfo, image);
+  return true;
+}
+
+bool DecodeJpegLuma(const uint8_t* data, size_t size, int scale_denom,
+                    std::vector<uint8_t>* luma, int* width, int* height) {
+  jpeg_decompress_struct cinfo;
+  ErrorManager errors;
+  cinfo.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = HandleError;
+  errors.base.output_message = SilenceMessage;
+  if (setjmp(errors.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_create_decompress(&cinfo);
+  SetMemorySource(&cinfo, data, size);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_GRAYSCALE;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale_denom;
+  cinfo.dct_method = JDCT_IFAST;
+  cinfo.do_fancy_upsampling = FALSE;
+  jpeg_start_decompress(&cinfo);
+
+  *width = static_cast<int>(cinfo.output_width);
+  *height = static_cast<int>(cinfo.output_height);
+  luma->resize(static_cast<size_t>(*width) * *height);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW rows[] = {luma->data() +
+                       static_cast<size_t>(cinfo.output_scanline) * *width};
+    jpeg_read_scanlines(&cinfo, rows, 1);
+  }
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+bool EncodeJpeg(const RgbaImage& image, int quality, std::vector<uint8_t>* out) {
+  out->clear();
+  if (image.pixels == nullptr || image.width <= 0 || image.height <= 0) {
+    return false;
+  }
+
+#ifndef JCS_ALPHA_EXTENSIONS
+  // Plain libjpeg cannot read RGBA; repack one row at a time.
+  std::vector<uint8_t> rgb_row(static_cast<size_t>(image.width) * 3);
+#endif
+
+  jpeg_compress_struct cinfo;
+  ErrorManager errors;
+  cinfo.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = HandleError;
+  errors.base.output_message = SilenceMessage;
+  if (setjmp(errors.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    out->clear();
+    return false;
+  }
+  jpeg_create_compress(&cinfo);
+
+  VectorDestination dest;
+  dest.base.init_destination = InitDestination;
+  dest.base.empty_output_buffer = EmptyOutputBuffer;
+  dest.base.term_destination = TermDestination;
+  dest.out = out;
+  cinfo.dest = &dest.base;
+
+  cinfo.image_width = image.width;
+  cinfo.image_height = image.height;
+#ifdef JCS_ALPHA_EXTENSIONS
+  cinfo.input_components = 4;
+  cinfo.in_color_space = JCS_EXT_RGBA;
+#else
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+#endif
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while (cinfo.next_scanline < cinfo.image_height) {
+    uint8_t* row = image.Row(cinfo.next_scanline);
+#ifndef JCS_ALPHA_EXTENSIONS
+    for (int x = 0; x < image.width; ++x) {
+      rgb_row[x * 3 + 0] = row[x * 4 + 0];
+      rgb_row[x * 3 + 1] = row[x * 4 + 1];
+      rgb_row[x * 3 + 2] = row[x * 4 + 2];
+    }
+    row = rgb_row.data();
+#endif
+    JSAMPROW rows[] = {row};
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return true;
+}
@@ -0,0 +1,78 @@
+#ifndef NATIVE_JPEG_CODEC_H_
+#define NATIVE_JPEG_CODEC_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "native/image_types.h"
+#include "native/tensor_arena.h"
+
+// Reads the dimensions of the JPEG in |data| without decoding it. Returns
+// false if |data| is not a JPEG libjpeg can parse.
+bool ReadJpegSize(const uint8_t* data, size_t size, int* width, int* height);
+
+// Decodes the JPEG in |data| into |image|, which must already have the
+// dimensions reported by ReadJpegSize. Rows are decompressed straight into
+// |image|, so the caller controls where the pixels live.
+//
+// Returns false if libjpeg reports an error or the dimensions do not match.
+bool DecodeJpeg(const uint8_t* data, size_t size, const RgbaImage& image);
+
+// Decodes a sequence of JPEGs with one libjpeg decompressor. ReadJpegSize and
+// DecodeJpeg each create and destroy a decompressor and parse the header
+// again; a JpegDecoder parses each header once and keeps the decompressor's
+// permanent state across images. libjpeg's per-image working memory comes
+// from a TensorArena reset between images, so once the arena has grown to fit
+// the largest image decoding makes no heap allocations. Not thread-safe.
+class JpegDecoder {
+ public:
+  JpegDecoder();
+  ~JpegDecoder();
+
+  JpegDecoder(const JpegDecoder&) = delete;
+  JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+  // Reads the header of the JPEG in |data|, which must stay valid until the
+  // matching Decode. Returns false if it is not a JPEG libjpeg can parse.
+  bool ReadHeader(const uint8_t* data, size_t size);
+
+  // Dimensions from the last successful ReadHeader.
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // The arena holding libjpeg's per-image working memory.
+  const ArenaStats& memory_stats() const;
+
+  // Decodes the image whose header was just read into |image|, which must
+  // have its dimensions. As DecodeJpeg otherwise.
+  bool Decode(const RgbaImage& image);
+
+ private:
+  // The libjpeg state, kept out of this header so its includers do not see
+  // jpeglib.h.
+  struct State;
+
+  std::unique_ptr<State> state_;
+  int width_ = 0;
+  int height_ = 0;
+};
+
+// Decodes only the luma of the JPEG in |data| at 1/|scale_denom| of its size
+// (1, 2, 4 or 8) into |luma|, one byte per pixel with rows |*width| bytes
+// apart. libjpeg scales in the DCT domain and skips the chroma planes, so this
+// is several times cheaper than DecodeJpeg and suits motion and scene-change
+// checks. |luma| keeps its capacity between calls.
+bool DecodeJpegLuma(const uint8_t* data, size_t size, int scale_denom,
+                    std::vector<uint8_t>* luma, int* width, int* height);
+
+// Encodes |image| as a baseline JPEG at |quality| (1-100) into |out|,
+// replacing its contents. Scanlines are fed to the encoder straight from
+// |image| and compressed bytes are written straight into |out|, so there is no
+// intermediate copy of either. |out| keeps its capacity between calls; reusing
+// the same vector avoids reallocation once it has grown to fit.
+//
+// Returns false if libjpeg reports an error, in which case |out| is empty.
+bool EncodeJpeg(const RgbaImage& image, int quality, std::vector<uint8_t>* out);
+
+#endif  // NATIVE_JPEG_CODEC_H_
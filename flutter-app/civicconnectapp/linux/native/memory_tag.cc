@@ -0,0 +1,28 @@
+#include "native/memory_tag.h"
+
+#include <dlfcn.h>
+
+namespace {
+
+using SetTagFunction = const char* (*)(const char*);
+
+// The tracer's civic_memtrace_set_tag(), or null when it is not loaded.
+SetTagFunction SetTag() {
+  static const SetTagFunction set_tag = reinterpret_cast<SetTagFunction>(
+      dlsym(RTLD_DEFAULT, "civic_memtrace_set_tag"));
+  return set_tag;
+}
+
+}  // namespace
+
+MemoryTagScope::MemoryTagScope(const char* tag) : previous_(nullptr) {
+  if (SetTagFunction set_tag = SetTag()) {
+    previous_ = set_tag(tag);
+  }
+}
+
+MemoryTagScope::~MemoryTagScope() {
+  if (SetTagFunction set_tag = SetTag()) {
+    set_tag(previous_);
+  }
+}
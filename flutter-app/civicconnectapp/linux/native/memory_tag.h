@@ -0,0 +1,23 @@
+#ifndef NATIVE_MEMORY_TAG_H_
+#define NATIVE_MEMORY_TAG_H_
+
+// Attributes heap allocations made by the current thread to |tag| in memtrace
+// snapshots for the lifetime of the scope, e.g.
+//
+//   MemoryTagScope tag("detection");
+//
+// Does nothing unless the runner was started with the allocation tracer; see
+// native/memtrace.h. |tag| must have static storage duration. Scopes nest.
+class MemoryTagScope {
+ public:
+  explicit MemoryTagScope(const char* tag);
+  ~MemoryTagScope();
+
+  MemoryTagScope(const MemoryTagScope&) = delete;
+  MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+ private:
+  const char* previous_;
+};
+
+#endif  // NATIVE_MEMORY_TAG_H_
@@ -0,0 +1,855 @@
+// The allocation tracer preloaded by the runner; see native/memtrace.h.
+//
+// Everything on the allocation path avoids the heap: tables are mmapped once
+// at load time, per-thread state lives in initial-exec TLS and locks are
+// spinlocks. Only sampled allocations take a lock or capture a stack; the
+// common path adds a usable-size lookup and a thread-local counter update.
+
+#include "native/memtrace.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void __libc_free(void* ptr);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+constexpr size_t kDefaultSampleInterval = 512 * 1024;
+constexpr int kDefaultSnapshotSeconds = 60;
+
+// Call stack depth kept per site, and frames of the tracer itself at the top
+// of every captured stack (RecordSample and the interposed function).
+constexpr int kSiteFrames = 8;
+constexpr int kTracerFrames = 2;
+
+constexpr uint32_t kMaxSites = 1 << 14;
+constexpr uint32_t kSiteIndexSize = kMaxSites * 2;
+// Site 0 collects samples once the site table is full.
+constexpr uint32_t kOverflowSite = 0;
+
+constexpr int kShards = 64;
+constexpr uint32_t kShardSlots = 1 << 13;
+// Counting filter in front of the sample table, so that frees of unsampled
+// blocks, nearly all of them, take no lock.
+constexpr uint32_t kFilterSize = 1 << 16;
+
+// Thread-local byte counts are published once this much has accumulated.
+constexpr int64_t kFlushBytes = 256 * 1024;
+
+constexpr int kMaxSitesPerSnapshot = 500;
+
+class SpinLock {
+ public:
+  void Lock() {
+    while (flag_.test_and_set(std::memory_order_acquire)) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+  }
+  void Unlock() { flag_.clear(std::memory_order_release); }
+
+ private:
+  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+struct Site {
+  uint64_t key;
+  const char* tag;
+  int depth;
+  void* frames[kSiteFrames];
+  std::atomic<int64_t> live_bytes;
+  std::atomic<int64_t> live_count;
+  std::atomic<int64_t> total_bytes;
+};
+
+struct Sample {
+  uintptr_t address;  // 0 for an empty slot.
+  uint32_t site;
+  int64_t weight;
+};
+
+struct Shard {
+  SpinLock lock;
+  Sample* slots;
+};
+
+struct ThreadState {
+  bool in_tracer;
+  // Whether the thread exit flush is registered; see RegisterThread.
+  bool registered;
+  int64_t bytes_until_sample;
+  uint64_t random;
+  int64_t pending_allocated;
+  int64_t pending_freed;
+  const char* tag;
+};
+
+__thread ThreadState t_state __attribute__((tls_model("initial-exec")));
+
+std::atomic<bool> g_enabled(false);
+size_t g_sample_interval = kDefaultSampleInterval;
+
+std::atomic<int64_t> g_allocated_bytes(0);
+std::atomic<int64_t> g_freed_bytes(0);
+std::atomic<int64_t> g_peak_live_bytes(0);
+std::atomic<int64_t> g_dropped_samples(0);
+
+Site* g_sites = nullptr;
+std::atomic<uint32_t> g_site_count(0);
+uint32_t* g_site_index = nullptr;
+SpinLock g_site_lock;
+
+Shard g_shards[kShards];
+std::atomic<uint16_t>* g_filter = nullptr;
+
+// Flushes a thread's pending counts when it exits.
+pthread_key_t g_thread_key;
+
+char g_directory[512];
+int g_snapshot_seconds = kDefaultSnapshotSeconds;
+std::atomic<int> g_snapshot_number(0);
+pthread_mutex_t g_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::atomic<bool> g_stopping(false);
+
+void* MapZeroed(size_t size) {
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+inline uint64_t Mix(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+// Draws the bytes until the next sample from an exponential distribution, so
+// that every allocated byte is equally likely to be sampled.
+int64_t NextSampleDistance(ThreadState* state) {
+  if (state->random == 0) {
+    state->random = Mix(reinterpret_cast<uintptr_t>(state) ^
+                        static_cast<uint64_t>(time(nullptr)));
+  }
+  state->random ^= state->random << 13;
+  state->random ^= state->random >> 7;
+  state->random ^= state->random << 17;
+  const double uniform =
+      (static_cast<double>(state->random >> 11) + 0.5) / 9007199254740992.0;
+  return static_cast<int64_t>(-std::log(uniform) * g_sample_interval) + 1;
+}
+
+// Publishes the thread's pending byte counts. The peak is only observed here,
+// so it is a sample: a spike shorter than kFlushBytes per thread between two
+// flushes can be missed by up to that much.
+void FlushCounts(ThreadState* state) {
+  const int64_t allocated =
+      g_allocated_bytes.fetch_add(state->pending_allocated,
+                                  std::memory_order_relaxed) +
+      state->pending_allocated;
+  const int64_t freed =
+      g_freed_bytes.fetch_add(state->pending_freed, std::memory_order_relaxed) +
+      state->pending_freed;
+  state->pending_allocated = 0;
+  state->pending_freed = 0;
+  const int64_t live = allocated - freed;
+  int64_t peak = g_peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !g_peak_live_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+void FlushThreadOnExit(void* value) {
+  ThreadState* state = static_cast<ThreadState*>(value);
+  FlushCounts(state);
+  // Frees by later destructors register again, and glibc calls this again.
+  state->registered = false;
+}
+
+// Has the thread's counts flushed when it exits, which would otherwise lose up
+// to kFlushBytes of allocations or frees per thread.
+void RegisterThread(ThreadState* state) {
+  state->registered = true;
+  // pthread_setspecific may allocate the thread's key block; that allocation
+  // is counted but not sampled.
+  const bool in_tracer = state->in_tracer;
+  state->in_tracer = true;
+  pthread_setspecific(g_thread_key, state);
+  state->in_tracer = in_tracer;
+}
+
+uint32_t FindOrAddSite(void* const* frames, int depth, const char* tag) {
+  uint64_t key = Mix(reinterpret_cast<uintptr_t>(tag));
+  for (int i = 0; i < depth; ++i) {
+    key = Mix(key ^ reinterpret_cast<uintptr_t>(frames[i]));
+  }
+  key |= 1;
+
+  g_site_lock.Lock();
+  uint32_t slot = static_cast<uint32_t>(key) & (kSiteIndexSize - 1);
+  uint32_t site = kOverflowSite;
+  while (true) {
+    const uint32_t index = g_site_index[slot];
+    if (index == 0) {
+      const uint32_t count = g_site_count.load(std::memory_order_relaxed);
+      if (count < kMaxSites) {
+        Site& added = g_sites[count];
+        added.key = key;
+        added.tag = tag;
+        added.depth = depth;
+        memcpy(added.frames, frames, depth * sizeof(void*));
+        g_site_index[slot] = count + 1;
+        g_site_count.store(count + 1, std::memory_order_release);
+        site = count;
+      }
+      break;
+    }
+    if (g_sites[index - 1].key == key) {
+      site = index - 1;
+      break;
+    }
+    slot = (slot + 1) & (kSiteIndexSize - 1);
+  }
+  g_site_lock.Unlock();
+  return site;
+}
+
+__attribute__((noinline)) void RecordSample(void* ptr, size_t size,
+                                            ThreadState* state) {
+  state->bytes_until_sample = NextSampleDistance(state);
+
+  void* stack[kSiteFrames + kTracerFrames];
+  const int captured = backtrace(stack, kSiteFrames + kTracerFrames);
+  const int depth = std::max(captured - kTracerFrames, 0);
+  const uint32_t site =
+      FindOrAddSite(stack + kTracerFrames, depth, state->tag);
+
+  // Each sample stands for the bytes of all the allocations it was drawn
+  // from: size divided by its probability of being sampled.
+  const double probability =
+      1.0 - std::exp(-static_cast<double>(size) / g_sample_interval);
+  const int64_t weight = static_cast<int64_t>(size / probability);
+
+  const uint64_t hash = Mix(reinterpret_cast<uintptr_t>(ptr));
+  Shard& shard = g_shards[hash % kShards];
+  shard.lock.Lock();
+  uint32_t slot = static_cast<uint32_t>(hash >> 32) & (kShardSlots - 1);
+  bool stored = false;
+  for (uint32_t probe = 0; probe < kShardSlots / 2; ++probe) {
+    Sample& sample = shard.slots[slot];
+    if (sample.address == 0) {
+      sample = Sample{reinterpret_cast<uintptr_t>(ptr), site, weight};
+      stored = true;
+      break;
+    }
+    slot = (slot + 1) & (kShardSlots - 1);
+  }
+  if (stored) {
+    g_filter[hash & (kFilterSize - 1)].fetch_add(1, std::memory_order_relaxed);
+  }
+  shard.lock.Unlock();
+
+  if (!stored) {
+    g_dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Site& entry = g_sites[site];
+  entry.live_bytes.fetch_add(weight, std::memory_order_relaxed);
+  entry.live_count.fetch_add(1, std::memory_order_relaxed);
+  entry.total_bytes.fetch_add(weight, std::memory_order_relaxed);
+}
+
+void RemoveSample(void* ptr) {
+  const uint64_t hash = Mix(reinterpret_cast<uintptr_t>(ptr));
+  std::atomic<uint16_t>& filter = g_filter[hash & (kFilterSize - 1)];
+  if (filter.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  Shard& shard = g_shards[hash % kShards];
+  shard.lock.Lock();
+  uint32_t slot = static_cast<uint32_t>(hash >> 32) & (kShardSlots - 1);
+  Sample removed = {};
+  for (uint32_t probe = 0; probe < kShardSlots / 2; ++probe) {
+    const Sample& sample = shard.slots[slot];
+    if (sample.address == 0) {
+      break;
+    }
+    if (sample.address == reinterpret_cast<uintptr_t>(ptr)) {
+      removed = sample;
+      break;
+    }
+    slot = (slot + 1) & (kShardSlots - 1);
+  }
+  if (removed.address != 0) {
+    filter.fetch_sub(1, std::memory_order_relaxed);
+    // Backward-shift deletion keeps probe sequences intact without
+    // tombstones.
+    uint32_t hole = slot;
+    uint32_t next = (slot + 1) & (kShardSlots - 1);
+    while (shard.slots[next].address != 0) {
+      const uint32_t home =
+          static_cast<uint32_t>(Mix(shard.slots[next].address) >> 32) &
+          (kShardSlots - 1);
+      // Move the entry back unless its home lies cyclically in (hole, next].
+      const bool stays = hole <= next ? (hole < home && home <= next)
+                                      : (hole < home || home <= next);
+      if (!stays) {
+        shard.slots[hole] = shard.slots[next];
+        hole = next;
+      }
+      next = (next + 1) & (kShardSlots - 1);
+    }
+    shard.slots[hole].address = 0;
+  }
+  shard.lock.Unlock();
+
+  if (removed.address != 0) {
+    Site& site = g_sites[removed.site];
+    site.live_bytes.fetch_sub(removed.weight, std::memory_order_relaxed);
+    site.live_count.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+inline void OnAllocate(void* ptr) {
+  if (ptr == nullptr || !g_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  ThreadState* state = &t_state;
+  if (!state->registered) {
+    RegisterThread(state);
+  }
+  // The tracer's own allocations are counted like any other, as their frees
+  // are, but never sampled.
+  const size_t size = malloc_usable_size(ptr);
+  state->pending_allocated += size;
+  if (state->pending_allocated >= kFlushBytes) {
+    FlushCounts(state);
+  }
+  if (state->in_tracer) {
+    return;
+  }
+  state->bytes_until_sample -= size;
+  if (state->bytes_until_sample > 0) {
+    return;
+  }
+  state->in_tracer = true;
+  RecordSample(ptr, size, state);
+  state->in_tracer = false;
+}
+
+inline void OnFree(void* ptr) {
+  if (ptr == nullptr || !g_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  ThreadState* state = &t_state;
+  if (!state->registered) {
+    RegisterThread(state);
+  }
+  state->pending_freed += malloc_usable_size(ptr);
+  if (state->pending_freed >= kFlushBytes) {
+    FlushCounts(state);
+  }
+  RemoveSample(ptr);
+}
+
+// --- Snapshots ---------------------------------------------------------------
+
+struct MemoryStatus {
+  int64_t rss_kb = 0;
+  int64_t pss_kb = 0;
+  int64_t anonymous_kb = 0;
+  int64_t private_dirty_kb = 0;
+  int64_t swap_kb = 0;
+  int64_t peak_rss_kb = 0;
+};
+
+// Reads "<name>: <value> kB" fields of a /proc file into |fields|.
+void ReadProcFields(const char* path, const char* const* names,
+                    int64_t* const* fields, int count) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  char buffer[4096];
+  const ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return;
+  }
+  buffer[length] = '\0';
+  for (char* line = buffer; line != nullptr && *line != '\0';) {
+    char* end = strchr(line, '\n');
+    for (int i = 0; i < count; ++i) {
+      const size_t name_length = strlen(names[i]);
+      if (strncmp(line, names[i], name_length) == 0 &&
+          line[name_length] == ':') {
+        *fields[i] = strtoll(line + name_length + 1, nullptr, 10);
+      }
+    }
+    line = end != nullptr ? end + 1 : nullptr;
+  }
+}
+
+MemoryStatus ReadMemoryStatus() {
+  MemoryStatus status;
+  const char* const rollup_names[] = {"Rss", "Pss", "Anonymous",
+                                      "Private_Dirty", "Swap"};
+  int64_t* const rollup_fields[] = {&status.rss_kb, &status.pss_kb,
+                                    &status.anonymous_kb,
+                                    &status.private_dirty_kb, &status.swap_kb};
+  ReadProcFields("/proc/self/smaps_rollup", rollup_names, rollup_fields, 5);
+  // Kernels before 4.14 have no smaps_rollup; keep at least RSS.
+  const char* const status_names[] = {"VmHWM", "VmRSS"};
+  int64_t vm_rss_kb = 0;
+  int64_t* const status_fields[] = {&status.peak_rss_kb, &vm_rss_kb};
+  ReadProcFields("/proc/self/status", status_names, status_fields, 2);
+  if (status.rss_kb == 0) {
+    status.rss_kb = vm_rss_kb;
+  }
+  return status;
+}
+
+const char* BaseName(const char* path) {
+  const char* slash = strrchr(path, '/');
+  return slash != nullptr ? slash + 1 : path;
+}
+
+bool StartsWith(const char* text, const char* prefix) {
+  return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+// Libraries that allocate on behalf of their callers, so attribution skips
+// past them.
+bool IsAllocatorModule(const char* name) {
+  static const char* const kModules[] = {
+      "libc.so",         "libstdc++.so", "libglib-2.0.so",
+      "libgobject-2.0.so", "ld-linux",   "libcivicconnect_memtrace.so"};
+  for (const char* module : kModules) {
+    if (StartsWith(name, module)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Addresses of the main executable's loaded segments.
+struct AddressRange {
+  uintptr_t start = 0;
+  uintptr_t end = 0;
+
+  bool Contains(const void* address) const {
+    const uintptr_t value = reinterpret_cast<uintptr_t>(address);
+    return value >= start && value < end;
+  }
+};
+
+int FindMainExecutable(struct dl_phdr_info* info, size_t, void* data) {
+  AddressRange* range = static_cast<AddressRange*>(data);
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& header = info->dlpi_phdr[i];
+    if (header.p_type != PT_LOAD) {
+      continue;
+    }
+    const uintptr_t start = info->dlpi_addr + header.p_vaddr;
+    const uintptr_t end = start + header.p_memsz;
+    if (range->end == 0) {
+      range->start = start;
+      range->end = end;
+    } else {
+      range->start = std::min(range->start, start);
+      range->end = std::max(range->end, end);
+    }
+  }
+  // The main executable is always reported first.
+  return 1;
+}
+
+// Frames are matched to the executable by address: the path dladdr reports
+// for it is argv[0], which may be relative or a symlink.
+AddressRange MainExecutableRange() {
+  AddressRange range;
+  dl_iterate_phdr(FindMainExecutable, &range);
+  return range;
+}
+
+// Maps the library a frame belongs to onto the subsystem it is part of.
+std::string SubsystemForModule(const char* path) {
+  const char* name = BaseName(path);
+  if (StartsWith(name, "libflutter")) {
+    return "flutter";
+  }
+  if (StartsWith(name, "libapp.so")) {
+    return "dart";
+  }
+  static const char* const kToolkit[] = {
+      "libgtk",      "libgdk",     "libgio",      "libcairo", "libpango",
+      "libharfbuzz", "libfreetype", "libfontconfig", "libX",   "libxcb",
+      "libwayland",  "libatk",     "libepoxy"};
+  for (const char* prefix : kToolkit) {
+    if (StartsWith(name, prefix)) {
+      return "gtk";
+    }
+  }
+  static const char* const kGpu[] = {"libEGL", "libGL", "libgbm", "libdrm",
+                                     "libnvidia", "libvulkan"};
+  for (const char* prefix : kGpu) {
+    if (StartsWith(name, prefix)) {
+      return "gpu";
+    }
+  }
+  if (strstr(path, "/dri/") != nullptr) {
+    return "gpu";
+  }
+  // Plugins registered in generated_plugin_registrant.cc are bundled as
+  // lib<plugin>_plugin.so.
+  const char* plugin = strstr(name, "_plugin.so");
+  if (StartsWith(name, "lib") && plugin != nullptr) {
+    return "plugin:" + std::string(name + 3, plugin);
+  }
+  std::string module(name);
+  const size_t so = module.find(".so");
+  return so == std::string::npos ? module : module.substr(0, so);
+}
+
+std::string SiteSubsystem(const Site& site, const AddressRange& executable) {
+  if (site.tag != nullptr) {
+    return site.tag;
+  }
+  for (int i = 0; i < site.depth; ++i) {
+    if (executable.Contains(site.frames[i])) {
+      return "runner";
+    }
+    Dl_info info;
+    if (dladdr(site.frames[i], &info) == 0 || info.dli_fname == nullptr) {
+      continue;
+    }
+    if (!IsAllocatorModule(BaseName(info.dli_fname))) {
+      return SubsystemForModule(info.dli_fname);
+    }
+  }
+  return "libc";
+}
+
+// Frames as module+offset, which stay the same across runs despite ASLR.
+std::string SiteFrames(const Site& site) {
+  std::string frames;
+  for (int i = 0; i < site.depth; ++i) {
+    if (i != 0) {
+      frames.push_back(';');
+    }
+    Dl_info info;
+    char frame[256];
+    if (dladdr(site.frames[i], &info) != 0 && info.dli_fname != nullptr) {
+      const uintptr_t offset = reinterpret_cast<uintptr_t>(site.frames[i]) -
+                               reinterpret_cast<uintptr_t>(info.dli_fbase);
+      snprintf(frame, sizeof(frame), "%s+0x%" PRIxPTR "%s%s",
+               BaseName(info.dli_fname), offset,
+               info.dli_sname != nullptr ? ":" : "",
+               info.dli_sname != nullptr ? info.dli_sname : "");
+    } else {
+      snprintf(frame, sizeof(frame), "%p", site.frames[i]);
+    }
+    frames.append(frame);
+  }
+  return frames;
+}
+
+int WriteSnapshot() {
+  if (!g_enabled.load() || g_directory[0] == '\0') {
+    return -1;
+  }
+  pthread_mutex_lock(&g_snapshot_mutex);
+  // The tracer's own allocations here are ordinary, traced allocations.
+  FlushCounts(&t_state);
+
+  const AddressRange executable = MainExecutableRange();
+
+  struct SiteSummary {
+    uint32_t index;
+    int64_t live_bytes;
+    std::string subsystem;
+  };
+  std::vector<SiteSummary> sites;
+  std::vector<std::pair<std::string, int64_t>> subsystems;
+  const uint32_t count = g_site_count.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; ++i) {
+    const int64_t live = g_sites[i].live_bytes.load(std::memory_order_relaxed);
+    if (live <= 0) {
+      continue;
+    }
+    SiteSummary summary{i, live, SiteSubsystem(g_sites[i], executable)};
+    auto it = std::find_if(
+        subsystems.begin(), subsystems.end(),
+        [&summary](const std::pair<std::string, int64_t>& entry) {
+          return entry.first == summary.subsystem;
+        });
+    if (it == subsystems.end()) {
+      subsystems.emplace_back(summary.subsystem, live);
+    } else {
+      it->second += live;
+    }
+    sites.push_back(std::move(summary));
+  }
+  std::sort(sites.begin(), sites.end(),
+            [](const SiteSummary& a, const SiteSummary& b) {
+              return a.live_bytes > b.live_bytes;
+            });
+  std::sort(subsystems.begin(), subsystems.end());
+
+  const int number = g_snapshot_number.fetch_add(1);
+  char path[600];
+  snprintf(path, sizeof(path), "%s/memtrace-%d-%04d.txt", g_directory,
+           static_cast<int>(getpid()), number);
+  FILE* file = fopen(path, "we");
+  if (file == nullptr) {
+    pthread_mutex_unlock(&g_snapshot_mutex);
+    return -1;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  const MemoryStatus status = ReadMemoryStatus();
+  const int64_t allocated = g_allocated_bytes.load();
+  const int64_t freed = g_freed_bytes.load();
+  fprintf(file, "memtrace 1\n");
+  fprintf(file, "pid %d\n", static_cast<int>(getpid()));
+  fprintf(file, "time_ms %" PRId64 "\n",
+          static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+  fprintf(file, "sample_interval %zu\n", g_sample_interval);
+  fprintf(file,
+          "smaps rss_kb %" PRId64 " pss_kb %" PRId64 " anonymous_kb %" PRId64
+          " private_dirty_kb %" PRId64 " swap_kb %" PRId64
+          " peak_rss_kb %" PRId64 "\n",
+          status.rss_kb, status.pss_kb, status.anonymous_kb,
+          status.private_dirty_kb, status.swap_kb, status.peak_rss_kb);
+  fprintf(file,
+          "heap live_bytes %" PRId64 " peak_live_bytes %" PRId64
+          " allocated_bytes %" PRId64 " freed_bytes %" PRId64
+          " dropped_samples %" PRId64 "\n",
+          allocated - freed, g_peak_live_bytes.load(), allocated, freed,
+          g_dropped_samples.load());
+  for (const auto& subsystem : subsystems) {
+    fprintf(file, "tag %s %" PRId64 "\n", subsystem.first.c_str(),
+            subsystem.second);
+  }
+  const size_t written =
+      std::min<size_t>(sites.size(), kMaxSitesPerSnapshot);
+  for (size_t i = 0; i < written; ++i) {
+    const Site& site = g_sites[sites[i].index];
+    fprintf(file, "site %016" PRIx64 " %" PRId64 " %" PRId64 " %s %s\n",
+            site.key, sites[i].live_bytes,
+            site.live_count.load(std::memory_order_relaxed),
+            sites[i].subsystem.c_str(), SiteFrames(site).c_str());
+  }
+  const bool ok = fclose(file) == 0;
+  pthread_mutex_unlock(&g_snapshot_mutex);
+  return ok ? 0 : -1;
+}
+
+void* RunSnapshots(void*) {
+  int elapsed = 0;
+  while (!g_stopping.load()) {
+    sleep(1);
+    if (++elapsed >= g_snapshot_seconds) {
+      elapsed = 0;
+      WriteSnapshot();
+    }
+  }
+  return nullptr;
+}
+
+bool MakeDirectories(const char* path) {
+  char partial[sizeof(g_directory)];
+  for (size_t i = 1; path[i - 1] != '\0'; ++i) {
+    if (path[i] == '/' || path[i] == '\0') {
+      memcpy(partial, path, i);
+      partial[i] = '\0';
+      if (mkdir(partial, 0700) != 0 && errno != EEXIST) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+__attribute__((constructor)) void StartTracer() {
+  const char* setting = getenv("CIVICCONNECT_MEMTRACE");
+  if (setting == nullptr || setting[0] == '\0') {
+    return;
+  }
+  if (setting[0] == '/') {
+    snprintf(g_directory, sizeof(g_directory), "%s", setting);
+  } else {
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cache != nullptr && cache[0] == '/') {
+      snprintf(g_directory, sizeof(g_directory), "%s/civicconnect/memtrace",
+               cache);
+    } else if (home != nullptr) {
+      snprintf(g_directory, sizeof(g_directory),
+               "%s/.cache/civicconnect/memtrace", home);
+    } else {
+      snprintf(g_directory, sizeof(g_directory), "/tmp/civicconnect-memtrace");
+    }
+  }
+  if (const char* bytes = getenv("CIVICCONNECT_MEMTRACE_SAMPLE_BYTES")) {
+    g_sample_interval = std::max<size_t>(strtoull(bytes, nullptr, 10), 1);
+  }
+  if (const char* seconds = getenv("CIVICCONNECT_MEMTRACE_INTERVAL")) {
+    g_snapshot_seconds = std::max(atoi(seconds), 1);
+  }
+  if (!MakeDirectories(g_directory)) {
+    fprintf(stderr, "memtrace: cannot create %s\n", g_directory);
+    return;
+  }
+
+  g_sites = static_cast<Site*>(MapZeroed(sizeof(Site) * kMaxSites));
+  g_site_index =
+      static_cast<uint32_t*>(MapZeroed(sizeof(uint32_t) * kSiteIndexSize));
+  g_filter = static_cast<std::atomic<uint16_t>*>(
+      MapZeroed(sizeof(std::atomic<uint16_t>) * kFilterSize));
+  Sample* slots =
+      static_cast<Sample*>(MapZeroed(sizeof(Sample) * kShards * kShardSlots));
+  if (g_sites == nullptr || g_site_index == nullptr || g_filter == nullptr ||
+      slots == nullptr) {
+    fprintf(stderr, "memtrace: cannot map tables\n");
+    return;
+  }
+  for (int i = 0; i < kShards; ++i) {
+    g_shards[i].slots = slots + static_cast<size_t>(i) * kShardSlots;
+  }
+  g_sites[kOverflowSite].key = 1;
+  g_sites[kOverflowSite].tag = "overflow";
+  g_site_count.store(1);
+  if (pthread_key_create(&g_thread_key, FlushThreadOnExit) != 0) {
+    fprintf(stderr, "memtrace: cannot create thread key\n");
+    return;
+  }
+
+  // The first backtrace() loads libgcc_s, which allocates; do it before
+  // allocations are traced.
+  void* warmup[1];
+  backtrace(warmup, 1);
+
+  t_state.in_tracer = true;
+  g_enabled.store(true);
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, RunSnapshots, nullptr) == 0) {
+    pthread_detach(thread);
+  }
+  t_state.in_tracer = false;
+  fprintf(stderr, "memtrace: writing snapshots to %s every %d s\n",
+          g_directory, g_snapshot_seconds);
+}
+
+__attribute__((destructor)) void StopTracer() {
+  if (!g_enabled.load()) {
+    return;
+  }
+  g_stopping.store(true);
+  WriteSnapshot();
+}
+
+}  // namespace
+
+#define MEMTRACE_EXPORT extern "C" __attribute__((visibility("default")))
+
+MEMTRACE_EXPORT const char* civic_memtrace_set_tag(const char* tag) {
+  const char* previous = t_state.tag;
+  t_state.tag = tag;
+  return previous;
+}
+
+MEMTRACE_EXPORT int civic_memtrace_snapshot(void) {
+  return WriteSnapshot();
+}
+
+// --- Interposed allocation functions -----------------------------------------
+
+MEMTRACE_EXPORT void* malloc(size_t size) noexcept {
+  void* ptr = __libc_malloc(size);
+  OnAllocate(ptr);
+  return ptr;
+}
+
+MEMTRACE_EXPORT void free(void* ptr) noexcept {
+  OnFree(ptr);
+  __libc_free(ptr);
+}
+
+MEMTRACE_EXPORT void* calloc(size_t count, size_t size) noexcept {
+  void* ptr = __libc_calloc(count, size);
+  OnAllocate(ptr);
+  return ptr;
+}
+
+MEMTRACE_EXPORT void* realloc(void* ptr, size_t size) noexcept {
+  // Accounted as a free and a new allocation. A failed realloc leaves |ptr|
+  // allocated but no longer counted, which only understates live bytes.
+  OnFree(ptr);
+  void* result = __libc_realloc(ptr, size);
+  OnAllocate(result);
+  return result;
+}
+
+MEMTRACE_EXPORT void* memalign(size_t alignment, size_t size) noexcept {
+  void* ptr = __libc_memalign(alignment, size);
+  OnAllocate(ptr);
+  return ptr;
+}
+
+MEMTRACE_EXPORT void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  return memalign(alignment, size);
+}
+
+MEMTRACE_EXPORT int posix_memalign(void** result, size_t alignment,
+                                   size_t size) noexcept {
+  if (alignment % sizeof(void*) != 0 ||
+      (alignment & (alignment - 1)) != 0 || alignment == 0) {
+    return EINVAL;
+  }
+  void* ptr = __libc_memalign(alignment, size);
+  if (ptr == nullptr) {
+    return ENOMEM;
+  }
+  OnAllocate(ptr);
+  *result = ptr;
+  return 0;
+}
+
+MEMTRACE_EXPORT void* valloc(size_t size) noexcept {
+  return memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+MEMTRACE_EXPORT void* pvalloc(size_t size) noexcept {
+  const size_t page = sysconf(_SC_PAGESIZE);
+  return memalign(page, (size + page - 1) & ~(page - 1));
+}
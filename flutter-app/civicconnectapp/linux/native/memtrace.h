@@ -0,0 +1,44 @@
+#ifndef NATIVE_MEMTRACE_H_
+#define NATIVE_MEMTRACE_H_
+
+// C interface of libcivicconnect_memtrace.so, an allocation tracer the runner
+// preloads when started with CIVICCONNECT_MEMTRACE set:
+//
+//   CIVICCONNECT_MEMTRACE=1 ./civicconnectapp
+//   CIVICCONNECT_MEMTRACE=/tmp/traces ./civicconnectapp
+//
+// The tracer interposes malloc and friends. It keeps exact totals of live
+// heap bytes and, for a sample of allocations (about one per
+// CIVICCONNECT_MEMTRACE_SAMPLE_BYTES allocated, 512 KiB by default), the call
+// stack they came from. Sampled allocations are weighted so that per call
+// site totals are unbiased estimates of live bytes. Threads publish their
+// byte counts every 256 KiB and when they exit, so totals lag by at most that
+// much per live thread, and the peak is sampled at those points.
+//
+// Every CIVICCONNECT_MEMTRACE_INTERVAL seconds (60 by default) and at exit
+// the tracer writes a snapshot to memtrace-<pid>-<n>.txt in the trace
+// directory (~/.cache/civicconnect/memtrace unless a path is given). A
+// snapshot holds /proc/self/smaps_rollup, heap totals and peak, live bytes
+// per subsystem tag and the largest call sites. Compare two snapshots with
+// the memtrace_diff tool.
+//
+// Code outside the tracer should look these functions up with dlsym() so it
+// works without the tracer; see MemoryTagScope in native/memory_tag.h.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Attributes allocations made by the calling thread to |tag| until the next
+// call, and returns the previous tag. |tag| must have static storage
+// duration. Null restores attribution by the calling library.
+const char* civic_memtrace_set_tag(const char* tag);
+
+// Writes a snapshot now. Returns 0 on success.
+int civic_memtrace_snapshot(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // NATIVE_MEMTRACE_H_
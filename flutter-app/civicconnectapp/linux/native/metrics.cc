@@ -0,0 +1,506 @@
+#include "native/metrics.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+// Prefix added to every exported metric name.
+constexpr char kMetricPrefix[] = "civicconnect_";
+
+// Exported histogram buckets are every other power of two from 2^10 ns
+// (about 1 us) to 2^40 ns (about 18 minutes), which line up exactly with the
+// internal bucket boundaries.
+constexpr int kFirstExportBucketBit = 10;
+constexpr int kLastExportBucketBit = 40;
+constexpr int kExportBucketBitStep = 2;
+
+// Each thread's shard for every metric, indexed by metric id. A plain array
+// of pointers keeps the lookup on the recording path to one TLS load.
+thread_local void* t_shards[kMaxMetrics];
+
+// Hands the shards in t_shards back to their metrics when the thread exits.
+// Kept apart from t_shards, and only touched when a shard is attached, so
+// that recording does not pay for the guard of a thread_local with a
+// destructor.
+struct ThreadShardReleaser {
+  using DetachFunction = void (*)(int id, void* shard);
+
+  DetachFunction detach[kMaxMetrics] = {};
+
+  ~ThreadShardReleaser() {
+    for (int id = 0; id < kMaxMetrics; ++id) {
+      if (t_shards[id] != nullptr && detach[id] != nullptr) {
+        detach[id](id, t_shards[id]);
+        t_shards[id] = nullptr;
+      }
+    }
+  }
+};
+
+thread_local ThreadShardReleaser t_releaser;
+
+// Increments a value only ever written by the owning thread. A relaxed load
+// and store is enough for readers to see a torn-free value and avoids the
+// locked read-modify-write of fetch_add.
+inline void AddSingleWriter(std::atomic<uint64_t>* value, uint64_t delta) {
+  value->store(value->load(std::memory_order_relaxed) + delta,
+               std::memory_order_relaxed);
+}
+
+inline int MostSignificantBit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+// Smallest value that falls in bucket |index|.
+uint64_t BucketLowerBound(int index) {
+  constexpr int kSubBuckets = 1 << Histogram::kSubBucketBits;
+  if (index < 2 * kSubBuckets) {
+    return static_cast<uint64_t>(index);
+  }
+  const int group = index >> Histogram::kSubBucketBits;
+  const uint64_t sub_bucket = index & (kSubBuckets - 1);
+  return (kSubBuckets + sub_bucket) << (group - 1);
+}
+
+void AppendFormat(std::string* out, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void AppendFormat(std::string* out, const char* format, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  const int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length > 0) {
+    out->append(line, std::min<size_t>(length, sizeof(line) - 1));
+  }
+}
+
+// Appends " <timestamp_ms>\n", or just "\n" without a timestamp.
+void AppendSampleEnd(int64_t timestamp_ms, std::string* out) {
+  if (timestamp_ms != 0) {
+    AppendFormat(out, " %" PRId64, timestamp_ms);
+  }
+  out->push_back('\n');
+}
+
+void AppendHeader(const std::string& name, const std::string& help,
+                  const char* type, std::string* out) {
+  out->append("# HELP ").append(kMetricPrefix).append(name);
+  out->push_back(' ');
+  // Help text may not contain raw newlines or backslashes.
+  for (char c : help) {
+    if (c == '\\') {
+      out->append("\\\\");
+    } else if (c == '\n') {
+      out->append("\\n");
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('\n');
+  out->append("# TYPE ").append(kMetricPrefix).append(name);
+  out->push_back(' ');
+  out->append(type);
+  out->push_back('\n');
+}
+
+constexpr double kNanosPerSecond = 1e9;
+
+}  // namespace
+
+uint64_t MetricsNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// --- Histogram ---------------------------------------------------------------
+
+constexpr int Histogram::kBucketCount;
+
+struct Histogram::Shard {
+  std::atomic<uint64_t> counts[kBucketCount];
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+  // All shards, for readers; never unlinked.
+  Shard* next = nullptr;
+  // Shards of exited threads, under free_mutex_.
+  Shard* next_free = nullptr;
+
+  Shard() {
+    for (std::atomic<uint64_t>& count : counts) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+  }
+};
+
+Histogram::Histogram(int id, const std::string& name, const std::string& help)
+    : id_(id), name_(name), help_(help), shards_(nullptr) {}
+
+int Histogram::BucketIndex(uint64_t value) {
+  if (value < (uint64_t{1} << kSubBucketBits)) {
+    return static_cast<int>(value);
+  }
+  const int shift = MostSignificantBit(value) - kSubBucketBits;
+  return (shift << kSubBucketBits) + static_cast<int>(value >> shift);
+}
+
+uint64_t Histogram::BucketLimit(int index) {
+  return BucketLowerBound(index + 1);
+}
+
+void Histogram::Record(uint64_t value) {
+  Shard* shard = static_cast<Shard*>(t_shards[id_]);
+  if (shard == nullptr) {
+    shard = AttachShard();
+  }
+  value = std::min(value, kMaxValue);
+  AddSingleWriter(&shard->counts[BucketIndex(value)], 1);
+  AddSingleWriter(&shard->sum, value);
+  if (value > shard->max.load(std::memory_order_relaxed)) {
+    shard->max.store(value, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Shard* Histogram::AttachShard() {
+  Shard* shard = nullptr;
+  {
+    // The lock also orders the previous owner's last writes before ours.
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    if (free_shards_ != nullptr) {
+      shard = free_shards_;
+      free_shards_ = shard->next_free;
+    }
+  }
+  if (shard == nullptr) {
+    shard = new Shard();
+    Shard* head = shards_.load(std::memory_order_relaxed);
+    do {
+      shard->next = head;
+    } while (!shards_.compare_exchange_weak(head, shard,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+  t_shards[id_] = shard;
+  t_releaser.detach[id_] = &Histogram::DetachShard;
+  return shard;
+}
+
+void Histogram::DetachShard(int id, void* shard) {
+  Histogram* histogram = MetricsRegistry::Get()->HistogramById(id);
+  Shard* detached = static_cast<Shard*>(shard);
+  std::lock_guard<std::mutex> lock(histogram->free_mutex_);
+  detached->next_free = histogram->free_shards_;
+  histogram->free_shards_ = detached;
+}
+
+size_t Histogram::ShardCount() const {
+  size_t count = 0;
+  for (const Shard* shard = shards_.load(std::memory_order_acquire);
+       shard != nullptr; shard = shard->next) {
+    ++count;
+  }
+  return count;
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  snapshot.counts.assign(kBucketCount, 0);
+  for (const Shard* shard = shards_.load(std::memory_order_acquire);
+       shard != nullptr; shard = shard->next) {
+    for (int i = 0; i < kBucketCount; ++i) {
+      snapshot.counts[i] += shard->counts[i].load(std::memory_order_relaxed);
+    }
+    snapshot.sum += shard->sum.load(std::memory_order_relaxed);
+    snapshot.max =
+        std::max(snapshot.max, shard->max.load(std::memory_order_relaxed));
+  }
+  // Counting from the buckets keeps count consistent with them even while
+  // other threads are recording.
+  for (uint64_t count : snapshot.counts) {
+    snapshot.count += count;
+  }
+  return snapshot;
+}
+
+uint64_t HistogramSnapshot::ValueAtQuantile(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  const uint64_t rank =
+      std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(Histogram::BucketLimit(static_cast<int>(i)) - 1, max);
+    }
+  }
+  return max;
+}
+
+// --- Counter -----------------------------------------------------------------
+
+struct Counter::Shard {
+  std::atomic<uint64_t> value{0};
+  Shard* next = nullptr;
+  Shard* next_free = nullptr;
+  // Keeps shards of different threads off each other's cache lines.
+  char padding[40];
+};
+
+Counter::Counter(int id, const std::string& name, const std::string& help)
+    : id_(id), name_(name), help_(help), shards_(nullptr) {}
+
+void Counter::Increment(uint64_t delta) {
+  Shard* shard = static_cast<Shard*>(t_shards[id_]);
+  if (shard == nullptr) {
+    shard = AttachShard();
+  }
+  AddSingleWriter(&shard->value, delta);
+}
+
+Counter::Shard* Counter::AttachShard() {
+  Shard* shard = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    if (free_shards_ != nullptr) {
+      shard = free_shards_;
+      free_shards_ = shard->next_free;
+    }
+  }
+  if (shard == nullptr) {
+    shard = new Shard();
+    Shard* head = shards_.load(std::memory_order_relaxed);
+    do {
+      shard->next = head;
+    } while (!shards_.compare_exchange_weak(head, shard,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+  t_shards[id_] = shard;
+  t_releaser.detach[id_] = &Counter::DetachShard;
+  return shard;
+}
+
+void Counter::DetachShard(int id, void* shard) {
+  Counter* counter = MetricsRegistry::Get()->CounterById(id);
+  Shard* detached = static_cast<Shard*>(shard);
+  std::lock_guard<std::mutex> lock(counter->free_mutex_);
+  detached->next_free = counter->free_shards_;
+  counter->free_shards_ = detached;
+}
+
+size_t Counter::ShardCount() const {
+  size_t count = 0;
+  for (const Shard* shard = shards_.load(std::memory_order_acquire);
+       shard != nullptr; shard = shard->next) {
+    ++count;
+  }
+  return count;
+}
+
+uint64_t Counter::Value() const {
+  uint64_t value = 0;
+  for (const Shard* shard = shards_.load(std::memory_order_acquire);
+       shard != nullptr; shard = shard->next) {
+    value += shard->value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+// --- MetricsRegistry ---------------------------------------------------------
+
+MetricsRegistry* MetricsRegistry::Get() {
+  // Leaked so metrics stay valid while other threads shut down.
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return registry;
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name,
+                                         const std::string& help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::unique_ptr<Histogram>& histogram : histograms_) {
+    if (histogram->name() == name) {
+      return histogram.get();
+    }
+  }
+  for (const std::unique_ptr<Counter>& counter : counters_) {
+    if (counter->name() == name) {
+      return nullptr;
+    }
+  }
+  if (next_id_ >= kMaxMetrics) {
+    return nullptr;
+  }
+  histograms_.emplace_back(new Histogram(next_id_, name, help));
+  Histogram* histogram = histograms_.back().get();
+  histograms_by_id_[next_id_++].store(histogram, std::memory_order_release);
+  return histogram;
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name,
+                                     const std::string& help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::unique_ptr<Counter>& counter : counters_) {
+    if (counter->name() == name) {
+      return counter.get();
+    }
+  }
+  for (const std::unique_ptr<Histogram>& histogram : histograms_) {
+    if (histogram->name() == name) {
+      return nullptr;
+    }
+  }
+  if (next_id_ >= kMaxMetrics) {
+    return nullptr;
+  }
+  counters_.emplace_back(new Counter(next_id_, name, help));
+  Counter* counter = counters_.back().get();
+  counters_by_id_[next_id_++].store(counter, std::memory_order_release);
+  return counter;
+}
+
+Histogram* MetricsRegistry::HistogramById(int id) const {
+  if (id < 0 || id >= kMaxMetrics) {
+    return nullptr;
+  }
+  return histograms_by_id_[id].load(std::memory_order_acquire);
+}
+
+Counter* MetricsRegistry::CounterById(int id) const {
+  if (id < 0 || id >= kMaxMetrics) {
+    return nullptr;
+  }
+  return counters_by_id_[id].load(std::memory_order_acquire);
+}
+
+void MetricsRegistry::WritePrometheusText(int64_t timestamp_ms,
+                                          std::string* out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::unique_ptr<Counter>& counter : counters_) {
+    AppendHeader(counter->name() + "_total", counter->help(), "counter", out);
+    AppendFormat(out, "%s%s_total %" PRIu64, kMetricPrefix,
+                 counter->name().c_str(), counter->Value());
+    AppendSampleEnd(timestamp_ms, out);
+  }
+  for (const std::unique_ptr<Histogram>& histogram : histograms_) {
+    const HistogramSnapshot snapshot = histogram->Snapshot();
+    const char* name = histogram->name().c_str();
+    AppendHeader(histogram->name(), histogram->help(), "histogram", out);
+    uint64_t cumulative = 0;
+    int next_bucket = 0;
+    for (int bit = kFirstExportBucketBit; bit <= kLastExportBucketBit;
+         bit += kExportBucketBitStep) {
+      const int limit = Histogram::BucketIndex(uint64_t{1} << bit);
+      for (; next_bucket < limit; ++next_bucket) {
+        cumulative += snapshot.counts[next_bucket];
+      }
+      AppendFormat(out, "%s%s_bucket{le=\"%.9g\"} %" PRIu64, kMetricPrefix,
+                   name, static_cast<double>(uint64_t{1} << bit) /
+                             kNanosPerSecond,
+                   cumulative);
+      AppendSampleEnd(timestamp_ms, out);
+    }
+    AppendFormat(out, "%s%s_bucket{le=\"+Inf\"} %" PRIu64, kMetricPrefix,
+                 name, snapshot.count);
+    AppendSampleEnd(timestamp_ms, out);
+    AppendFormat(out, "%s%s_sum %.9g", kMetricPrefix, name,
+                 static_cast<double>(snapshot.sum) / kNanosPerSecond);
+    AppendSampleEnd(timestamp_ms, out);
+    AppendFormat(out, "%s%s_count %" PRIu64, kMetricPrefix, name,
+                 snapshot.count);
+    AppendSampleEnd(timestamp_ms, out);
+  }
+}
+
+// --- MetricsExporter ---------------------------------------------------------
+
+MetricsExporter::MetricsExporter(MetricsRegistry* registry,
+                                 const MetricsExporterOptions& options)
+    : registry_(registry), options_(options) {}
+
+MetricsExporter::~MetricsExporter() {
+  Stop();
+}
+
+void MetricsExporter::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread(&MetricsExporter::Run, this);
+}
+
+void MetricsExporter::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  wake_.notify_all();
+  thread_.join();
+  DumpNow();
+}
+
+void MetricsExporter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    if (wake_.wait_for(lock, options_.interval, [this] { return !running_; })) {
+      break;
+    }
+    lock.unlock();
+    DumpNow();
+    lock.lock();
+  }
+}
+
+bool MetricsExporter::DumpNow() {
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  const int64_t now_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  buffer_.clear();
+  AppendFormat(&buffer_, "# snapshot %" PRId64 "\n", now_ms);
+  registry_->WritePrometheusText(now_ms, &buffer_);
+
+  RotateIfNeeded();
+  FILE* file = fopen(options_.path.c_str(), "a");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written =
+      fwrite(buffer_.data(), 1, buffer_.size(), file) == buffer_.size();
+  return fclose(file) == 0 && written;
+}
+
+void MetricsExporter::RotateIfNeeded() {
+  struct stat info;
+  if (stat(options_.path.c_str(), &info) != 0 ||
+      static_cast<size_t>(info.st_size) < options_.max_file_bytes) {
+    return;
+  }
+  // path.(n-2) -> path.(n-1), ..., path -> path.1; the oldest is overwritten.
+  for (int i = options_.max_files - 1; i > 0; --i) {
+    const std::string from =
+        i == 1 ? options_.path : options_.path + "." + std::to_string(i - 1);
+    rename(from.c_str(), (options_.path + "." + std::to_string(i)).c_str());
+  }
+  if (options_.max_files <= 1) {
+    remove(options_.path.c_str());
+  }
+}
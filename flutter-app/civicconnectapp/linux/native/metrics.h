@@ -0,0 +1,214 @@
+#ifndef NATIVE_METRICS_H_
+#define NATIVE_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Most metrics a process can register. Ids index per-thread shard tables.
+constexpr int kMaxMetrics = 256;
+
+// Returns a monotonic timestamp in nanoseconds, for timing spans.
+uint64_t MetricsNowNs();
+
+// Merged counts of a Histogram at one point in time.
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts;
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  // Returns an upper bound on the value at quantile |q| in [0, 1], accurate
+  // to the histogram's bucket precision.
+  uint64_t ValueAtQuantile(double q) const;
+};
+
+// A log-linear (HDR-style) histogram of non-negative integer values, usually
+// nanosecond latencies. Each power of two is split into 32 linear buckets, so
+// any recorded value is known to within about 3%. Values above kMaxValue are
+// clamped to it.
+//
+// Every thread records into its own shard with plain relaxed loads and
+// stores, so Record() is lock-free and contention-free; readers merge all
+// shards. When a thread exits its shard goes on a free list, counts and all,
+// and the next thread to record takes it over, so no samples are lost and
+// there are only ever as many shards as threads that recorded at once.
+class Histogram {
+ public:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kMaxValueBits = 44;
+  static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxValueBits) - 1;
+  // One group of sub-buckets per power of two up to kMaxValue, plus the
+  // values below 2^kSubBucketBits.
+  static constexpr int kBucketCount = (kMaxValueBits - kSubBucketBits + 1)
+                                      << kSubBucketBits;
+
+  void Record(uint64_t value);
+
+  HistogramSnapshot Snapshot() const;
+
+  int id() const { return id_; }
+  const std::string& name() const { return name_; }
+  const std::string& help() const { return help_; }
+
+  static int BucketIndex(uint64_t value);
+  // Smallest value that falls in the bucket after |index|.
+  static uint64_t BucketLimit(int index);
+
+  // Number of shards allocated so far, live or free.
+  size_t ShardCount() const;
+
+ private:
+  friend class MetricsRegistry;
+  struct Shard;
+
+  Histogram(int id, const std::string& name, const std::string& help);
+
+  Shard* AttachShard();
+  // Puts the exiting thread's |shard| of histogram |id| on its free list.
+  static void DetachShard(int id, void* shard);
+
+  const int id_;
+  const std::string name_;
+  const std::string help_;
+  std::atomic<Shard*> shards_;
+  mutable std::mutex free_mutex_;
+  Shard* free_shards_ = nullptr;
+};
+
+// A monotonically increasing count, sharded per thread like Histogram,
+// including the reuse of shards left by exited threads.
+class Counter {
+ public:
+  void Increment(uint64_t delta = 1);
+
+  uint64_t Value() const;
+
+  int id() const { return id_; }
+  const std::string& name() const { return name_; }
+  const std::string& help() const { return help_; }
+
+  // Number of shards allocated so far, live or free.
+  size_t ShardCount() const;
+
+ private:
+  friend class MetricsRegistry;
+  struct Shard;
+
+  Counter(int id, const std::string& name, const std::string& help);
+
+  Shard* AttachShard();
+  static void DetachShard(int id, void* shard);
+
+  const int id_;
+  const std::string name_;
+  const std::string help_;
+  std::atomic<Shard*> shards_;
+  mutable std::mutex free_mutex_;
+  Shard* free_shards_ = nullptr;
+};
+
+// Records the time from construction to destruction into a histogram.
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(Histogram* histogram)
+      : histogram_(histogram), start_ns_(MetricsNowNs()) {}
+  ~ScopedLatency() {
+    if (histogram_ != nullptr) {
+      histogram_->Record(MetricsNowNs() - start_ns_);
+    }
+  }
+
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+ private:
+  Histogram* histogram_;
+  uint64_t start_ns_;
+};
+
+// The process-wide set of metrics. Registered metrics are never destroyed, so
+// pointers to them may be cached freely.
+class MetricsRegistry {
+ public:
+  static MetricsRegistry* Get();
+
+  // Returns the histogram or counter called |name|, registering it on first
+  // use. Returns null if the registry is full or |name| is already used by a
+  // metric of the other kind. Histogram names should carry their unit, e.g.
+  // "submit_upload_seconds"; values are recorded in nanoseconds and exported
+  // in seconds.
+  Histogram* GetHistogram(const std::string& name, const std::string& help);
+  Counter* GetCounter(const std::string& name, const std::string& help);
+
+  // Lock-free lookups by id, for handles passed across FFI. Return null for
+  // unknown ids.
+  Histogram* HistogramById(int id) const;
+  Counter* CounterById(int id) const;
+
+  // Appends every metric to |out| in the Prometheus text exposition format,
+  // stamping samples with |timestamp_ms| if it is non-zero.
+  void WritePrometheusText(int64_t timestamp_ms, std::string* out) const;
+
+ private:
+  MetricsRegistry() = default;
+
+  mutable std::mutex mutex_;
+  int next_id_ = 0;
+  std::vector<std::unique_ptr<Histogram>> histograms_;
+  std::vector<std::unique_ptr<Counter>> counters_;
+  std::atomic<Histogram*> histograms_by_id_[kMaxMetrics] = {};
+  std::atomic<Counter*> counters_by_id_[kMaxMetrics] = {};
+};
+
+struct MetricsExporterOptions {
+  // File the dumps are appended to. Rotated files get a ".1", ".2", ...
+  // suffix, oldest last.
+  std::string path;
+  std::chrono::milliseconds interval{10000};
+  size_t max_file_bytes = 1024 * 1024;
+  int max_files = 5;
+};
+
+// Periodically appends a snapshot of a registry to a rotating local file.
+class MetricsExporter {
+ public:
+  MetricsExporter(MetricsRegistry* registry,
+                  const MetricsExporterOptions& options);
+  // Stops the exporter, writing a final snapshot.
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  void Start();
+  // Stops the background thread and writes a final snapshot.
+  void Stop();
+
+  // Writes a snapshot now. Returns false if the file could not be written.
+  bool DumpNow();
+
+ private:
+  void Run();
+  void RotateIfNeeded();
+
+  MetricsRegistry* registry_;
+  MetricsExporterOptions options_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_ = false;
+  std::thread thread_;
+  // Serializes dumps from the exporter thread and DumpNow() callers.
+  std::mutex dump_mutex_;
+  // Reused between dumps.
+  std::string buffer_;
+};
+
+#endif  // NATIVE_METRICS_H_
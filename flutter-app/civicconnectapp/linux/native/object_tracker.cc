@@ -0,0 +1,253 @@
+#include "native/object_tracker.h"
+
+#include <algorithm>
+
+#include "native/yolo_postprocess.h"
+
+namespace {
+
+// Process and measurement noise relative to box height, from ByteTrack.
+constexpr float kStdWeightPosition = 1.0f / 20;
+constexpr float kStdWeightVelocity = 1.0f / 160;
+// Fixed noise of the aspect ratio axis, which does not scale with height.
+constexpr float kAspectInitialStd = 1e-2f;
+constexpr float kAspectProcessStd = 1e-2f;
+constexpr float kAspectVelocityStd = 1e-5f;
+constexpr float kAspectMeasurementStd = 1e-1f;
+
+constexpr int kAspectAxis = 2;
+constexpr int kHeightAxis = 3;
+
+// Centre x, centre y, aspect ratio and height of |box|.
+void Measure(const BoundingBox& box, float z[4]) {
+  const float height = std::max(box.height(), 1.0f);
+  z[0] = (box.x1 + box.x2) / 2;
+  z[1] = (box.y1 + box.y2) / 2;
+  z[2] = box.width() / height;
+  z[3] = height;
+}
+
+}  // namespace
+
+ObjectTracker::ObjectTracker(const TrackerOptions& options)
+    : options_(options) {}
+
+void ObjectTracker::Predict(int64_t frame,
+                            std::vector<ConsolidatedDetection>* finished) {
+  frame_ = frame;
+  size_t kept = 0;
+  for (size_t i = 0; i < tracks_.size(); ++i) {
+    Track& track = tracks_[i];
+    const float height = std::max(track.axes[kHeightAxis].value, 1.0f);
+    for (int a = 0; a < 4; ++a) {
+      const float position_std = a == kAspectAxis
+                                     ? kAspectProcessStd
+                                     : kStdWeightPosition * height;
+      const float velocity_std = a == kAspectAxis
+                                     ? kAspectVelocityStd
+                                     : kStdWeightVelocity * height;
+      Axis& axis = track.axes[a];
+      axis.value += axis.velocity;
+      axis.var_value += 2 * axis.covariance + axis.var_velocity +
+                        position_std * position_std;
+      axis.covariance += axis.var_velocity;
+      axis.var_velocity += velocity_std * velocity_std;
+    }
+    ++track.frames_since_update;
+
+    if (track.frames_since_update > options_.max_lost_frames) {
+      Finish(track, finished);
+      continue;
+    }
+    if (kept != i) {
+      tracks_[kept] = track;
+    }
+    ++kept;
+  }
+  tracks_.resize(kept);
+}
+
+void ObjectTracker::Update(const std::vector<Detection>& detections,
+                           std::vector<int>* improved) {
+  improved->clear();
+  high_.clear();
+  low_.clear();
+  for (size_t d = 0; d < detections.size(); ++d) {
+    const float score = detections[d].confidence;
+    if (score >= options_.high_threshold) {
+      high_.push_back(static_cast<int>(d));
+    } else if (score >= options_.low_threshold) {
+      low_.push_back(static_cast<int>(d));
+    }
+  }
+  track_used_.assign(tracks_.size(), false);
+  detection_used_.assign(detections.size(), false);
+
+  Associate(detections, high_, options_.high_match_iou, false, &track_used_,
+            &detection_used_, improved);
+  Associate(detections, low_, options_.low_match_iou, true, &track_used_,
+            &detection_used_, improved);
+  for (size_t t = 0; t < tracks_.size(); ++t) {
+    tracks_[t].matched = track_used_[t];
+  }
+
+  for (int d : high_) {
+    const Detection& detection = detections[d];
+    if (detection_used_[d] ||
+        detection.confidence < options_.new_track_threshold) {
+      continue;
+    }
+    Track track;
+    track.id = next_id_++;
+    track.class_id = detection.class_id;
+    track.class_name = detection.class_name;
+    track.confidence = detection.confidence;
+    track.matched = true;
+    track.frames_since_update = 0;
+    Initiate(detection, &track);
+    track.summary.track_id = track.id;
+    track.summary.best = detection;
+    track.summary.best_frame = frame_;
+    track.summary.first_frame = frame_;
+    track.summary.last_frame = frame_;
+    track.summary.hits = 1;
+    tracks_.push_back(track);
+    improved->push_back(track.id);
+  }
+}
+
+void ObjectTracker::Flush(std::vector<ConsolidatedDetection>* finished) {
+  for (const Track& track : tracks_) {
+    Finish(track, finished);
+  }
+  tracks_.clear();
+}
+
+void ObjectTracker::GetObjects(std::vector<TrackedObject>* objects) const {
+  objects->clear();
+  for (const Track& track : tracks_) {
+    if (!track.matched) {
+      continue;
+    }
+    objects->push_back(TrackedObject{track.id, track.class_id,
+                                     track.class_name, track.confidence,
+                                     TrackBox(track)});
+  }
+}
+
+bool ObjectTracker::HasTrack(int track_id) const {
+  for (const Track& track : tracks_) {
+    if (track.id == track_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ObjectTracker::Initiate(const Detection& detection, Track* track) const {
+  float z[4];
+  Measure(detection.box, z);
+  const float height = z[kHeightAxis];
+  for (int a = 0; a < 4; ++a) {
+    const float position_std = a == kAspectAxis
+                                   ? kAspectInitialStd
+                                   : 2 * kStdWeightPosition * height;
+    const float velocity_std = a == kAspectAxis
+                                   ? kAspectVelocityStd
+                                   : 10 * kStdWeightVelocity * height;
+    track->axes[a] = Axis{z[a], 0.0f, position_std * position_std, 0.0f,
+                          velocity_std * velocity_std};
+  }
+}
+
+void ObjectTracker::Correct(const Detection& detection, Track* track) const {
+  float z[4];
+  Measure(detection.box, z);
+  const float height = std::max(track->axes[kHeightAxis].value, 1.0f);
+  for (int a = 0; a < 4; ++a) {
+    const float measurement_std = a == kAspectAxis
+                                      ? kAspectMeasurementStd
+                                      : kStdWeightPosition * height;
+    Axis& axis = track->axes[a];
+    const float innovation_var =
+        axis.var_value + measurement_std * measurement_std;
+    const float gain_value = axis.var_value / innovation_var;
+    const float gain_velocity = axis.covariance / innovation_var;
+    const float innovation = z[a] - axis.value;
+    axis.value += gain_value * innovation;
+    axis.velocity += gain_velocity * innovation;
+    axis.var_velocity -= gain_velocity * axis.covariance;
+    axis.covariance *= 1 - gain_value;
+    axis.var_value *= 1 - gain_value;
+  }
+}
+
+BoundingBox ObjectTracker::TrackBox(const Track& track) {
+  const float cx = track.axes[0].value;
+  const float cy = track.axes[1].value;
+  const float height = track.axes[kHeightAxis].value;
+  const float width = track.axes[kAspectAxis].value * height;
+  return BoundingBox{cx - width / 2, cy - height / 2, cx + width / 2,
+                     cy + height / 2};
+}
+
+void ObjectTracker::Associate(const std::vector<Detection>& detections,
+                              const std::vector<int>& detection_indices,
+                              float min_iou, bool only_matched_tracks,
+                              std::vector<bool>* track_used,
+                              std::vector<bool>* detection_used,
+                              std::vector<int>* improved) {
+  candidates_.clear();
+  for (size_t t = 0; t < tracks_.size(); ++t) {
+    const Track& track = tracks_[t];
+    if ((*track_used)[t] || (only_matched_tracks && !track.matched)) {
+      continue;
+    }
+    const BoundingBox box = TrackBox(track);
+    for (int d : detection_indices) {
+      if ((*detection_used)[d] || detections[d].class_id != track.class_id) {
+        continue;
+      }
+      const float iou = BoxIou(box, detections[d].box);
+      if (iou >= min_iou) {
+        candidates_.push_back(Candidate{iou, static_cast<int>(t), d});
+      }
+    }
+  }
+  // Greedy matching by descending IoU rather than an optimal assignment; the
+  // two agree whenever objects do not overlap, which is the usual case for
+  // litter and road damage.
+  std::sort(candidates_.begin(), candidates_.end(),
+            [](const Candidate& a, const Candidate& b) {
+              return a.iou > b.iou;
+            });
+
+  for (const Candidate& candidate : candidates_) {
+    if ((*track_used)[candidate.track] ||
+        (*detection_used)[candidate.detection]) {
+      continue;
+    }
+    (*track_used)[candidate.track] = true;
+    (*detection_used)[candidate.detection] = true;
+
+    const Detection& detection = detections[candidate.detection];
+    Track& track = tracks_[candidate.track];
+    Correct(detection, &track);
+    track.confidence = detection.confidence;
+    track.frames_since_update = 0;
+    ++track.summary.hits;
+    track.summary.last_frame = frame_;
+    if (detection.confidence > track.summary.best.confidence) {
+      track.summary.best = detection;
+      track.summary.best_frame = frame_;
+      improved->push_back(track.id);
+    }
+  }
+}
+
+void ObjectTracker::Finish(const Track& track,
+                           std::vector<ConsolidatedDetection>* finished) const {
+  if (track.summary.hits >= options_.min_hits) {
+    finished->push_back(track.summary);
+  }
+}
@@ -0,0 +1,138 @@
+#ifndef NATIVE_OBJECT_TRACKER_H_
+#define NATIVE_OBJECT_TRACKER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "native/image_types.h"
+
+struct TrackerOptions {
+  // Detections at or above this score are associated first, against every
+  // track; those between |low_threshold| and it only continue tracks that
+  // were matched on the previous keyframe, which recovers objects whose score
+  // dips under blur or occlusion without letting them start new tracks.
+  float high_threshold = 0.5f;
+  float low_threshold = 0.1f;
+  // Least IoU between a predicted track box and a detection to match them,
+  // for high and low score detections respectively.
+  float high_match_iou = 0.2f;
+  float low_match_iou = 0.5f;
+  // Unmatched high score detections at or above this start a new track.
+  float new_track_threshold = 0.5f;
+  // Frames a track survives without a matching detection.
+  int max_lost_frames = 30;
+  // Matched detections a track needs before it is reported. Raise to drop
+  // one-off false positives at the cost of recall.
+  int min_hits = 1;
+};
+
+// A live track, with its box predicted or corrected for the latest frame.
+struct TrackedObject {
+  int track_id;
+  int class_id;
+  const char* class_name;
+  float confidence;
+  BoundingBox box;
+};
+
+// Everything known about one object once its track ends.
+struct ConsolidatedDetection {
+  int track_id;
+  // The highest-scoring detection of the object and the frame it came from.
+  Detection best;
+  int64_t best_frame;
+  int64_t first_frame;
+  int64_t last_frame;
+  // Detections matched to the track.
+  int hits;
+};
+
+// A ByteTrack-style multi-object tracker. Each track runs a constant velocity
+// Kalman filter over box centre, aspect ratio and height, and detections are
+// associated by IoU with the predicted boxes, high scores first. Tracks match
+// only detections of their own class. Not thread-safe.
+//
+// Call Predict() once per frame, then Update() on frames the detector ran on.
+// Between keyframes Predict() alone carries tracks forward.
+class ObjectTracker {
+ public:
+  explicit ObjectTracker(const TrackerOptions& options);
+
+  // Advances every track to frame |frame| and ends tracks that have gone
+  // unmatched for longer than max_lost_frames, appending them to |finished|.
+  void Predict(int64_t frame, std::vector<ConsolidatedDetection>* finished);
+
+  // Associates the detector's output for the current frame with the tracks
+  // and starts tracks for new objects. Ids of tracks whose best detection is
+  // now from this frame are written to |improved|, so the caller can keep
+  // the frame.
+  void Update(const std::vector<Detection>& detections,
+              std::vector<int>* improved);
+
+  // Ends every track, appending the reportable ones to |finished|.
+  void Flush(std::vector<ConsolidatedDetection>* finished);
+
+  // Replaces |objects| with the live tracks for the current frame.
+  void GetObjects(std::vector<TrackedObject>* objects) const;
+
+  // Whether a track is still live. Tracks that ended are never reused.
+  bool HasTrack(int track_id) const;
+
+ private:
+  // Position and velocity of one state dimension with their 2x2 covariance.
+  // With the diagonal noise ByteTrack uses the dimensions never correlate,
+  // so four of these are exactly the usual 8-dimensional filter.
+  struct Axis {
+    float value;
+    float velocity;
+    float var_value;
+    float covariance;
+    float var_velocity;
+  };
+
+  struct Track {
+    int id;
+    int class_id;
+    const char* class_name;
+    float confidence;
+    // Centre x, centre y, aspect ratio (w / h) and height.
+    Axis axes[4];
+    // Whether the last keyframe matched a detection.
+    bool matched;
+    int64_t frames_since_update;
+    ConsolidatedDetection summary;
+  };
+
+  struct Candidate {
+    float iou;
+    int track;
+    int detection;
+  };
+
+  void Initiate(const Detection& detection, Track* track) const;
+  void Correct(const Detection& detection, Track* track) const;
+  static BoundingBox TrackBox(const Track& track);
+  // Greedily matches detections in |detection_indices| to unmatched tracks,
+  // highest IoU first, marking matched entries in |track_used| and
+  // |detection_used|.
+  void Associate(const std::vector<Detection>& detections,
+                 const std::vector<int>& detection_indices, float min_iou,
+                 bool only_matched_tracks, std::vector<bool>* track_used,
+                 std::vector<bool>* detection_used,
+                 std::vector<int>* improved);
+  void Finish(const Track& track,
+              std::vector<ConsolidatedDetection>* finished) const;
+
+  const TrackerOptions options_;
+  std::vector<Track> tracks_;
+  int64_t frame_ = -1;
+  int next_id_ = 1;
+  // Reused between updates.
+  std::vector<Candidate> candidates_;
+  std::vector<int> high_;
+  std::vector<int> low_;
+  std::vector<bool> track_used_;
+  std::vector<bool> detection_used_;
+};
+
+#endif  // NATIVE_OBJECT_TRACKER_H_
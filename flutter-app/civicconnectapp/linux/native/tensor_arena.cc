@@ -0,0 +1,99 @@
+#include "native/tensor_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+struct TensorArena::Chunk {
+  Chunk* next;
+  size_t capacity;
+
+  uint8_t* data();
+};
+
+namespace {
+
+// Chunk headers take a whole alignment unit so chunk data stays aligned.
+constexpr size_t kChunkHeaderSize = kTensorAlignment;
+static_assert(kChunkHeaderSize >= 2 * sizeof(void*), "chunk header too small");
+
+// Extra room given to the merged chunk, since replaying the same allocations
+// into one chunk can need different alignment padding than the chain did.
+constexpr size_t kMergeHeadroomDivisor = 8;
+
+}  // namespace
+
+uint8_t* TensorArena::Chunk::data() {
+  return reinterpret_cast<uint8_t*>(this) + kChunkHeaderSize;
+}
+
+TensorArena::TensorArena(size_t initial_capacity)
+    : base_(nullptr),
+      overflow_(nullptr),
+      current_(nullptr),
+      offset_(0),
+      retired_bytes_(0) {
+  base_ = NewChunk(std::max<size_t>(initial_capacity, kTensorAlignment));
+  current_ = base_;
+}
+
+TensorArena::~TensorArena() {
+  FreeOverflowChunks();
+  free(base_);
+}
+
+void* TensorArena::Allocate(size_t size, size_t alignment) {
+  size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+  if (start + size > current_->capacity) {
+    retired_bytes_ += offset_;
+    Chunk* chunk = NewChunk(std::max(size, base_->capacity));
+    chunk->next = overflow_;
+    overflow_ = chunk;
+    current_ = chunk;
+    start = 0;
+  }
+  offset_ = start + size;
+  stats_.high_water_bytes =
+      std::max(stats_.high_water_bytes, retired_bytes_ + offset_);
+  return current_->data() + start;
+}
+
+void TensorArena::Reset() {
+  if (overflow_ != nullptr) {
+    FreeOverflowChunks();
+    const size_t needed = stats_.high_water_bytes +
+                          stats_.high_water_bytes / kMergeHeadroomDivisor;
+    if (needed > base_->capacity) {
+      stats_.capacity_bytes -= base_->capacity;
+      free(base_);
+      base_ = NewChunk(needed);
+    }
+  }
+  current_ = base_;
+  offset_ = 0;
+  retired_bytes_ = 0;
+}
+
+TensorArena::Chunk* TensorArena::NewChunk(size_t capacity) {
+  capacity = (capacity + kTensorAlignment - 1) & ~(kTensorAlignment - 1);
+  void* memory = nullptr;
+  if (posix_memalign(&memory, kTensorAlignment, kChunkHeaderSize + capacity) !=
+      0) {
+    throw std::bad_alloc();
+  }
+  Chunk* chunk = static_cast<Chunk*>(memory);
+  chunk->next = nullptr;
+  chunk->capacity = capacity;
+  stats_.capacity_bytes += capacity;
+  ++stats_.system_allocations;
+  return chunk;
+}
+
+void TensorArena::FreeOverflowChunks() {
+  while (overflow_ != nullptr) {
+    Chunk* next = overflow_->next;
+    stats_.capacity_bytes -= overflow_->capacity;
+    free(overflow_);
+    overflow_ = next;
+  }
+}
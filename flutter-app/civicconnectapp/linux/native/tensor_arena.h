@@ -0,0 +1,66 @@
+#ifndef NATIVE_TENSOR_ARENA_H_
+#define NATIVE_TENSOR_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Alignment of every tensor buffer handed out by the arena and buffer pool;
+// one cache line, and wide enough for AVX-512 loads.
+constexpr size_t kTensorAlignment = 64;
+
+struct ArenaStats {
+  // Bytes owned by the arena.
+  size_t capacity_bytes = 0;
+  // Most bytes handed out between two resets.
+  size_t high_water_bytes = 0;
+  // Number of times the arena had to ask the system for memory.
+  uint64_t system_allocations = 0;
+};
+
+// A bump-pointer allocator for per-request scratch, released in one go by
+// Reset().
+//
+// When a request needs more than the current capacity the arena chains extra
+// chunks; the next Reset() replaces them with a single chunk large enough for
+// the high-water mark, so a steady workload stops allocating after the first
+// few requests. Not thread-safe; use one arena per worker.
+class TensorArena {
+ public:
+  explicit TensorArena(size_t initial_capacity = 1 << 20);
+  ~TensorArena();
+
+  TensorArena(const TensorArena&) = delete;
+  TensorArena& operator=(const TensorArena&) = delete;
+
+  // Returns |size| bytes aligned to |alignment|, a power of two no larger than
+  // kTensorAlignment. The memory is uninitialized.
+  void* Allocate(size_t size, size_t alignment = kTensorAlignment);
+
+  template <typename T>
+  T* AllocateArray(size_t count) {
+    return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // Invalidates everything allocated since the last reset.
+  void Reset();
+
+  const ArenaStats& stats() const { return stats_; }
+
+ private:
+  struct Chunk;
+
+  Chunk* NewChunk(size_t capacity);
+  void FreeOverflowChunks();
+
+  // The chunk that survives resets.
+  Chunk* base_;
+  // Extra chunks chained during the current request, most recent first.
+  Chunk* overflow_;
+  Chunk* current_;
+  size_t offset_;
+  // Bytes handed out from chunks other than |current_| this request.
+  size_t retired_bytes_;
+  ArenaStats stats_;
+};
+
+#endif  // NATIVE_TENSOR_ARENA_H_
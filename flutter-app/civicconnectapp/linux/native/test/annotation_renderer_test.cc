@@ -0,0 +1,142 @@
+// Checks the pixels AnnotationRenderer writes for a detection's box and label,
+// and that the SSE2 and scalar blends agree across a span.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "native/annotation_renderer.h"
+#include "native/bitmap_font.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+constexpr int kWidth = 160;
+constexpr int kHeight = 96;
+constexpr Rgba kBackground = {100, 100, 100, 255};
+
+// A solid kBackground image.
+class SolidImage {
+ public:
+  SolidImage() : pixels_(static_cast<size_t>(kWidth) * kHeight * 4) {
+    for (size_t i = 0; i < pixels_.size(); i += 4) {
+      memcpy(&pixels_[i], &kBackground, 4);
+    }
+  }
+
+  RgbaImage image() {
+    return RgbaImage{pixels_.data(), kWidth, kHeight,
+                     static_cast<size_t>(kWidth) * 4};
+  }
+
+  bool PixelIs(int x, int y, Rgba color) {
+    const uint8_t* pixel = image().Row(y) + x * 4;
+    return pixel[0] == color.r && pixel[1] == color.g && pixel[2] == color.b &&
+           pixel[3] == color.a;
+  }
+
+ private:
+  std::vector<uint8_t> pixels_;
+};
+
+void TestDetectionBoxAndLabel() {
+  SolidImage solid;
+  AnnotationRenderer renderer(solid.image());
+  const Rgba green = AnnotationRenderer::kGarbageColor;
+  const Rgba white = AnnotationRenderer::kLabelTextColor;
+  const Detection detection{0, "trash", 0.5f, {20, 40, 90, 80}};
+  renderer.DrawDetection(detection, green);
+
+  // The two pixel outline lies inside the box; the interior is untouched.
+  CHECK(solid.PixelIs(20, 40, green));
+  CHECK(solid.PixelIs(21, 41, green));
+  CHECK(solid.PixelIs(89, 79, green));
+  CHECK(solid.PixelIs(55, 40, green));
+  CHECK(solid.PixelIs(20, 60, green));
+  CHECK(solid.PixelIs(88, 60, green));
+  CHECK(solid.PixelIs(22, 42, kBackground));
+  CHECK(solid.PixelIs(87, 77, kBackground));
+  CHECK(solid.PixelIs(19, 60, kBackground));
+  CHECK(solid.PixelIs(90, 60, kBackground));
+  CHECK(solid.PixelIs(55, 80, kBackground));
+
+  // The label band sits directly above the box: padding rows in the box
+  // colour, glyph rows with white text on it.
+  const int label_width = MeasureText("trash: 0.50", 2);
+  const int band_top = 40 - 2 * kGlyphCapHeight - 10;
+  CHECK(solid.PixelIs(20, band_top, green));
+  CHECK(solid.PixelIs(20 + label_width - 1, 39, green));
+  CHECK(solid.PixelIs(20 + label_width, 30, kBackground));
+  CHECK(solid.PixelIs(20, band_top - 1, kBackground));
+  int text_pixels = 0;
+  int band_pixels = 0;
+  for (int y = band_top + 5; y < 35; ++y) {
+    for (int x = 20; x < 20 + label_width; ++x) {
+      text_pixels += solid.PixelIs(x, y, white);
+      band_pixels += solid.PixelIs(x, y, green);
+    }
+  }
+  CHECK(text_pixels > 0);
+  CHECK(band_pixels > 0);
+  CHECK(text_pixels + band_pixels == label_width * (35 - band_top - 5));
+
+  CHECK(renderer.dirty_top() == band_top);
+  CHECK(renderer.dirty_bottom() == 80);
+}
+
+// Seven pixels: one SSE2 group of four and three scalar pixels, which must
+// blend to the same value.
+void TestTranslucentSpanBlend() {
+  SolidImage solid;
+  AnnotationRenderer renderer(solid.image());
+  renderer.FillRect(10, 10, 17, 11, Rgba{255, 0, 20, 128});
+  // Each channel is (background * 127 + colour * 128) / 255, rounded.
+  const Rgba expected = {178, 50, 60, 255};
+  for (int x = 10; x < 17; ++x) {
+    CHECK(solid.PixelIs(x, 10, expected));
+  }
+  CHECK(solid.PixelIs(9, 10, kBackground));
+  CHECK(solid.PixelIs(17, 10, kBackground));
+  CHECK(solid.PixelIs(10, 11, kBackground));
+}
+
+// Boxes partly outside the image are clipped rather than written out of
+// bounds.
+void TestClipping() {
+  SolidImage solid;
+  AnnotationRenderer renderer(solid.image());
+  const Detection detection{0, "pothole", 0.9f, {-10, 5, 60, 200}};
+  renderer.DrawDetection(detection, AnnotationRenderer::kPotholeColor);
+  // The left edge is entirely outside the image.
+  CHECK(solid.PixelIs(0, 50, kBackground));
+  CHECK(solid.PixelIs(0, 5, AnnotationRenderer::kPotholeColor));
+  CHECK(solid.PixelIs(58, 50, AnnotationRenderer::kPotholeColor));
+  CHECK(solid.PixelIs(59, kHeight - 1, AnnotationRenderer::kPotholeColor));
+  CHECK(solid.PixelIs(30, 50, kBackground));
+  CHECK(renderer.dirty_top() == 0);
+  CHECK(renderer.dirty_bottom() == kHeight);
+}
+
+}  // namespace
+
+int main() {
+  TestDetectionBoxAndLabel();
+  TestTranslucentSpanBlend();
+  TestClipping();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,231 @@
+// Drives DashcamPipeline over a synthetic panning sequence and checks how the
+// frame gate splits it into skipped, tracked and detected frames, and that a
+// pothole keeps one track through a score dip and an occlusion.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "native/dashcam_pipeline.h"
+#include "native/detection_pipeline.h"
+#include "native/jpeg_codec.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+constexpr int kAnchors = 8400;
+constexpr int kWidth = 640;
+constexpr int kHeight = 384;
+// Pixels the scene pans by per frame while the car moves: enough for the
+// gate's duplicate threshold, too little for a scene change within a
+// keyframe interval.
+constexpr int kPanStep = 3;
+
+// Reports at most one object, set by the test before each frame.
+class ScriptedModel : public DetectionModel {
+ public:
+  explicit ScriptedModel(int classes) : classes_(classes) {}
+
+  int output_channels() const override { return 4 + classes_; }
+  int output_anchors() const override { return kAnchors; }
+
+  // Reports |box|, in image coordinates, with |score| until changed. A score
+  // of zero reports nothing.
+  void SetObject(const BoundingBox& box, float score) {
+    box_ = box;
+    score_ = score;
+  }
+
+  bool Run(const float* input, int input_size, float* output) override {
+    std::fill(output, output + output_channels() * kAnchors, 0.0f);
+    if (score_ > 0) {
+      const float scale_y = static_cast<float>(input_size) / kHeight;
+      const float scale_x = static_cast<float>(input_size) / kWidth;
+      output[0 * kAnchors] = (box_.x1 + box_.x2) / 2 * scale_x;
+      output[1 * kAnchors] = (box_.y1 + box_.y2) / 2 * scale_y;
+      output[2 * kAnchors] = box_.width() * scale_x;
+      output[3 * kAnchors] = box_.height() * scale_y;
+      output[4 * kAnchors] = score_;
+    }
+    return true;
+  }
+
+ private:
+  const int classes_;
+  BoundingBox box_ = {};
+  float score_ = 0;
+};
+
+// A textured road scene panned |offset| pixels to the left.
+std::vector<uint8_t> MakeFrame(int offset) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(kWidth) * kHeight * 4);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      const float u = static_cast<float>(x + offset);
+      const float value = 128 + 60 * std::sin(u / 60) +
+                          40 * std::cos(y / 20.0f + u / 120);
+      uint8_t* pixel = &pixels[(static_cast<size_t>(y) * kWidth + x) * 4];
+      pixel[0] = pixel[1] = pixel[2] = static_cast<uint8_t>(value);
+      pixel[3] = 255;
+    }
+  }
+  std::vector<uint8_t> jpeg;
+  EncodeJpeg(RgbaImage{pixels.data(), kWidth, kHeight,
+                       static_cast<size_t>(kWidth) * 4},
+             90, &jpeg);
+  return jpeg;
+}
+
+// Pan offset of each frame: stopped, driving, stopped again.
+std::vector<int> SequenceOffsets() {
+  std::vector<int> offsets;
+  for (int i = 0; i < 4; ++i) {
+    offsets.push_back(0);
+  }
+  for (int i = 1; i <= 60; ++i) {
+    offsets.push_back(i * kPanStep);
+  }
+  for (int i = 0; i < 4; ++i) {
+    offsets.push_back(offsets.back());
+  }
+  return offsets;
+}
+
+// Pothole score on the n-th keyframe: a dip under the still-image threshold,
+// then two keyframes occluded.
+float KeyframeScore(int keyframe) {
+  const float kScores[] = {0.8f, 0.85f, 0.2f, 0.9f, 0.0f, 0.0f};
+  return keyframe < 6 ? kScores[keyframe] : 0.7f;
+}
+
+struct SequenceResult {
+  DashcamStats stats;
+  std::vector<DashcamReport> reports;
+  // Pothole tracks visible after each keyframe, -1 if none.
+  std::vector<int> keyframe_tracks;
+  std::vector<int64_t> keyframes;
+  std::vector<std::vector<uint8_t>> jpegs;
+};
+
+SequenceResult RunSequence(const DetectionConfig& config) {
+  const DashcamOptions options;
+  ScriptedModel garbage_model(5);
+  ScriptedModel pothole_model(4);
+  DetectionPipeline detector(config, &garbage_model, &pothole_model);
+  DashcamPipeline pipeline(options, &detector);
+
+  SequenceResult result;
+  std::vector<TrackedObject> objects;
+  uint64_t detected = 0;
+  const std::vector<int> offsets = SequenceOffsets();
+  for (size_t frame = 0; frame < offsets.size(); ++frame) {
+    result.jpegs.push_back(MakeFrame(offsets[frame]));
+    const float x = 300.0f - offsets[frame];
+    pothole_model.SetObject(BoundingBox{x, 250, x + 80, 310},
+                            KeyframeScore(static_cast<int>(detected)));
+    const std::vector<uint8_t>& jpeg = result.jpegs.back();
+    CHECK(pipeline.ProcessJpeg(jpeg.data(), jpeg.size(), &result.reports));
+    if (pipeline.stats().detected == detected) {
+      continue;
+    }
+    detected = pipeline.stats().detected;
+    result.keyframes.push_back(static_cast<int64_t>(frame));
+    pipeline.GetObjects(&objects);
+    result.keyframe_tracks.push_back(objects.empty() ? -1
+                                                     : objects[0].track_id);
+  }
+  result.stats = pipeline.stats();
+  pipeline.Finish(&result.reports);
+  return result;
+}
+
+void TestGateSplitsSequence() {
+  DashcamOptions options;
+  const SequenceResult result =
+      RunSequence(DashcamDetectionConfig(options, DetectionConfig()));
+  // The first frame is a keyframe, the stopped frames are near-duplicates,
+  // and every keyframe_interval-th frame of the pan runs the detector.
+  CHECK(result.stats.frames == 68);
+  CHECK(result.stats.skipped == 7);
+  CHECK(result.stats.detected == 11);
+  CHECK(result.stats.tracked == 50);
+  CHECK(result.keyframes.size() == 11);
+  if (result.keyframes.size() == 11) {
+    CHECK(result.keyframes[0] == 0);
+    CHECK(result.keyframes[1] == 4 + options.gate.keyframe_interval - 1);
+    CHECK(result.keyframes[10] == 63);
+  }
+}
+
+void TestTrackSurvivesDipAndOcclusion() {
+  DashcamOptions options;
+  const SequenceResult result =
+      RunSequence(DashcamDetectionConfig(options, DetectionConfig()));
+  CHECK(result.keyframe_tracks.size() == 11);
+  if (result.keyframe_tracks.size() != 11) {
+    return;
+  }
+  const int track = result.keyframe_tracks[0];
+  CHECK(track > 0);
+  // The dip is matched by the low score association.
+  CHECK(result.keyframe_tracks[2] == track);
+  // Occluded keyframes leave the track unmatched but alive, and the object
+  // is picked up by the same track afterwards.
+  CHECK(result.keyframe_tracks[4] == -1);
+  CHECK(result.keyframe_tracks[5] == -1);
+  for (size_t k = 6; k < result.keyframe_tracks.size(); ++k) {
+    CHECK(result.keyframe_tracks[k] == track);
+  }
+
+  CHECK(result.reports.size() == 1);
+  if (result.reports.size() != 1) {
+    return;
+  }
+  const DashcamReport& report = result.reports[0];
+  CHECK(report.is_pothole);
+  CHECK(report.detection.track_id == track);
+  CHECK(report.detection.hits == 9);
+  CHECK(report.detection.first_frame == 0);
+  CHECK(report.detection.last_frame == 63);
+  CHECK(std::fabs(report.detection.best.confidence - 0.9f) < 1e-6f);
+  CHECK(report.detection.best_frame == result.keyframes[3]);
+  CHECK(report.best_frame_jpeg == result.jpegs[result.keyframes[3]]);
+}
+
+// With the still-image threshold the dip never reaches the tracker.
+void TestStillImageThresholdDropsDip() {
+  const SequenceResult result = RunSequence(DetectionConfig());
+  CHECK(result.keyframe_tracks.size() == 11);
+  if (result.keyframe_tracks.size() == 11) {
+    CHECK(result.keyframe_tracks[2] == -1);
+  }
+  CHECK(result.reports.size() == 1);
+  if (!result.reports.empty()) {
+    CHECK(result.reports[0].detection.hits == 8);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestGateSplitsSequence();
+  TestTrackSurvivesDipAndOcclusion();
+  TestStillImageThresholdDropsDip();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,301 @@
+// Checks that the detection path reaches a steady state with no heap
+// allocations per image, libjpeg's working memory included, and that the
+// arenas and pool account for what they hand out.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "native/detection_pipeline.h"
+#include "native/jpeg_codec.h"
+
+// The allocation counters replace malloc, which the sanitizers also replace.
+#if defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCATIONS 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define COUNT_ALLOCATIONS 0
+#endif
+#endif
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 1
+#endif
+
+#if COUNT_ALLOCATIONS
+extern "C" {
+void* __libc_malloc(size_t size);
+void __libc_free(void* ptr);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+#endif
+
+namespace {
+
+// Calls to operator new, and to the C allocation functions (which operator
+// new also goes through). Both stay at zero when COUNT_ALLOCATIONS is off.
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_c_allocations(0);
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+constexpr int kInputSize = 640;
+constexpr int kAnchors = 8400;
+
+// A stand-in for a YOLOv8 model with 80 classes that reports two heavily
+// overlapping boxes and one separate box.
+class FakeModel : public DetectionModel {
+ public:
+  int output_channels() const override { return 84; }
+  int output_anchors() const override { return kAnchors; }
+
+  bool Run(const float* input, int input_size, float* output) override {
+    std::fill(output, output + output_channels() * kAnchors, 0.0f);
+    SetBox(output, 10, 100, 100, 40, 40, 2, 0.9f);
+    SetBox(output, 20, 102, 101, 40, 40, 2, 0.8f);
+    SetBox(output, 30, 400, 300, 80, 60, 7, 0.6f);
+    return true;
+  }
+
+ private:
+  static void SetBox(float* output, int anchor, float cx, float cy, float w,
+                     float h, int class_id, float score) {
+    output[0 * kAnchors + anchor] = cx;
+    output[1 * kAnchors + anchor] = cy;
+    output[2 * kAnchors + anchor] = w;
+    output[3 * kAnchors + anchor] = h;
+    output[(4 + class_id) * kAnchors + anchor] = score;
+  }
+};
+
+std::vector<uint8_t> MakeJpeg(int width, int height) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+      pixel[0] = static_cast<uint8_t>(x);
+      pixel[1] = static_cast<uint8_t>(y);
+      pixel[2] = static_cast<uint8_t>(x ^ y);
+      pixel[3] = 255;
+    }
+  }
+  std::vector<uint8_t> jpeg;
+  EncodeJpeg(RgbaImage{pixels.data(), width, height,
+                       static_cast<size_t>(width) * 4},
+             90, &jpeg);
+  return jpeg;
+}
+
+void TestSteadyStateHasNoAllocations() {
+  FakeModel garbage_model;
+  FakeModel pothole_model;
+  DetectionConfig config;
+  config.input_size = kInputSize;
+  DetectionPipeline pipeline(config, &garbage_model, &pothole_model);
+  const std::vector<uint8_t> jpeg = MakeJpeg(1280, 960);
+  DetectionResult result;
+
+  for (int i = 0; i < 3; ++i) {
+    CHECK(pipeline.DetectJpeg(jpeg.data(), jpeg.size(), &result));
+  }
+  const DetectionMemoryStats warm = pipeline.memory_stats();
+  const uint64_t allocations = g_allocations.load();
+  const uint64_t c_allocations = g_c_allocations.load();
+
+  for (int i = 0; i < 20; ++i) {
+    CHECK(pipeline.DetectJpeg(jpeg.data(), jpeg.size(), &result));
+  }
+  const DetectionMemoryStats steady = pipeline.memory_stats();
+  CHECK(g_allocations.load() == allocations);
+  CHECK(g_c_allocations.load() == c_allocations);
+  CHECK(steady.pool.system_allocations == warm.pool.system_allocations);
+  CHECK(steady.arena.system_allocations == warm.arena.system_allocations);
+  CHECK(steady.decoder.system_allocations == warm.decoder.system_allocations);
+  CHECK(steady.pool.reuses > warm.pool.reuses);
+  CHECK(steady.pool.bytes_in_use == 0);
+  CHECK(steady.pool.high_water_bytes > 0);
+  CHECK(steady.arena.high_water_bytes > 0);
+  CHECK(steady.decoder.high_water_bytes > 0);
+
+  // The overlapping pair collapses to its higher-scoring box, scaled from the
+  // 640x640 model input to the 1280x960 image.
+  CHECK(result.image_width == 1280 && result.image_height == 960);
+  CHECK(result.garbage_detections.size() == 2);
+  CHECK(result.pothole_detections.size() == 2);
+  if (!result.garbage_detections.empty()) {
+    const Detection& best = result.garbage_detections[0];
+    CHECK(std::fabs(best.confidence - 0.9f) < 1e-6f);
+    CHECK(best.class_id == 2);
+    CHECK(std::fabs(best.box.x1 - 160.0f) < 1e-3f);
+    CHECK(std::fabs(best.box.y2 - 180.0f) < 1e-3f);
+  }
+}
+
+// A progressive JPEG of |width| x |height| grey gradient. libjpeg buffers
+// every coefficient of a progressive image in virtual arrays, which the
+// decoder must serve from its arena like the rest of the image pool.
+std::vector<uint8_t> MakeProgressiveJpeg(int width, int height) {
+  std::vector<uint8_t> row(width);
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr errors;
+  cinfo.err = jpeg_std_error(&errors);
+  jpeg_create_compress(&cinfo);
+  unsigned char* buffer = nullptr;
+  unsigned long buffer_size = 0;
+  jpeg_mem_dest(&cinfo, &buffer, &buffer_size);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 1;
+  cinfo.in_color_space = JCS_GRAYSCALE;
+  jpeg_set_defaults(&cinfo);
+  jpeg_simple_progression(&cinfo);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    for (int x = 0; x < width; ++x) {
+      row[x] = static_cast<uint8_t>(x + cinfo.next_scanline);
+    }
+    JSAMPROW rows[] = {row.data()};
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  std::vector<uint8_t> jpeg(buffer, buffer + buffer_size);
+  jpeg_destroy_compress(&cinfo);
+  free(buffer);
+  return jpeg;
+}
+
+void TestDecoderMatchesOneShotOnProgressive() {
+  const std::vector<uint8_t> jpeg = MakeProgressiveJpeg(203, 150);
+  int width = 0;
+  int height = 0;
+  CHECK(ReadJpegSize(jpeg.data(), jpeg.size(), &width, &height));
+  CHECK(width == 203 && height == 150);
+  const size_t stride = static_cast<size_t>(width) * 4;
+  std::vector<uint8_t> expected(stride * height);
+  CHECK(DecodeJpeg(jpeg.data(), jpeg.size(),
+                   RgbaImage{expected.data(), width, height, stride}));
+
+  JpegDecoder decoder;
+  std::vector<uint8_t> pixels(stride * height);
+  uint64_t system_allocations = 0;
+  for (int i = 0; i < 3; ++i) {
+    std::fill(pixels.begin(), pixels.end(), 0);
+    CHECK(decoder.ReadHeader(jpeg.data(), jpeg.size()));
+    CHECK(decoder.Decode(RgbaImage{pixels.data(), width, height, stride}));
+    CHECK(memcmp(pixels.data(), expected.data(), pixels.size()) == 0);
+    if (i > 0) {
+      CHECK(decoder.memory_stats().system_allocations == system_allocations);
+    }
+    system_allocations = decoder.memory_stats().system_allocations;
+  }
+
+  // A truncated image fails cleanly and leaves the decoder usable.
+  CHECK(!decoder.ReadHeader(jpeg.data(), 20) ||
+        !decoder.Decode(RgbaImage{pixels.data(), width, height, stride}));
+  CHECK(decoder.ReadHeader(jpeg.data(), jpeg.size()));
+  CHECK(decoder.Decode(RgbaImage{pixels.data(), width, height, stride}));
+  CHECK(memcmp(pixels.data(), expected.data(), pixels.size()) == 0);
+}
+
+void TestArenaMergesOverflowOnReset() {
+  TensorArena arena(1024);
+  for (int i = 0; i < 4; ++i) {
+    arena.Allocate(800);
+  }
+  CHECK(arena.stats().system_allocations == 4);
+  arena.Reset();
+  const uint64_t merged = arena.stats().system_allocations;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      void* p = arena.Allocate(800);
+      CHECK(reinterpret_cast<uintptr_t>(p) % kTensorAlignment == 0);
+    }
+    arena.Reset();
+  }
+  CHECK(arena.stats().system_allocations == merged);
+}
+
+}  // namespace
+
+#if COUNT_ALLOCATIONS
+extern "C" void* malloc(size_t size) noexcept {
+  ++g_c_allocations;
+  return __libc_malloc(size);
+}
+
+extern "C" void free(void* ptr) noexcept {
+  __libc_free(ptr);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept {
+  ++g_c_allocations;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) noexcept {
+  ++g_c_allocations;
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  ++g_c_allocations;
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** result, size_t alignment,
+                              size_t size) noexcept {
+  ++g_c_allocations;
+  void* ptr = __libc_memalign(alignment, size);
+  if (ptr == nullptr) {
+    return ENOMEM;
+  }
+  *result = ptr;
+  return 0;
+}
+
+void* operator new(size_t size) {
+  ++g_allocations;
+  if (void* p = malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+#endif  // COUNT_ALLOCATIONS
+
+int main() {
+  TestSteadyStateHasNoAllocations();
+  TestDecoderMatchesOneShotOnProgressive();
+  TestArenaMergesOverflowOnReset();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Checks how FrameTimingMonitor classifies frame intervals (on time, missed
+// vsyncs, idle, or jank because the main loop stalled during them) and that
+// the watchdog samples the main thread's stack during a stall.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "native/frame_timing.h"
+#include "native/metrics.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+constexpr uint64_t kMs = 1000000;
+// A 60 Hz display.
+constexpr uint64_t kRefreshNs = 16666667;
+// Far from zero, which OnFrame and OnMainLoopHeartbeat take as "none yet".
+constexpr uint64_t kStartNs = 1000000 * kMs;
+
+FrameTimingOptions TestOptions() {
+  FrameTimingOptions options;
+  options.heartbeat_interval = std::chrono::milliseconds(20);
+  options.stall_threshold = std::chrono::milliseconds(100);
+  options.idle_gap = std::chrono::milliseconds(250);
+  return options;
+}
+
+bool Near(double value, double expected) {
+  return std::fabs(value - expected) < 0.01;
+}
+
+// Heartbeats every 20 ms from |from_ns| up to |to_ns|, as the runner's timer
+// fires while the main loop is free.
+void Heartbeats(FrameTimingMonitor* monitor, uint64_t from_ns,
+                uint64_t to_ns) {
+  for (uint64_t now = from_ns; now <= to_ns; now += 20 * kMs) {
+    monitor->OnMainLoopHeartbeat(now);
+  }
+}
+
+void TestVsyncIntervals() {
+  FrameTimingMonitor monitor(TestOptions());
+  uint64_t now = kStartNs;
+  monitor.OnFrame(now, kRefreshNs);
+  for (int i = 0; i < 10; ++i) {
+    now += kRefreshNs;
+    monitor.OnFrame(now, kRefreshNs);
+  }
+  // Jitter under half a vsync either way is not a miss.
+  now += kRefreshNs * 14 / 10;
+  monitor.OnFrame(now, 0);
+  now += kRefreshNs * 6 / 10;
+  monitor.OnFrame(now, 0);
+  // 1.6 vsyncs rounds to two: one missed. Three vsyncs: two missed.
+  now += kRefreshNs * 16 / 10;
+  monitor.OnFrame(now, 0);
+  now += 3 * kRefreshNs;
+  monitor.OnFrame(now, 0);
+  // A frame time that does not move forward is ignored.
+  monitor.OnFrame(now, 0);
+
+  const FrameTimingSummary summary = monitor.Summarize();
+  CHECK(summary.frames == 14);
+  CHECK(summary.window == 14);
+  CHECK(summary.missed_vsyncs == 3);
+  CHECK(Near(summary.refresh_ms, 16.667));
+  CHECK(Near(summary.p50_ms, 16.666));
+  CHECK(Near(summary.max_ms, 50.0));
+  CHECK(summary.idle_intervals == 0);
+  CHECK(summary.stalls == 0);
+}
+
+// A long interval with the main loop free throughout is idle time: counted,
+// but not a frame and not in the percentiles.
+void TestIdleInterval() {
+  FrameTimingMonitor monitor(TestOptions());
+  uint64_t now = kStartNs;
+  monitor.OnMainLoopHeartbeat(now);
+  monitor.OnFrame(now, kRefreshNs);
+  now += kRefreshNs;
+  monitor.OnFrame(now, kRefreshNs);
+  Heartbeats(&monitor, now, now + 2000 * kMs);
+  now += 2000 * kMs;
+  monitor.OnFrame(now, kRefreshNs);
+
+  const FrameTimingSummary summary = monitor.Summarize();
+  CHECK(summary.frames == 1);
+  CHECK(summary.idle_intervals == 1);
+  CHECK(Near(summary.longest_idle_ms, 2000.0));
+  CHECK(Near(summary.max_ms, 16.666));
+  CHECK(summary.missed_vsyncs == 0);
+}
+
+// A long interval during which a stall ended is jank, with every vsync in it
+// missed.
+void TestStallEndingDuringInterval() {
+  FrameTimingMonitor monitor(TestOptions());
+  uint64_t now = kStartNs;
+  monitor.OnMainLoopHeartbeat(now);
+  monitor.OnFrame(now, kRefreshNs);
+  // The next heartbeat runs 400 ms late: a 400 ms stall.
+  monitor.OnMainLoopHeartbeat(now + 420 * kMs);
+  Heartbeats(&monitor, now + 440 * kMs, now + 500 * kMs);
+  monitor.OnFrame(now + 500 * kMs, kRefreshNs);
+
+  const FrameTimingSummary summary = monitor.Summarize();
+  CHECK(summary.stalls == 1);
+  CHECK(Near(summary.longest_stall_ms, 400.0));
+  CHECK(summary.frames == 1);
+  CHECK(summary.idle_intervals == 0);
+  CHECK(Near(summary.max_ms, 500.0));
+  CHECK(summary.missed_vsyncs == 29);
+}
+
+// A frame painted while heartbeats are overdue, before the stall has ended,
+// also counts as jank.
+void TestStallInProgress() {
+  FrameTimingMonitor monitor(TestOptions());
+  uint64_t now = kStartNs;
+  monitor.OnMainLoopHeartbeat(now);
+  monitor.OnFrame(now, kRefreshNs);
+  monitor.OnFrame(now + 300 * kMs, kRefreshNs);
+
+  const FrameTimingSummary summary = monitor.Summarize();
+  CHECK(summary.frames == 1);
+  CHECK(summary.idle_intervals == 0);
+  CHECK(summary.stalls == 0);
+}
+
+// A stall that ended before the interval began does not make it jank.
+void TestStallBeforeInterval() {
+  FrameTimingMonitor monitor(TestOptions());
+  uint64_t now = kStartNs;
+  monitor.OnMainLoopHeartbeat(now);
+  monitor.OnMainLoopHeartbeat(now + 300 * kMs);
+  monitor.OnFrame(now + 310 * kMs, kRefreshNs);
+  Heartbeats(&monitor, now + 320 * kMs, now + 1310 * kMs);
+  monitor.OnFrame(now + 1310 * kMs, kRefreshNs);
+
+  const FrameTimingSummary summary = monitor.Summarize();
+  CHECK(summary.stalls == 1);
+  CHECK(summary.frames == 0);
+  CHECK(summary.idle_intervals == 1);
+  CHECK(Near(summary.longest_idle_ms, 1000.0));
+}
+
+// Blocks the main thread past the stall threshold with the watchdog running,
+// twice, so the second request goes through a slot the first one used.
+void TestStallIsSampled() {
+  FrameTimingOptions options = TestOptions();
+  options.stall_threshold = std::chrono::milliseconds(40);
+  FrameTimingMonitor monitor(options);
+  monitor.Start();
+  for (int stall = 1; stall <= 2; ++stall) {
+    monitor.OnMainLoopHeartbeat(MetricsNowNs());
+    std::this_thread::sleep_for(std::chrono::milliseconds(150 * stall));
+    monitor.OnMainLoopHeartbeat(MetricsNowNs());
+    const FrameTimingSummary summary = monitor.Summarize();
+    CHECK(summary.stalls == static_cast<uint64_t>(stall));
+    CHECK(summary.longest_stall_ms > 100.0 * stall);
+    CHECK(!summary.longest_stall_stack.empty());
+  }
+  monitor.Stop();
+
+  const std::string json = monitor.Summarize().ToJson();
+  CHECK(json.find("\"stalls\":2,") != std::string::npos);
+  CHECK(json.find("\"longest_stall_stack\":[\"") != std::string::npos);
+}
+
+}  // namespace
+
+int main() {
+  TestVsyncIntervals();
+  TestIdleInterval();
+  TestStallEndingDuringInterval();
+  TestStallInProgress();
+  TestStallBeforeInterval();
+  TestStallIsSampled();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
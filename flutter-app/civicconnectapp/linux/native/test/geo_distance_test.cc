@@ -0,0 +1,68 @@
+// Checks HaversineDistances against the backend's atan2 form of the formula,
+// computed in double precision for the same coordinates.
+
+#include <cmath>
+#include <cstdio>
+
+#include "native/geo_distance.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+void TestMatchesBackend() {
+  // From one origin, so the whole batch goes through one call: the same
+  // point, a nearby street, one degree north, the antipode and a point a
+  // centimetre east.
+  const double latitudes[] = {12.9716, 12.9352, 13.9716, -12.9716, 12.9716};
+  const double longitudes[] = {77.5946, 77.6245, 77.5946, -102.4054,
+                               77.5946001};
+  const double expected[] = {0.0, 5184.651844857278, 111194.92664455874,
+                             20015086.79602057, 0.010835738662283505};
+  double meters[5];
+  HaversineDistances(12.9716, 77.5946, latitudes, longitudes, 5, meters);
+  for (int i = 0; i < 5; ++i) {
+    if (std::fabs(meters[i] - expected[i]) > 1e-6 * expected[i] + 1e-6) {
+      fprintf(stderr, "point %d: %.9f m, expected %.9f m\n", i, meters[i],
+              expected[i]);
+      ++g_failures;
+    }
+  }
+}
+
+void TestLongDistances() {
+  const double latitude = 40.71;
+  const double longitude = -74.0;
+  double meters;
+  HaversineDistances(51.5, -0.12, &latitude, &longitude, 1, &meters);
+  CHECK(std::fabs(meters - 5570794.265822577) < 1e-3);
+  // Distances are symmetric.
+  const double back_latitude = 51.5;
+  const double back_longitude = -0.12;
+  double back;
+  HaversineDistances(latitude, longitude, &back_latitude, &back_longitude, 1,
+                     &back);
+  CHECK(std::fabs(meters - back) < 1e-6);
+}
+
+}  // namespace
+
+int main() {
+  TestMatchesBackend();
+  TestLongDistances();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,206 @@
+// Checks that every INT8 kernel the CPU supports matches the portable kernel
+// bit for bit, and that quantized convolutions stay close to FP32, on shapes
+// that exercise depth padding, partial row blocks and nonzero zero points.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "native/int8_kernels.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+const Int8Isa kIsas[] = {Int8Isa::kPortable, Int8Isa::kAvx2,
+                         Int8Isa::kAvx512Vnni};
+
+std::vector<float> RandomValues(size_t count, float min, float max,
+                                std::mt19937* random) {
+  std::uniform_real_distribution<float> distribution(min, max);
+  std::vector<float> values(count);
+  for (float& value : values) {
+    value = distribution(*random);
+  }
+  return values;
+}
+
+// Direct FP32 convolution over a CHW tensor with ONNX-layout weights.
+void ReferenceConv(const ConvShape& s, const float* input,
+                   const float* weights, const float* bias, float* output) {
+  for (int o = 0; o < s.out_channels; ++o) {
+    for (int oy = 0; oy < s.out_height(); ++oy) {
+      for (int ox = 0; ox < s.out_width(); ++ox) {
+        double sum = bias[o];
+        for (int c = 0; c < s.in_channels; ++c) {
+          for (int ky = 0; ky < s.kernel; ++ky) {
+            const int iy = oy * s.stride - s.padding + ky;
+            for (int kx = 0; kx < s.kernel; ++kx) {
+              const int ix = ox * s.stride - s.padding + kx;
+              if (iy < 0 || iy >= s.in_height || ix < 0 || ix >= s.in_width) {
+                continue;
+              }
+              sum += static_cast<double>(
+                         weights[((o * s.in_channels + c) * s.kernel + ky) *
+                                     s.kernel +
+                                 kx]) *
+                     input[(c * s.in_height + iy) * s.in_width + ix];
+            }
+          }
+        }
+        output[(o * s.out_height() + oy) * s.out_width() + ox] =
+            static_cast<float>(sum);
+      }
+    }
+  }
+}
+
+// Runs |shape| with inputs in [input_min, input_max] on every supported ISA,
+// checking they agree exactly and that the result is within |tolerance| of
+// FP32, relative to the largest output.
+void CheckConv(const ConvShape& shape, float input_min, float input_max,
+               float tolerance) {
+  std::mt19937 random(shape.depth() * 131 + shape.out_channels);
+  const std::vector<float> input = RandomValues(
+      static_cast<size_t>(shape.in_channels) * shape.in_height *
+          shape.in_width,
+      input_min, input_max, &random);
+  const std::vector<float> weights = RandomValues(
+      static_cast<size_t>(shape.out_channels) * shape.depth(), -0.5f, 0.5f,
+      &random);
+  const std::vector<float> bias =
+      RandomValues(shape.out_channels, -0.2f, 0.2f, &random);
+  const size_t output_size = static_cast<size_t>(shape.out_channels) *
+                             shape.out_height() * shape.out_width();
+
+  std::vector<float> reference(output_size);
+  ReferenceConv(shape, input.data(), weights.data(), bias.data(),
+                reference.data());
+
+  const ActivationQuantization quantization =
+      ActivationQuantizationForRange(input_min, input_max);
+  Int8Conv2d conv(shape, weights.data(), bias.data());
+  CHECK(conv.weights().padded_depth == PadInt8Depth(shape.depth()));
+
+  std::vector<float> portable(output_size);
+  conv.Run(input.data(), quantization, portable.data(), Int8Isa::kPortable);
+  float max_reference = 0.0f;
+  float max_error = 0.0f;
+  for (size_t i = 0; i < output_size; ++i) {
+    max_reference = std::max(max_reference, std::fabs(reference[i]));
+    max_error = std::max(max_error, std::fabs(portable[i] - reference[i]));
+  }
+  CHECK(max_error <= tolerance * max_reference);
+
+  for (const Int8Isa isa : kIsas) {
+    if (isa == Int8Isa::kPortable || !Int8IsaSupported(isa)) {
+      continue;
+    }
+    std::vector<float> output(output_size);
+    conv.Run(input.data(), quantization, output.data(), isa);
+    if (memcmp(output.data(), portable.data(), output_size * sizeof(float)) !=
+        0) {
+      fprintf(stderr, "%s differs from portable for %dx%dx%d\n",
+              Int8IsaName(isa), shape.out_channels, shape.in_channels,
+              shape.kernel);
+      ++g_failures;
+    }
+  }
+}
+
+// The stem: depth 27 padded to 64, six output channels (one block of four
+// plus two single rows) and an odd number of output pixels.
+void TestStemShape() {
+  CheckConv(ConvShape{3, 21, 19, 6, 3, 2, 1}, 0.0f, 1.0f, 0.02f);
+}
+
+// Inputs with negative values give a nonzero zero point, which padding taps
+// and the row sum correction must both honour.
+void TestNonzeroZeroPoint() {
+  const ActivationQuantization quantization =
+      ActivationQuantizationForRange(-1.5f, 4.0f);
+  CHECK(quantization.zero_point > 0);
+  CheckConv(ConvShape{5, 13, 11, 7, 3, 1, 1}, -1.5f, 4.0f, 0.02f);
+}
+
+// Depth larger than one alignment unit and not a multiple of it.
+void TestDeepShape() {
+  CheckConv(ConvShape{17, 9, 10, 9, 3, 1, 0}, -0.3f, 2.0f, 0.02f);
+  CheckConv(ConvShape{64, 5, 5, 3, 1, 1, 0}, -1.0f, 1.0f, 0.02f);
+}
+
+// Int8Gemm directly, with the padding columns of the activations left at
+// zero as Int8Conv2d writes them.
+void TestGemmMatchesIntegerDot() {
+  std::mt19937 random(7);
+  const int rows = 5;
+  const int depth = 27;
+  const int columns = 3;
+  const std::vector<float> weights =
+      RandomValues(static_cast<size_t>(rows) * depth, -1.0f, 1.0f, &random);
+  const Int8Weights quantized = QuantizeWeightsPerChannel(weights.data(), rows,
+                                                          depth);
+  CHECK(quantized.padded_depth == 64);
+  const ActivationQuantization quantization = {0.05f, 17};
+  std::vector<uint8_t> activations(
+      static_cast<size_t>(columns) * quantized.padded_depth, 0);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (int c = 0; c < columns; ++c) {
+    for (int k = 0; k < depth; ++k) {
+      activations[c * quantized.padded_depth + k] =
+          static_cast<uint8_t>(byte(random));
+    }
+  }
+  for (const Int8Isa isa : kIsas) {
+    if (!Int8IsaSupported(isa)) {
+      continue;
+    }
+    std::vector<float> out(static_cast<size_t>(rows) * columns);
+    Int8Gemm(quantized, activations.data(), columns, quantization, nullptr,
+             out.data(), isa);
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < columns; ++c) {
+        int32_t dot = 0;
+        for (int k = 0; k < depth; ++k) {
+          dot += (activations[c * quantized.padded_depth + k] -
+                  quantization.zero_point) *
+                 quantized.values[r * quantized.padded_depth + k];
+        }
+        const float expected =
+            dot * (quantization.scale * quantized.scales[r]);
+        CHECK(out[r * columns + c] == expected);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestStemShape();
+  TestNonzeroZeroPoint();
+  TestDeepShape();
+  TestGemmMatchesIntegerDot();
+  for (const Int8Isa isa : kIsas) {
+    printf("%s: %s\n", Int8IsaName(isa),
+           Int8IsaSupported(isa) ? "tested" : "not supported, skipped");
+  }
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
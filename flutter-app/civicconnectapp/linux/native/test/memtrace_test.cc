@@ -0,0 +1,435 @@
+// Checks the allocation tracer and memtrace_diff. Run without arguments, this
+// runs itself once per tracer scenario with libcivicconnect_memtrace.so
+// preloaded, then runs memtrace_diff on two handwritten snapshots:
+//
+//   weight    Per-tag live bytes estimated from weighted samples match what
+//             was allocated, for blocks far smaller and far larger than the
+//             sample interval, and freeing removes them.
+//   overflow  Once the site table is full, further sites are counted in the
+//             "overflow" site.
+//   threads   Byte counts a thread has not yet published are flushed when it
+//             exits.
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MEMTRACE_LIBRARY_PATH
+#error "MEMTRACE_LIBRARY_PATH must name libcivicconnect_memtrace.so"
+#endif
+#ifndef MEMTRACE_DIFF_PATH
+#error "MEMTRACE_DIFF_PATH must name the memtrace_diff tool"
+#endif
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+// --- Scenarios, run with the tracer preloaded -------------------------------
+
+using SetTagFunction = const char* (*)(const char*);
+using SnapshotFunction = int (*)();
+
+struct Tracer {
+  SetTagFunction set_tag = nullptr;
+  SnapshotFunction snapshot = nullptr;
+  std::string directory;
+  int snapshots = 0;
+};
+
+// What a scenario reads back from a snapshot.
+struct SnapshotSummary {
+  int64_t live_bytes = -1;
+  std::map<std::string, int64_t> tags;
+};
+
+// Writes a snapshot and reads back its heap total and tags.
+SnapshotSummary TakeSnapshot(Tracer* tracer) {
+  SnapshotSummary summary;
+  if (tracer->snapshot() != 0) {
+    fprintf(stderr, "civic_memtrace_snapshot failed\n");
+    ++g_failures;
+    return summary;
+  }
+  char path[600];
+  snprintf(path, sizeof(path), "%s/memtrace-%d-%04d.txt",
+           tracer->directory.c_str(), static_cast<int>(getpid()),
+           tracer->snapshots++);
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string kind;
+    fields >> kind;
+    if (kind == "heap") {
+      std::string name;
+      fields >> name >> summary.live_bytes;
+    } else if (kind == "tag") {
+      std::string name;
+      int64_t bytes = 0;
+      fields >> name >> bytes;
+      summary.tags[name] = bytes;
+    }
+  }
+  return summary;
+}
+
+int64_t TagBytes(const SnapshotSummary& summary, const char* tag) {
+  const auto it = summary.tags.find(tag);
+  return it == summary.tags.end() ? 0 : it->second;
+}
+
+// Keeps |ptr| from being optimized away with the allocation.
+void Keep(void* ptr) {
+  asm volatile("" : : "r"(ptr) : "memory");
+}
+
+// Run with a 64 KiB sample interval.
+void RunWeight(Tracer* tracer) {
+  constexpr int kSmallBlocks = 20000;
+  constexpr size_t kSmallSize = 1000;
+  constexpr int kLargeBlocks = 8;
+  constexpr size_t kLargeSize = 4 << 20;
+  std::vector<void*> blocks;
+  blocks.reserve(kSmallBlocks + kLargeBlocks);
+
+  tracer->set_tag("weight_small");
+  size_t small_bytes = 0;
+  for (int i = 0; i < kSmallBlocks; ++i) {
+    void* block = malloc(kSmallSize);
+    Keep(block);
+    small_bytes += malloc_usable_size(block);
+    blocks.push_back(block);
+  }
+  tracer->set_tag("weight_large");
+  size_t large_bytes = 0;
+  for (int i = 0; i < kLargeBlocks; ++i) {
+    void* block = malloc(kLargeSize);
+    Keep(block);
+    large_bytes += malloc_usable_size(block);
+    blocks.push_back(block);
+  }
+  tracer->set_tag(nullptr);
+
+  const SnapshotSummary live = TakeSnapshot(tracer);
+  // About 300 samples of the small blocks, so within 20% with a wide margin.
+  const double small = static_cast<double>(TagBytes(live, "weight_small"));
+  CHECK(small > 0.8 * small_bytes && small < 1.2 * small_bytes);
+  // Blocks 64 times the interval are sampled with probability 1 - e^-64 and
+  // weighted by their size.
+  const double large = static_cast<double>(TagBytes(live, "weight_large"));
+  CHECK(large > 0.99 * large_bytes && large < 1.01 * large_bytes);
+  // Live bytes are exact.
+  CHECK(live.live_bytes >= static_cast<int64_t>(small_bytes + large_bytes));
+
+  for (void* block : blocks) {
+    free(block);
+  }
+  const SnapshotSummary freed = TakeSnapshot(tracer);
+  CHECK(TagBytes(freed, "weight_small") == 0);
+  CHECK(TagBytes(freed, "weight_large") == 0);
+  CHECK(freed.live_bytes <=
+        live.live_bytes - static_cast<int64_t>(small_bytes + large_bytes) +
+            (1 << 20));
+}
+
+// Run with every allocation sampled, so each tag is a new site.
+void RunOverflow(Tracer* tracer) {
+  constexpr int kTags = 17000;  // More than the 16384 site table entries.
+  static char names[kTags][8];
+  std::vector<void*> blocks(kTags);
+  for (int i = 0; i < kTags; ++i) {
+    snprintf(names[i], sizeof(names[i]), "t%05d", i);
+  }
+  for (int i = 0; i < kTags; ++i) {
+    tracer->set_tag(names[i]);
+    blocks[i] = malloc(64);
+    Keep(blocks[i]);
+  }
+  tracer->set_tag(nullptr);
+
+  const SnapshotSummary summary = TakeSnapshot(tracer);
+  int tagged = 0;
+  for (const auto& tag : summary.tags) {
+    tagged += tag.first.size() == 6 && tag.first[0] == 't' ? 1 : 0;
+  }
+  CHECK(tagged > 0 && tagged < kTags);
+  // The tags that found no site are all in the overflow site, with at least
+  // their 64 bytes each.
+  CHECK(TagBytes(summary, "overflow") >= int64_t{64} * (kTags - tagged));
+  for (void* block : blocks) {
+    free(block);
+  }
+}
+
+// Run with a sample interval large enough that nothing is sampled.
+void RunThreads(Tracer* tracer) {
+  constexpr int kThreads = 8;
+  // Below the 256 KiB at which a thread publishes its counts.
+  constexpr size_t kThreadBytes = 100 * 1024;
+  constexpr size_t kBlockSize = 1024;
+  constexpr size_t kBlocks = kThreadBytes / kBlockSize;
+  std::vector<std::vector<void*>> kept(kThreads);
+  std::vector<std::vector<void*>> handed(kThreads);
+  for (std::vector<void*>& blocks : handed) {
+    for (size_t i = 0; i < kBlocks; ++i) {
+      blocks.push_back(malloc(kBlockSize));
+    }
+  }
+
+  const SnapshotSummary before = TakeSnapshot(tracer);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&kept, t] {
+      kept[t].reserve(kBlocks);
+      for (size_t i = 0; i < kBlocks; ++i) {
+        kept[t].push_back(malloc(kBlockSize));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const SnapshotSummary grown = TakeSnapshot(tracer);
+  CHECK(grown.live_bytes - before.live_bytes >=
+        static_cast<int64_t>(kThreads * kThreadBytes));
+
+  // Frees on threads that exit before publishing them.
+  threads.clear();
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&handed, t] {
+      for (void* block : handed[t]) {
+        free(block);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const SnapshotSummary shrunk = TakeSnapshot(tracer);
+  CHECK(grown.live_bytes - shrunk.live_bytes >=
+        static_cast<int64_t>(kThreads * kThreadBytes));
+
+  for (std::vector<void*>& blocks : kept) {
+    for (void* block : blocks) {
+      free(block);
+    }
+  }
+}
+
+int RunScenario(const char* scenario) {
+  Tracer tracer;
+  tracer.set_tag = reinterpret_cast<SetTagFunction>(
+      dlsym(RTLD_DEFAULT, "civic_memtrace_set_tag"));
+  tracer.snapshot = reinterpret_cast<SnapshotFunction>(
+      dlsym(RTLD_DEFAULT, "civic_memtrace_snapshot"));
+  const char* directory = getenv("CIVICCONNECT_MEMTRACE");
+  if (tracer.set_tag == nullptr || tracer.snapshot == nullptr ||
+      directory == nullptr) {
+    fprintf(stderr, "%s: the tracer is not preloaded\n", scenario);
+    return 1;
+  }
+  tracer.directory = directory;
+  if (strcmp(scenario, "weight") == 0) {
+    RunWeight(&tracer);
+  } else if (strcmp(scenario, "overflow") == 0) {
+    RunOverflow(&tracer);
+  } else if (strcmp(scenario, "threads") == 0) {
+    RunThreads(&tracer);
+  } else {
+    fprintf(stderr, "unknown scenario %s\n", scenario);
+    return 1;
+  }
+  return g_failures == 0 ? 0 : 1;
+}
+
+// --- Driver -----------------------------------------------------------------
+
+// Runs this executable for |scenario| with the tracer preloaded, writing
+// snapshots to |directory|.
+bool SpawnScenario(const char* scenario, const char* sample_bytes,
+                   const std::string& directory) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    setenv("LD_PRELOAD", MEMTRACE_LIBRARY_PATH, 1);
+    setenv("CIVICCONNECT_MEMTRACE", directory.c_str(), 1);
+    setenv("CIVICCONNECT_MEMTRACE_SAMPLE_BYTES", sample_bytes, 1);
+    // No periodic snapshots to get in the way of the numbered ones.
+    setenv("CIVICCONNECT_MEMTRACE_INTERVAL", "100000", 1);
+    execl("/proc/self/exe", "memtrace_test", scenario,
+          static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+    return false;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "scenario %s failed\n", scenario);
+    return false;
+  }
+  return true;
+}
+
+void WriteFile(const std::string& path, const char* contents) {
+  std::ofstream file(path);
+  file << contents;
+}
+
+// Runs memtrace_diff with |arguments|, returning its output and exit status.
+std::string RunDiff(const std::string& arguments, int* status) {
+  const std::string command =
+      std::string(MEMTRACE_DIFF_PATH) + " " + arguments + " 2>/dev/null";
+  FILE* pipe = popen(command.c_str(), "r");
+  std::string output;
+  char buffer[4096];
+  size_t length;
+  while (pipe != nullptr &&
+         (length = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    output.append(buffer, length);
+  }
+  const int result = pipe != nullptr ? pclose(pipe) : -1;
+  *status = WIFEXITED(result) ? WEXITSTATUS(result) : -1;
+  return output;
+}
+
+// Returns the first line of |text| starting with |prefix|, or "".
+std::string LineStartingWith(const std::string& text,
+                             const std::string& prefix) {
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (line.compare(0, prefix.size(), prefix) == 0) {
+      return line;
+    }
+  }
+  return std::string();
+}
+
+bool Contains(const std::string& text, const std::string& part) {
+  return text.find(part) != std::string::npos;
+}
+
+const char kBeforeSnapshot[] =
+    "memtrace 1\n"
+    "pid 10\n"
+    "time_ms 1000\n"
+    "sample_interval 524288\n"
+    "smaps rss_kb 1000 pss_kb 900 anonymous_kb 500 private_dirty_kb 400 "
+    "swap_kb 0 peak_rss_kb 1200\n"
+    "heap live_bytes 1048576 peak_live_bytes 2097152 allocated_bytes 4194304 "
+    "freed_bytes 3145728 dropped_samples 2\n"
+    "tag dart 524288\n"
+    "tag gtk 1024\n"
+    "site 00000000000000a1 524288 4 dart libapp.so+0x10:Alloc;libapp.so+0x20\n"
+    "site 00000000000000b1 2048 1 gtk libgtk-3.so.0+0x30\n";
+
+const char kAfterSnapshot[] =
+    "memtrace 1\n"
+    "pid 10\n"
+    "time_ms 61000\n"
+    "sample_interval 524288\n"
+    "smaps rss_kb 3048 pss_kb 2948 anonymous_kb 2548 private_dirty_kb 2448 "
+    "swap_kb 0 peak_rss_kb 3048\n"
+    "heap live_bytes 3145728 peak_live_bytes 3145728 allocated_bytes 8388608 "
+    "freed_bytes 5242880 dropped_samples 5\n"
+    "tag dart 2621440\n"
+    "tag runner 4096\n"
+    "site 00000000000000a1 2621440 20 dart "
+    "libapp.so+0x10:Alloc;libapp.so+0x20\n"
+    "site 00000000000000c1 4096 2 runner civicconnectapp+0x40\n";
+
+void TestDiff(const std::string& directory) {
+  const std::string before = directory + "/before.txt";
+  const std::string after = directory + "/after.txt";
+  const std::string other = directory + "/other.txt";
+  WriteFile(before, kBeforeSnapshot);
+  WriteFile(after, kAfterSnapshot);
+  WriteFile(other, "not a snapshot\n");
+
+  int status = 0;
+  const std::string output = RunDiff(before + " " + after, &status);
+  CHECK(status == 0);
+  CHECK(Contains(output, "interval 60.0 s"));
+  CHECK(Contains(LineStartingWith(output, "smaps.rss_kb "), "+2.0 MiB"));
+  CHECK(Contains(LineStartingWith(output, "heap.live_bytes "), "+2.0 MiB"));
+  CHECK(Contains(LineStartingWith(output, "heap.dropped_samples "), "+3"));
+  // Tags on one side only count as zero on the other.
+  CHECK(Contains(LineStartingWith(output, "dart "), "+2.0 MiB"));
+  CHECK(Contains(LineStartingWith(output, "gtk "), "-1.0 KiB"));
+  CHECK(Contains(LineStartingWith(output, "runner "), "+4.0 KiB"));
+  // Sites by size of change, each with its frames.
+  const size_t grown = output.find("+2.0 MiB  00000000000000a1  dart");
+  const size_t added = output.find("+4.0 KiB  00000000000000c1  runner");
+  const size_t gone = output.find("-2.0 KiB  00000000000000b1  gtk");
+  CHECK(grown != std::string::npos && added != std::string::npos &&
+        gone != std::string::npos);
+  CHECK(grown < added && added < gone);
+  CHECK(Contains(output, "    libapp.so+0x10:Alloc;libapp.so+0x20\n"));
+
+  const std::string top = RunDiff("--top 1 " + before + " " + after, &status);
+  CHECK(Contains(top, "00000000000000a1"));
+  CHECK(!Contains(top, "00000000000000c1"));
+
+  RunDiff(before + " " + other, &status);
+  CHECK(status == 1);
+  RunDiff(before, &status);
+  CHECK(status == 2);
+}
+
+void RemoveDirectory(const std::string& directory) {
+  if (DIR* dir = opendir(directory.c_str())) {
+    while (dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        unlink((directory + "/" + entry->d_name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc == 2) {
+    return RunScenario(argv[1]);
+  }
+  char directory[] = "/tmp/memtrace_test.XXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    perror("mkdtemp");
+    return 1;
+  }
+  CHECK(SpawnScenario("weight", "65536", directory));
+  CHECK(SpawnScenario("overflow", "1", directory));
+  CHECK(SpawnScenario("threads", "1073741824", directory));
+  TestDiff(directory);
+  RemoveDirectory(directory);
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
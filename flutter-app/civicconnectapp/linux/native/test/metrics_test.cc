@@ -0,0 +1,192 @@
+// Checks histogram bucketing and quantiles, merging and reuse of per-thread
+// shards, and the Prometheus text the registry writes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native/metrics.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+              #condition);                                            \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+bool Contains(const std::string& text, const std::string& line) {
+  return text.find(line) != std::string::npos;
+}
+
+// Every bucket's first and last value map back to it, and buckets tile the
+// value range with no gaps.
+void TestBucketRoundTrip() {
+  uint64_t lower = 0;
+  for (int index = 0; index < Histogram::kBucketCount; ++index) {
+    const uint64_t limit = Histogram::BucketLimit(index);
+    CHECK(limit > lower);
+    if (Histogram::BucketIndex(lower) != index ||
+        Histogram::BucketIndex(limit - 1) != index) {
+      fprintf(stderr, "bucket %d [%llu, %llu) does not round-trip\n", index,
+              static_cast<unsigned long long>(lower),
+              static_cast<unsigned long long>(limit));
+      ++g_failures;
+      return;
+    }
+    // Past the exact buckets, a bucket is at most 1/32 of its lower bound.
+    if (lower >= 64) {
+      CHECK((limit - lower) * 32 <= lower);
+    }
+    lower = limit;
+  }
+  CHECK(Histogram::BucketIndex(Histogram::kMaxValue) ==
+        Histogram::kBucketCount - 1);
+}
+
+void TestQuantileAccuracy() {
+  Histogram* histogram = MetricsRegistry::Get()->GetHistogram(
+      "test_quantile_seconds", "Quantile test.");
+  CHECK(histogram != nullptr);
+  std::mt19937_64 random(3);
+  // Log-uniform from 1 us to 1 s, like request latencies.
+  std::uniform_real_distribution<double> exponent(3.0, 9.0);
+  std::vector<uint64_t> values(50000);
+  for (uint64_t& value : values) {
+    value = static_cast<uint64_t>(std::pow(10.0, exponent(random)));
+    histogram->Record(value);
+  }
+  std::sort(values.begin(), values.end());
+  const HistogramSnapshot snapshot = histogram->Snapshot();
+  CHECK(snapshot.count == values.size());
+  CHECK(snapshot.max == values.back());
+  for (double q : {0.01, 0.25, 0.5, 0.9, 0.99, 0.999}) {
+    const uint64_t exact = values[static_cast<size_t>(
+        std::ceil(q * values.size())) - 1];
+    const uint64_t estimate = snapshot.ValueAtQuantile(q);
+    // An upper bound within one bucket, which is at most 1/32 wide.
+    CHECK(estimate >= exact);
+    CHECK(static_cast<double>(estimate - exact) <= exact / 32.0);
+  }
+  CHECK(snapshot.ValueAtQuantile(1.0) == values.back());
+}
+
+void TestShardsMergeAcrossThreads() {
+  Histogram* histogram = MetricsRegistry::Get()->GetHistogram(
+      "test_merge_seconds", "Merge test.");
+  Counter* counter =
+      MetricsRegistry::Get()->GetCounter("test_merge", "Merge test.");
+  constexpr int kThreads = 8;
+  constexpr int kRecords = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([histogram, counter, t] {
+      for (int i = 0; i < kRecords; ++i) {
+        histogram->Record(1000 * (t + 1));
+        counter->Increment(2);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const HistogramSnapshot snapshot = histogram->Snapshot();
+  CHECK(snapshot.count == uint64_t{kThreads} * kRecords);
+  CHECK(snapshot.sum ==
+        uint64_t{kRecords} * 1000 * (kThreads * (kThreads + 1) / 2));
+  CHECK(snapshot.max == 1000 * kThreads);
+  CHECK(counter->Value() == uint64_t{kThreads} * kRecords * 2);
+  const size_t histogram_shards = histogram->ShardCount();
+  const size_t counter_shards = counter->ShardCount();
+  CHECK(histogram_shards >= 1 && histogram_shards <= kThreads);
+  CHECK(counter_shards >= 1 && counter_shards <= kThreads);
+
+  // Threads that come and go take over the shards of exited ones, which keep
+  // their counts.
+  for (int round = 0; round < 50; ++round) {
+    std::thread([histogram, counter] {
+      histogram->Record(5);
+      counter->Increment();
+    }).join();
+  }
+  CHECK(histogram->ShardCount() == histogram_shards);
+  CHECK(counter->ShardCount() == counter_shards);
+  CHECK(histogram->Snapshot().count == uint64_t{kThreads} * kRecords + 50);
+  CHECK(counter->Value() == uint64_t{kThreads} * kRecords * 2 + 50);
+}
+
+void TestPrometheusText() {
+  MetricsRegistry* registry = MetricsRegistry::Get();
+  Histogram* histogram = registry->GetHistogram(
+      "test_export_seconds", "Line one\nback\\slash");
+  CHECK(registry->GetCounter("test_export_seconds", "") == nullptr);
+  // 2 us, 2 us and 3 ms: the first two land under le=2^12 ns.
+  histogram->Record(2000);
+  histogram->Record(2000);
+  histogram->Record(3000000);
+  Counter* counter = registry->GetCounter("test_export_events", "Events.");
+  counter->Increment(7);
+
+  std::string text;
+  registry->WritePrometheusText(1234, &text);
+  CHECK(Contains(text,
+                 "# HELP civicconnect_test_export_seconds "
+                 "Line one\\nback\\\\slash\n"));
+  CHECK(Contains(text, "# TYPE civicconnect_test_export_seconds histogram\n"));
+  CHECK(Contains(text,
+                 "# TYPE civicconnect_test_export_events_total counter\n"));
+  CHECK(Contains(text, "civicconnect_test_export_events_total 7 1234\n"));
+  CHECK(Contains(text,
+                 "civicconnect_test_export_seconds_bucket{le=\"1.024e-06\"} "
+                 "0 1234\n"));
+  CHECK(Contains(text,
+                 "civicconnect_test_export_seconds_bucket{le=\"4.096e-06\"} "
+                 "2 1234\n"));
+  CHECK(Contains(text,
+                 "civicconnect_test_export_seconds_bucket{le=\"0.004194304\"} "
+                 "3 1234\n"));
+  CHECK(Contains(text,
+                 "civicconnect_test_export_seconds_bucket{le=\"+Inf\"} "
+                 "3 1234\n"));
+  CHECK(Contains(text, "civicconnect_test_export_seconds_sum 0.003004 1234\n"));
+  CHECK(Contains(text, "civicconnect_test_export_seconds_count 3 1234\n"));
+
+  // Buckets are cumulative, so never decrease.
+  const std::string prefix = "civicconnect_test_export_seconds_bucket{le=\"";
+  uint64_t previous = 0;
+  int buckets = 0;
+  for (size_t at = text.find(prefix); at != std::string::npos;
+       at = text.find(prefix, at + 1)) {
+    const size_t value = text.find("} ", at) + 2;
+    const uint64_t cumulative = std::stoull(text.substr(value));
+    CHECK(cumulative >= previous);
+    previous = cumulative;
+    ++buckets;
+  }
+  CHECK(buckets == 17);
+  CHECK(previous == 3);
+}
+
+}  // namespace
+
+int main() {
+  TestBucketRoundTrip();
+  TestQuantileAccuracy();
+  TestShardsMergeAcrossThreads();
+  TestPrometheusText();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
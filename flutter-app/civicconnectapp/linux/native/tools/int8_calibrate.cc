@@ -0,0 +1,516 @@
+// Post-training INT8 calibration and evaluation for a YOLO convolution layer.
+//
+// Computes quantization parameters for one convolution from a folder of
+// calibration inputs, then measures the quantized layer's output against the
+// FP32 layer on a separate held-out folder:
+//
+//   int8_calibrate --weights conv.f32 --shape 32,16,3,2,1 [--bias conv_b.f32]
+//                  --calibration acts/calib --holdout acts/holdout
+//                  [--activations] [--input-size 320] [--output conv.int8.txt]
+//
+// --shape is out_channels,in_channels,kernel[,stride,padding]. Weight and bias
+// files are raw little-endian float32 in ONNX layout, e.g. dumped from the
+// exported model with numpy's tofile().
+//
+// With --activations the folders hold the layer's input as dumped from the
+// FP32 model for each field photo: one *.f32 file per photo with in_channels x
+// input_size x input_size float32 values in CHW order. Without it they hold
+// the JPEG photos themselves, which only fits the stem convolution
+// (in_channels 3); its input range is fixed by preprocessing to [0, 1], so
+// only the output ranges depend on the photos.
+//
+// The error report compares this layer's outputs only. It is not a change in
+// detection accuracy, which depends on every quantized layer downstream.
+//
+// Latency is reported for packing (im2col, plus quantization for INT8) and the
+// GEMM separately, with speedups for the GEMM alone and for both.
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "native/image_preprocess.h"
+#include "native/int8_kernels.h"
+#include "native/jpeg_codec.h"
+
+namespace {
+
+// Channels of the tensor LoadImageTensor builds from a photo.
+constexpr int kImageChannels = 3;
+
+struct Options {
+  std::string weights_path;
+  std::string bias_path;
+  std::string calibration_dir;
+  std::string holdout_dir;
+  std::string output_path = "int8_calibration.txt";
+  ConvShape shape = {};
+  int input_size = 640;
+  // Whether the folders hold dumped activations rather than photos.
+  bool activations = false;
+};
+
+struct Range {
+  float min = std::numeric_limits<float>::max();
+  float max = std::numeric_limits<float>::lowest();
+
+  void Add(const float* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      min = std::min(min, values[i]);
+      max = std::max(max, values[i]);
+    }
+  }
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "usage: int8_calibrate --weights FILE --shape OUT,IN,K[,S,P] "
+          "[--bias FILE]\n"
+          "                      --calibration DIR --holdout DIR "
+          "[--activations]\n"
+          "                      [--input-size N] [--output FILE]\n");
+}
+
+bool ParseShape(const char* text, ConvShape* shape) {
+  int values[5] = {0, 0, 0, 1, 0};
+  const int count = sscanf(text, "%d,%d,%d,%d,%d", &values[0], &values[1],
+                           &values[2], &values[3], &values[4]);
+  if (count < 3 || values[0] <= 0 || values[1] <= 0 || values[2] <= 0 ||
+      values[3] <= 0 || values[4] < 0) {
+    return false;
+  }
+  shape->out_channels = values[0];
+  shape->in_channels = values[1];
+  shape->kernel = values[2];
+  shape->stride = values[3];
+  shape->padding = values[4];
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* flag = argv[i];
+    if (strcmp(flag, "--activations") == 0) {
+      options->activations = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(flag, "--weights") == 0) {
+      options->weights_path = value;
+    } else if (strcmp(flag, "--bias") == 0) {
+      options->bias_path = value;
+    } else if (strcmp(flag, "--calibration") == 0) {
+      options->calibration_dir = value;
+    } else if (strcmp(flag, "--holdout") == 0) {
+      options->holdout_dir = value;
+    } else if (strcmp(flag, "--output") == 0) {
+      options->output_path = value;
+    } else if (strcmp(flag, "--input-size") == 0) {
+      options->input_size = atoi(value);
+    } else if (strcmp(flag, "--shape") == 0) {
+      if (!ParseShape(value, &options->shape)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (options->weights_path.empty() || options->shape.kernel <= 0 ||
+      options->calibration_dir.empty() || options->holdout_dir.empty() ||
+      options->input_size <= 0) {
+    return false;
+  }
+  if (!options->activations &&
+      options->shape.in_channels != kImageChannels) {
+    fprintf(stderr,
+            "error: photos have %d channels; pass --activations to calibrate "
+            "a layer with %d input channels\n",
+            kImageChannels, options->shape.in_channels);
+    return false;
+  }
+  return true;
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool ReadFloats(const std::string& path, size_t count,
+                std::vector<float>* values) {
+  std::vector<uint8_t> bytes;
+  if (!ReadFile(path, &bytes) || bytes.size() != count * sizeof(float)) {
+    return false;
+  }
+  values->resize(count);
+  memcpy(values->data(), bytes.data(), bytes.size());
+  return true;
+}
+
+bool HasExtension(const std::string& name,
+                  std::initializer_list<const char*> extensions) {
+  const size_t dot = name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  for (const char* candidate : extensions) {
+    if (extension == candidate) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Lists the photos in |dir|, or the *.f32 activation dumps if |activations|.
+std::vector<std::string> ListInputs(const std::string& dir, bool activations) {
+  std::vector<std::string> paths;
+  DIR* handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    return paths;
+  }
+  while (dirent* entry = readdir(handle)) {
+    if (activations ? HasExtension(entry->d_name, {"f32"})
+                    : HasExtension(entry->d_name, {"jpg", "jpeg"})) {
+      paths.push_back(dir + "/" + entry->d_name);
+    }
+  }
+  closedir(handle);
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+// Decodes |path| and preprocesses it into a kImageChannels x size x size
+// tensor.
+bool LoadImageTensor(const std::string& path, int size,
+                     std::vector<float>* tensor) {
+  std::vector<uint8_t> jpeg;
+  int width = 0;
+  int height = 0;
+  if (!ReadFile(path, &jpeg) ||
+      !ReadJpegSize(jpeg.data(), jpeg.size(), &width, &height)) {
+    return false;
+  }
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  RgbaImage image{pixels.data(), width, height, static_cast<size_t>(width) * 4};
+  if (!DecodeJpeg(jpeg.data(), jpeg.size(), image)) {
+    return false;
+  }
+  tensor->resize(static_cast<size_t>(kImageChannels) * size * size);
+  ResizeToChwTensor(image, size, size, tensor->data());
+  return true;
+}
+
+// Loads the layer input for one calibration or held-out sample.
+bool LoadInput(const Options& options, const std::string& path,
+               std::vector<float>* tensor) {
+  if (!options.activations) {
+    return LoadImageTensor(path, options.input_size, tensor);
+  }
+  const ConvShape& shape = options.shape;
+  return ReadFloats(path,
+                    static_cast<size_t>(shape.in_channels) * shape.in_height *
+                        shape.in_width,
+                    tensor);
+}
+
+// The FP32 baseline: the same im2col + GEMM formulation as Int8Conv2d, in
+// float. Fp32Im2col lays out the patches and Fp32Gemm multiplies them.
+void Fp32Im2col(const ConvShape& s, const float* input,
+                std::vector<float>* patches) {
+  const int out_height = s.out_height();
+  const int out_width = s.out_width();
+  const int columns = out_height * out_width;
+  const int depth = s.depth();
+  patches->resize(static_cast<size_t>(columns) * depth);
+  float* patch = patches->data();
+  for (int oy = 0; oy < out_height; ++oy) {
+    for (int ox = 0; ox < out_width; ++ox) {
+      for (int c = 0; c < s.in_channels; ++c) {
+        const float* plane =
+            input + static_cast<size_t>(c) * s.in_height * s.in_width;
+        for (int ky = 0; ky < s.kernel; ++ky) {
+          const int iy = oy * s.stride - s.padding + ky;
+          for (int kx = 0; kx < s.kernel; ++kx) {
+            const int ix = ox * s.stride - s.padding + kx;
+            const bool inside =
+                iy >= 0 && iy < s.in_height && ix >= 0 && ix < s.in_width;
+            *patch++ = inside ? plane[iy * s.in_width + ix] : 0.0f;
+          }
+        }
+      }
+    }
+  }
+}
+
+void Fp32Gemm(const ConvShape& s, const std::vector<float>& patches,
+              const float* weights, const float* bias, float* output) {
+  const int columns = s.out_height() * s.out_width();
+  const int depth = s.depth();
+  for (int col = 0; col < columns; ++col) {
+    const float* a = patches.data() + static_cast<size_t>(col) * depth;
+    for (int r = 0; r < s.out_channels; ++r) {
+      const float* w = weights + static_cast<size_t>(r) * depth;
+      float sum = bias != nullptr ? bias[r] : 0.0f;
+      for (int k = 0; k < depth; ++k) {
+        sum += w[k] * a[k];
+      }
+      output[static_cast<size_t>(r) * columns + col] = sum;
+    }
+  }
+}
+
+void ConvFp32(const ConvShape& s, const float* input, const float* weights,
+              const float* bias, std::vector<float>* patches, float* output) {
+  Fp32Im2col(s, input, patches);
+  Fp32Gemm(s, *patches, weights, bias, output);
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+struct ErrorStats {
+  double signal = 0.0;
+  double noise = 0.0;
+  double dot = 0.0;
+  double quantized_energy = 0.0;
+  double max_abs = 0.0;
+  double sum_abs = 0.0;
+  size_t count = 0;
+
+  void Add(const float* reference, const float* quantized, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      const double error = static_cast<double>(quantized[i]) - reference[i];
+      signal += static_cast<double>(reference[i]) * reference[i];
+      noise += error * error;
+      dot += static_cast<double>(reference[i]) * quantized[i];
+      quantized_energy += static_cast<double>(quantized[i]) * quantized[i];
+      max_abs = std::max(max_abs, std::fabs(error));
+      sum_abs += std::fabs(error);
+    }
+    count += n;
+  }
+
+  double SqnrDb() const {
+    return noise > 0.0 ? 10.0 * std::log10(signal / noise)
+                       : std::numeric_limits<double>::infinity();
+  }
+  double Cosine() const {
+    return dot / std::sqrt(signal * quantized_energy + 1e-30);
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+  ConvShape& shape = options.shape;
+  shape.in_height = options.input_size;
+  shape.in_width = options.input_size;
+
+  std::vector<float> weights;
+  std::vector<float> bias;
+  const size_t weight_count =
+      static_cast<size_t>(shape.out_channels) * shape.depth();
+  if (!ReadFloats(options.weights_path, weight_count, &weights)) {
+    fprintf(stderr, "error: %s must hold %zu float32 weights\n",
+            options.weights_path.c_str(), weight_count);
+    return 1;
+  }
+  if (!options.bias_path.empty() &&
+      !ReadFloats(options.bias_path, shape.out_channels, &bias)) {
+    fprintf(stderr, "error: %s must hold %d float32 biases\n",
+            options.bias_path.c_str(), shape.out_channels);
+    return 1;
+  }
+  const float* bias_data = bias.empty() ? nullptr : bias.data();
+
+  const size_t plane = static_cast<size_t>(shape.in_height) * shape.in_width;
+  const size_t output_plane =
+      static_cast<size_t>(shape.out_height()) * shape.out_width();
+  const size_t output_size = output_plane * shape.out_channels;
+  std::vector<float> tensor;
+  std::vector<float> patches;
+  std::vector<float> reference(output_size);
+  std::vector<float> quantized(output_size);
+
+  // Calibration: observe input and FP32 output ranges over the samples.
+  const char* const kind = options.activations ? "activation dumps" : "JPEGs";
+  const std::vector<std::string> calibration =
+      ListInputs(options.calibration_dir, options.activations);
+  if (calibration.empty()) {
+    fprintf(stderr, "error: no %s in %s\n", kind,
+            options.calibration_dir.c_str());
+    return 1;
+  }
+  Range input_range;
+  std::vector<Range> input_channels(shape.in_channels);
+  std::vector<Range> output_channels(shape.out_channels);
+  size_t calibrated = 0;
+  for (const std::string& path : calibration) {
+    if (!LoadInput(options, path, &tensor)) {
+      fprintf(stderr, "warning: skipping %s\n", path.c_str());
+      continue;
+    }
+    // The convolution sees every input channel, so the quantization is per
+    // tensor; per-channel input ranges are recorded for inspection.
+    for (int c = 0; c < shape.in_channels; ++c) {
+      input_channels[c].Add(&tensor[c * plane], plane);
+    }
+    input_range.Add(tensor.data(), tensor.size());
+    ConvFp32(shape, tensor.data(), weights.data(), bias_data, &patches,
+             reference.data());
+    for (int c = 0; c < shape.out_channels; ++c) {
+      output_channels[c].Add(&reference[c * output_plane], output_plane);
+    }
+    ++calibrated;
+  }
+  if (calibrated == 0) {
+    fprintf(stderr, "error: no readable %s in %s\n", kind,
+            options.calibration_dir.c_str());
+    return 1;
+  }
+
+  const ActivationQuantization input_quantization =
+      ActivationQuantizationForRange(input_range.min, input_range.max);
+  Int8Conv2d conv(shape, weights.data(), bias_data);
+
+  FILE* out = fopen(options.output_path.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "error: cannot write %s\n", options.output_path.c_str());
+    return 1;
+  }
+  fprintf(out, "# int8 calibration from %zu %s in %s\n", calibrated, kind,
+          options.calibration_dir.c_str());
+  fprintf(out, "input %.9g %d\n", input_quantization.scale,
+          input_quantization.zero_point);
+  for (int c = 0; c < shape.in_channels; ++c) {
+    fprintf(out, "input_channel %d %.9g %.9g\n", c, input_channels[c].min,
+            input_channels[c].max);
+  }
+  for (int c = 0; c < shape.out_channels; ++c) {
+    fprintf(out, "weight_channel %d %.9g\n", c, conv.weights().scales[c]);
+  }
+  // Output ranges become the next layer's input quantization.
+  for (int c = 0; c < shape.out_channels; ++c) {
+    const ActivationQuantization q = ActivationQuantizationForRange(
+        output_channels[c].min, output_channels[c].max);
+    fprintf(out, "output_channel %d %.9g %.9g %.9g %d\n", c,
+            output_channels[c].min, output_channels[c].max, q.scale,
+            q.zero_point);
+  }
+  fclose(out);
+  printf("calibrated on %zu %s, wrote %s\n", calibrated, kind,
+         options.output_path.c_str());
+  if (!options.activations) {
+    printf("note: the stem input is preprocessed to [0, 1], so its "
+           "quantization does not depend on the photos\n");
+  }
+
+  // Evaluation on the held-out set.
+  std::vector<Int8Isa> isas;
+  for (Int8Isa isa :
+       {Int8Isa::kPortable, Int8Isa::kAvx2, Int8Isa::kAvx512Vnni}) {
+    if (Int8IsaSupported(isa)) {
+      isas.push_back(isa);
+    }
+  }
+  ErrorStats errors;
+  // The GEMMs are timed apart from the packing that feeds them: INT8 packing
+  // quantizes and pads the patches, which a fully quantized model would do
+  // once per layer output rather than per convolution.
+  double fp32_im2col_ms = 0.0;
+  double fp32_gemm_ms = 0.0;
+  double int8_pack_ms = 0.0;
+  std::vector<double> int8_gemm_ms(isas.size(), 0.0);
+  bool isas_agree = true;
+  std::vector<float> portable(output_size);
+  size_t evaluated = 0;
+  for (const std::string& path :
+       ListInputs(options.holdout_dir, options.activations)) {
+    if (!LoadInput(options, path, &tensor)) {
+      fprintf(stderr, "warning: skipping %s\n", path.c_str());
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    Fp32Im2col(shape, tensor.data(), &patches);
+    fp32_im2col_ms += MillisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    Fp32Gemm(shape, patches, weights.data(), bias_data, reference.data());
+    fp32_gemm_ms += MillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    conv.Pack(tensor.data(), input_quantization);
+    int8_pack_ms += MillisecondsSince(start);
+    for (size_t i = 0; i < isas.size(); ++i) {
+      start = std::chrono::steady_clock::now();
+      conv.Multiply(quantized.data(), isas[i]);
+      int8_gemm_ms[i] += MillisecondsSince(start);
+      // Integer accumulation is exact, so every ISA must match bit for bit.
+      if (i == 0) {
+        portable = quantized;
+      } else if (memcmp(portable.data(), quantized.data(),
+                        output_size * sizeof(float)) != 0) {
+        isas_agree = false;
+      }
+    }
+    errors.Add(reference.data(), quantized.data(), output_size);
+    ++evaluated;
+  }
+  if (evaluated == 0) {
+    fprintf(stderr, "error: no readable %s in %s\n", kind,
+            options.holdout_dir.c_str());
+    return 1;
+  }
+
+  printf("\nlayer output error vs fp32 on %zu held-out %s\n", evaluated,
+         kind);
+  printf("  sqnr_db        %.2f\n", errors.SqnrDb());
+  printf("  cosine         %.6f\n", errors.Cosine());
+  printf("  max_abs_error  %.6g\n", errors.max_abs);
+  printf("  mean_abs_error %.6g\n", errors.sum_abs / errors.count);
+  printf("  isas_agree     %s\n", isas_agree ? "yes" : "NO");
+  printf("\nlatency per sample, gemm depth %d (int8 padded to %d)\n",
+         shape.depth(), conv.weights().padded_depth);
+  printf("  %-12s %9s %9s %9s %9s\n", "", "pack ms", "gemm ms", "gemm x",
+         "total x");
+  const double fp32_total_ms = fp32_im2col_ms + fp32_gemm_ms;
+  printf("  %-12s %9.3f %9.3f\n", "fp32", fp32_im2col_ms / evaluated,
+         fp32_gemm_ms / evaluated);
+  for (size_t i = 0; i < isas.size(); ++i) {
+    printf("  %-12s %9.3f %9.3f %8.2fx %8.2fx\n", Int8IsaName(isas[i]),
+           int8_pack_ms / evaluated, int8_gemm_ms[i] / evaluated,
+           fp32_gemm_ms / int8_gemm_ms[i],
+           fp32_total_ms / (int8_pack_ms + int8_gemm_ms[i]));
+  }
+  return isas_agree ? 0 : 1;
+}
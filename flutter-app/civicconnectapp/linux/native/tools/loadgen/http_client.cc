@@ -0,0 +1,317 @@
+#include "native/tools/loadgen/http_client.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Largest response body accepted, to bound memory on a misbehaving server.
+constexpr size_t kMaxBodyBytes = 64 * 1024 * 1024;
+
+bool StartsWithNoCase(const std::string& text, const char* prefix) {
+  const size_t length = strlen(prefix);
+  return text.size() >= length && strncasecmp(text.data(), prefix, length) == 0;
+}
+
+std::string TrimmedValue(const std::string& line, size_t name_length) {
+  size_t start = name_length;
+  while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) {
+    ++start;
+  }
+  return line.substr(start);
+}
+
+}  // namespace
+
+bool HttpUrl::Parse(const std::string& url, HttpUrl* parsed) {
+  const char kScheme[] = "http://";
+  if (url.compare(0, sizeof(kScheme) - 1, kScheme) != 0) {
+    return false;
+  }
+  const size_t host_start = sizeof(kScheme) - 1;
+  const size_t path_start = url.find('/', host_start);
+  const std::string authority = url.substr(
+      host_start, path_start == std::string::npos ? std::string::npos
+                                                  : path_start - host_start);
+  const size_t colon = authority.rfind(':');
+  if (colon == std::string::npos) {
+    parsed->host = authority;
+    parsed->port = 80;
+  } else {
+    parsed->host = authority.substr(0, colon);
+    parsed->port = atoi(authority.c_str() + colon + 1);
+  }
+  parsed->path =
+      path_start == std::string::npos ? std::string() : url.substr(path_start);
+  while (!parsed->path.empty() && parsed->path.back() == '/') {
+    parsed->path.pop_back();
+  }
+  return !parsed->host.empty() && parsed->port > 0 && parsed->port < 65536;
+}
+
+HttpClient::HttpClient(const std::string& host, int port, int timeout_ms)
+    : host_(host), port_(port), timeout_ms_(timeout_ms) {}
+
+HttpClient::~HttpClient() { Close(); }
+
+bool HttpClient::Send(const char* method, const std::string& path,
+                      const std::string& headers,
+                      const std::string& content_type, const std::string& body,
+                      HttpResponse* response, std::string* error) {
+  std::string request;
+  request.reserve(256 + headers.size() + body.size());
+  request.append(method).append(" ").append(path).append(" HTTP/1.1\r\n");
+  request.append("Host: ").append(host_).append("\r\n");
+  request.append("Connection: keep-alive\r\n");
+  request.append(headers);
+  if (!body.empty() || strcmp(method, "POST") == 0 ||
+      strcmp(method, "PUT") == 0) {
+    if (!content_type.empty()) {
+      request.append("Content-Type: ").append(content_type).append("\r\n");
+    }
+    request.append("Content-Length: ")
+        .append(std::to_string(body.size()))
+        .append("\r\n");
+  }
+  request.append("\r\n");
+  request.append(body);
+
+  // A kept-alive connection may have been closed by the server while idle;
+  // retry those once on a fresh connection. The server has then not seen the
+  // request, so this is safe for POSTs too. A timeout or a partial response
+  // means it may have, and is reported instead.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (fd_ < 0 && !Connect(error)) {
+      return false;
+    }
+    const bool reused = reused_;
+    response_started_ = false;
+    closed_by_server_ = false;
+    bool keep_alive = false;
+    if (WriteAll(request, error) &&
+        ReadResponse(response, &keep_alive, error)) {
+      reused_ = keep_alive;
+      if (!keep_alive) {
+        Close();
+      }
+      return true;
+    }
+    Close();
+    if (!reused || response_started_ || !closed_by_server_) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool HttpClient::Connect(std::string* error) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  const std::string port = std::to_string(port_);
+  const int status =
+      getaddrinfo(host_.c_str(), port.c_str(), &hints, &addresses);
+  if (status != 0) {
+    *error = host_ + ": " + gai_strerror(status);
+    return false;
+  }
+  for (addrinfo* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    const int fd = socket(address->ai_family,
+                          address->ai_socktype | SOCK_CLOEXEC,
+                          address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    timeval timeout;
+    timeout.tv_sec = timeout_ms_ / 1000;
+    timeout.tv_usec = (timeout_ms_ % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      fd_ = fd;
+      break;
+    }
+    *error = host_ + ":" + port + ": " + strerror(errno);
+    close(fd);
+  }
+  freeaddrinfo(addresses);
+  buffer_.clear();
+  buffer_start_ = 0;
+  reused_ = false;
+  return fd_ >= 0;
+}
+
+void HttpClient::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  buffer_.clear();
+  buffer_start_ = 0;
+  reused_ = false;
+}
+
+bool HttpClient::WriteAll(const std::string& data, std::string* error) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t result = send(fd_, data.data() + written,
+                                data.size() - written, MSG_NOSIGNAL);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      closed_by_server_ = errno == EPIPE || errno == ECONNRESET;
+      *error = std::string("send: ") + strerror(errno);
+      return false;
+    }
+    written += static_cast<size_t>(result);
+  }
+  return true;
+}
+
+bool HttpClient::Fill(size_t size, std::string* error) {
+  while (buffer_.size() - buffer_start_ < size) {
+    if (buffer_start_ > 0 && buffer_start_ == buffer_.size()) {
+      buffer_.clear();
+      buffer_start_ = 0;
+    }
+    char chunk[16384];
+    const ssize_t result = recv(fd_, chunk, sizeof(chunk), 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      closed_by_server_ = result == 0 || errno == ECONNRESET;
+      *error = result == 0 ? "connection closed"
+               : errno == EAGAIN || errno == EWOULDBLOCK
+                   ? "timed out"
+                   : std::string("recv: ") + strerror(errno);
+      return false;
+    }
+    response_started_ = true;
+    buffer_.append(chunk, static_cast<size_t>(result));
+  }
+  return true;
+}
+
+bool HttpClient::ReadLine(std::string* line, std::string* error) {
+  while (true) {
+    const size_t end = buffer_.find("\r\n", buffer_start_);
+    if (end != std::string::npos) {
+      line->assign(buffer_, buffer_start_, end - buffer_start_);
+      buffer_start_ = end + 2;
+      return true;
+    }
+    if (buffer_.size() - buffer_start_ > 64 * 1024) {
+      *error = "header line too long";
+      return false;
+    }
+    if (!Fill(buffer_.size() - buffer_start_ + 1, error)) {
+      return false;
+    }
+  }
+}
+
+bool HttpClient::ReadResponse(HttpResponse* response, bool* keep_alive,
+                              std::string* error) {
+  std::string line;
+  if (!ReadLine(&line, error)) {
+    return false;
+  }
+  // "HTTP/1.1 200 OK"
+  if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) {
+    *error = "malformed status line";
+    return false;
+  }
+  response->status = atoi(line.c_str() + 9);
+  *keep_alive = line.compare(0, 8, "HTTP/1.1") == 0;
+
+  long long content_length = -1;
+  bool chunked = false;
+  while (true) {
+    if (!ReadLine(&line, error)) {
+      return false;
+    }
+    if (line.empty()) {
+      break;
+    }
+    if (StartsWithNoCase(line, "content-length:")) {
+      content_length = atoll(TrimmedValue(line, 15).c_str());
+    } else if (StartsWithNoCase(line, "transfer-encoding:")) {
+      chunked = TrimmedValue(line, 18).find("chunked") != std::string::npos;
+    } else if (StartsWithNoCase(line, "connection:")) {
+      const std::string value = TrimmedValue(line, 11);
+      if (strncasecmp(value.c_str(), "close", 5) == 0) {
+        *keep_alive = false;
+      } else if (strncasecmp(value.c_str(), "keep-alive", 10) == 0) {
+        *keep_alive = true;
+      }
+    }
+  }
+
+  response->body.clear();
+  if (chunked) {
+    while (true) {
+      if (!ReadLine(&line, error)) {
+        return false;
+      }
+      const size_t size = strtoull(line.c_str(), nullptr, 16);
+      if (size == 0) {
+        // Trailers, if any, end with an empty line.
+        do {
+          if (!ReadLine(&line, error)) {
+            return false;
+          }
+        } while (!line.empty());
+        return true;
+      }
+      if (response->body.size() + size > kMaxBodyBytes) {
+        *error = "response too large";
+        return false;
+      }
+      if (!Fill(size + 2, error)) {
+        return false;
+      }
+      response->body.append(buffer_, buffer_start_, size);
+      buffer_start_ += size + 2;
+    }
+  }
+  if (content_length < 0) {
+    // The body runs to the end of the connection.
+    *keep_alive = false;
+    std::string ignored;
+    while (Fill(buffer_.size() - buffer_start_ + 1, &ignored)) {
+      if (buffer_.size() - buffer_start_ > kMaxBodyBytes) {
+        *error = "response too large";
+        return false;
+      }
+    }
+    response->body.assign(buffer_, buffer_start_, std::string::npos);
+    buffer_start_ = buffer_.size();
+    return true;
+  }
+  if (static_cast<size_t>(content_length) > kMaxBodyBytes) {
+    *error = "response too large";
+    return false;
+  }
+  if (!Fill(static_cast<size_t>(content_length), error)) {
+    return false;
+  }
+  response->body.assign(buffer_, buffer_start_,
+                        static_cast<size_t>(content_length));
+  buffer_start_ += static_cast<size_t>(content_length);
+  return true;
+}
@@ -0,0 +1,70 @@
+#ifndef NATIVE_TOOLS_LOADGEN_HTTP_CLIENT_H_
+#define NATIVE_TOOLS_LOADGEN_HTTP_CLIENT_H_
+
+#include <string>
+
+// An http:// URL split into its parts. |path| keeps any query string and has
+// no trailing slash.
+struct HttpUrl {
+  std::string host;
+  int port = 80;
+  std::string path;
+
+  // Returns false for anything but a well-formed http:// URL.
+  static bool Parse(const std::string& url, HttpUrl* parsed);
+};
+
+struct HttpResponse {
+  int status = 0;
+  std::string body;
+};
+
+// A blocking HTTP/1.1 client over one keep-alive connection, which is opened
+// on first use and reopened after the server closes it. Handles
+// Content-Length and chunked responses. Not thread-safe; the load generator
+// gives each worker its own clients.
+class HttpClient {
+ public:
+  HttpClient(const std::string& host, int port, int timeout_ms);
+  ~HttpClient();
+
+  HttpClient(const HttpClient&) = delete;
+  HttpClient& operator=(const HttpClient&) = delete;
+
+  // Sends a request and waits for the whole response. |headers| holds extra
+  // header lines, each ending in "\r\n"; a body is sent with |content_type|
+  // when non-empty. Returns false with |error| set on connection errors and
+  // timeouts, not on HTTP error statuses.
+  bool Send(const char* method, const std::string& path,
+            const std::string& headers, const std::string& content_type,
+            const std::string& body, HttpResponse* response,
+            std::string* error);
+
+ private:
+  bool Connect(std::string* error);
+  void Close();
+  bool WriteAll(const std::string& data, std::string* error);
+  // Reads until |buffer_| holds at least |size| bytes.
+  bool Fill(size_t size, std::string* error);
+  bool ReadLine(std::string* line, std::string* error);
+  bool ReadResponse(HttpResponse* response, bool* keep_alive,
+                    std::string* error);
+
+  const std::string host_;
+  const int port_;
+  const int timeout_ms_;
+  int fd_ = -1;
+  // Bytes received but not yet consumed.
+  std::string buffer_;
+  size_t buffer_start_ = 0;
+  // Whether the current connection has completed a request, in which case a
+  // failure may just mean the server closed it while idle.
+  bool reused_ = false;
+  // State of the request in flight: whether any response byte has arrived,
+  // and whether the last failure was the server closing or resetting the
+  // connection rather than a timeout or a malformed response.
+  bool response_started_ = false;
+  bool closed_by_server_ = false;
+};
+
+#endif  // NATIVE_TOOLS_LOADGEN_HTTP_CLIENT_H_
@@ -0,0 +1,865 @@
+// Open-loop load generator for the CivicConnect API:
+//
+//   loadgen [--api http://localhost:4000/api] [--rate 50] [--duration 60]
+//           [--warmup 10] [--connections 32]
+//           [--mix submit=1,nearby=6,mine=2,upvote=1] [--users 0]
+//           [--email E --password P] [--images 2] [--image-size 1600x1200]
+//           [--center 18.93,72.83] [--radius 3000] [--upload-url URL]
+//           [--upload-delay-ms 0] [--arrivals uniform|poisson]
+//           [--seed-complaints 0] [--timeout-ms 30000] [--seed 1]
+//           [--json FILE]
+//   loadgen --serve-uploads PORT [--upload-delay-ms 0]
+//
+// Requests are sent on a fixed schedule of --rate operations per second,
+// whether or not earlier ones have finished, and each latency is measured from
+// the time the operation was scheduled to start. When the API falls behind
+// and all connections are busy, the time an operation waits for a free
+// connection counts against it, as it would for a user, rather than being
+// silently left out (coordinated omission). For the same reason failed and
+// timed-out requests keep their latency, and operations still not started
+// when the run ends are dropped and counted as errors with the time they
+// waited.
+//
+// Operations, drawn at random in the proportions given by --mix:
+//   submit  ComplaintController.submitComplaint: uploads --images photos one
+//           after another, then POST /complaints with their URLs.
+//   nearby  GET /complaints/nearby around a random point in the area.
+//   mine    GET /complaints/my-complaints.
+//   upvote  POST /complaints/:id/upvote on a complaint seen earlier in the run.
+//
+// SIGINT or SIGTERM stops scheduling new operations, waits for those in
+// flight and reports what ran so far.
+//
+// Photo uploads go to --upload-url. Without one, a local stand-in for
+// Cloudinary (see upload_server.h) is started so nothing leaves the machine.
+// --serve-uploads runs just the stand-in, for pointing the app at it.
+//
+// Operations are signed in as the seeded citizen, or with --users N as N
+// users registered for the run. Reports count, errors, throughput and latency
+// percentiles, over successes and errors alike, per endpoint; "upload" and "create_complaint" time the single
+// requests within "submit_flow", which times the whole flow.
+
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native/metrics.h"
+#include "native/tools/loadgen/http_client.h"
+#include "native/tools/loadgen/payloads.h"
+#include "native/tools/loadgen/upload_server.h"
+
+namespace {
+
+enum Operation { kSubmit, kNearby, kMine, kUpvote, kOperationCount };
+
+const char* const kOperationNames[kOperationCount] = {"submit", "nearby",
+                                                      "mine", "upvote"};
+
+enum Endpoint {
+  kSubmitFlowEndpoint,
+  kUploadEndpoint,
+  kCreateComplaintEndpoint,
+  kNearbyEndpoint,
+  kMyComplaintsEndpoint,
+  kUpvoteEndpoint,
+  kEndpointCount
+};
+
+const char* const kEndpointNames[kEndpointCount] = {
+    "submit_flow", "upload",        "create_complaint",
+    "nearby",      "my_complaints", "upvote"};
+
+// Operations starting this much after their scheduled time are counted as
+// late: every connection was busy.
+constexpr uint64_t kLateNs = 1000000;
+// Complaint ids kept for upvotes.
+constexpr size_t kMaxComplaintIds = 4096;
+
+// The endpoint that times each operation as a whole.
+const Endpoint kOperationEndpoints[kOperationCount] = {
+    kSubmitFlowEndpoint, kNearbyEndpoint, kMyComplaintsEndpoint,
+    kUpvoteEndpoint};
+
+struct Options {
+  std::string api_url = "http://localhost:4000/api";
+  double rate = 50;
+  double duration_s = 60;
+  double warmup_s = 10;
+  int connections = 32;
+  double mix[kOperationCount] = {1, 6, 2, 1};
+  int users = 0;
+  // The citizen created by prisma/seed.js.
+  std::string email = "citizen1@example.com";
+  std::string password = "Citizen@123";
+  int images = 2;
+  std::string upload_url;
+  std::string upload_preset = "civic_connect_unsigned";
+  int upload_delay_ms = 0;
+  int nearby_radius_m = 1000;
+  bool poisson = false;
+  int seed_complaints = 0;
+  int timeout_ms = 30000;
+  std::string json_path;
+  int serve_uploads_port = -1;
+  PayloadOptions payloads;
+};
+
+struct ScheduledOperation {
+  // From the start of the run.
+  uint64_t offset_ns;
+  Operation operation;
+};
+
+struct EndpointStats {
+  Histogram* latency = nullptr;
+  std::atomic<uint64_t> ok{0};
+  std::atomic<uint64_t> errors{0};
+  std::mutex mutex;
+  std::string first_error;  // Guarded by |mutex|.
+};
+
+// Complaint ids to upvote: seeded from the nearby listing and grown by the
+// complaints the run submits.
+class ComplaintPool {
+ public:
+  void Add(int64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ids_.size() < kMaxComplaintIds) {
+      ids_.push_back(id);
+    } else {
+      ids_[next_++ % kMaxComplaintIds] = id;
+    }
+  }
+
+  bool Pick(Random* random, int64_t* id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ids_.empty()) {
+      return false;
+    }
+    *id = ids_[random->Below(static_cast<int>(ids_.size()))];
+    return true;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ids_.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<int64_t> ids_;  // Guarded by |mutex_|.
+  size_t next_ = 0;           // Guarded by |mutex_|.
+};
+
+struct Run {
+  explicit Run(const Options& options)
+      : options(options), payloads(options.payloads) {}
+
+  const Options& options;
+  HttpUrl api;
+  HttpUrl upload;
+  PayloadGenerator payloads;
+  std::vector<std::string> tokens;
+  ComplaintPool complaints;
+
+  std::vector<ScheduledOperation> schedule;
+  std::atomic<size_t> next{0};
+  uint64_t start_ns = 0;
+  uint64_t warmup_ns = 0;
+  // Operations not started by then are dropped.
+  uint64_t deadline_ns = 0;
+
+  EndpointStats stats[kEndpointCount];
+  std::atomic<uint64_t> late{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> last_end_ns{0};
+  // Set on SIGINT or SIGTERM; operations not started by then are not run.
+  std::atomic<bool> interrupted{false};
+  std::atomic<size_t> not_run{0};
+};
+
+// A worker's connections and random stream.
+struct Worker {
+  Worker(const Run& run, int index)
+      : random(run.options.payloads.seed * 1000003 + index),
+        api(run.api.host, run.api.port, run.options.timeout_ms),
+        upload(run.upload.host, run.upload.port, run.options.timeout_ms),
+        auth_headers("Authorization: Bearer " +
+                     run.tokens[index % run.tokens.size()] + "\r\n") {}
+
+  Random random;
+  HttpClient api;
+  HttpClient upload;
+  const std::string auth_headers;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "usage: loadgen [--api URL] [--rate N] [--duration S] [--warmup S]\n"
+          "               [--connections N] "
+          "[--mix submit=1,nearby=6,mine=2,upvote=1]\n"
+          "               [--users N | --email E --password P] [--images N]\n"
+          "               [--image-size WxH] [--center LAT,LNG] "
+          "[--radius M]\n"
+          "               [--upload-url URL] [--upload-delay-ms N] "
+          "[--arrivals uniform|poisson]\n"
+          "               [--seed-complaints N] [--timeout-ms N] [--seed N] "
+          "[--json FILE]\n"
+          "       loadgen --serve-uploads PORT [--upload-delay-ms N]\n");
+}
+
+bool ParseMix(const char* text, double* mix) {
+  std::fill(mix, mix + kOperationCount, 0.0);
+  std::string remaining = text;
+  while (!remaining.empty()) {
+    const size_t comma = remaining.find(',');
+    const std::string item = remaining.substr(0, comma);
+    remaining =
+        comma == std::string::npos ? std::string() : remaining.substr(comma + 1);
+    const size_t equals = item.find('=');
+    if (equals == std::string::npos) {
+      return false;
+    }
+    const std::string name = item.substr(0, equals);
+    const double weight = atof(item.c_str() + equals + 1);
+    const char* const* found =
+        std::find_if(kOperationNames, kOperationNames + kOperationCount,
+                     [&name](const char* known) { return name == known; });
+    if (found == kOperationNames + kOperationCount || weight < 0) {
+      return false;
+    }
+    mix[found - kOperationNames] = weight;
+  }
+  double total = 0;
+  for (int i = 0; i < kOperationCount; ++i) {
+    total += mix[i];
+  }
+  return total > 0;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* flag = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(flag, "--api") == 0) {
+      options->api_url = value;
+    } else if (strcmp(flag, "--rate") == 0) {
+      options->rate = atof(value);
+    } else if (strcmp(flag, "--duration") == 0) {
+      options->duration_s = atof(value);
+    } else if (strcmp(flag, "--warmup") == 0) {
+      options->warmup_s = atof(value);
+    } else if (strcmp(flag, "--connections") == 0) {
+      options->connections = atoi(value);
+    } else if (strcmp(flag, "--mix") == 0) {
+      if (!ParseMix(value, options->mix)) {
+        return false;
+      }
+    } else if (strcmp(flag, "--users") == 0) {
+      options->users = atoi(value);
+    } else if (strcmp(flag, "--email") == 0) {
+      options->email = value;
+    } else if (strcmp(flag, "--password") == 0) {
+      options->password = value;
+    } else if (strcmp(flag, "--images") == 0) {
+      options->images = atoi(value);
+    } else if (strcmp(flag, "--image-size") == 0) {
+      if (sscanf(value, "%dx%d", &options->payloads.image_width,
+                 &options->payloads.image_height) != 2) {
+        return false;
+      }
+    } else if (strcmp(flag, "--center") == 0) {
+      if (sscanf(value, "%lf,%lf", &options->payloads.center.latitude,
+                 &options->payloads.center.longitude) != 2) {
+        return false;
+      }
+    } else if (strcmp(flag, "--radius") == 0) {
+      options->payloads.radius_m = atof(value);
+    } else if (strcmp(flag, "--upload-url") == 0) {
+      options->upload_url = value;
+    } else if (strcmp(flag, "--upload-delay-ms") == 0) {
+      options->upload_delay_ms = atoi(value);
+    } else if (strcmp(flag, "--arrivals") == 0) {
+      if (strcmp(value, "poisson") == 0) {
+        options->poisson = true;
+      } else if (strcmp(value, "uniform") != 0) {
+        return false;
+      }
+    } else if (strcmp(flag, "--seed-complaints") == 0) {
+      options->seed_complaints = atoi(value);
+    } else if (strcmp(flag, "--timeout-ms") == 0) {
+      options->timeout_ms = atoi(value);
+    } else if (strcmp(flag, "--seed") == 0) {
+      options->payloads.seed = strtoull(value, nullptr, 10);
+    } else if (strcmp(flag, "--json") == 0) {
+      options->json_path = value;
+    } else if (strcmp(flag, "--serve-uploads") == 0) {
+      options->serve_uploads_port = atoi(value);
+    } else {
+      return false;
+    }
+  }
+  if (options->serve_uploads_port >= 0) {
+    return options->serve_uploads_port < 65536;
+  }
+  return options->rate > 0 && options->duration_s > 0 &&
+         options->warmup_s >= 0 && options->connections > 0 &&
+         options->users >= 0 && options->images >= 0 &&
+         options->payloads.image_width > 0 &&
+         options->payloads.image_height > 0 && options->timeout_ms > 0;
+}
+
+// Finds the value of the first "|key|": string in |json|.
+bool JsonStringField(const std::string& json, const char* key,
+                     std::string* value) {
+  const std::string pattern = std::string("\"") + key + "\":\"";
+  size_t at = json.find(pattern);
+  if (at == std::string::npos) {
+    return false;
+  }
+  value->clear();
+  for (at += pattern.size(); at < json.size() && json[at] != '"'; ++at) {
+    if (json[at] == '\\' && at + 1 < json.size()) {
+      ++at;
+    }
+    value->push_back(json[at]);
+  }
+  return at < json.size();
+}
+
+// Appends the integer following each occurrence of |pattern| in |json|.
+void JsonIntegers(const std::string& json, const std::string& pattern,
+                  std::vector<int64_t>* values) {
+  for (size_t at = json.find(pattern); at != std::string::npos;
+       at = json.find(pattern, at + 1)) {
+    const char* digits = json.c_str() + at + pattern.size();
+    if (*digits >= '0' && *digits <= '9') {
+      values->push_back(strtoll(digits, nullptr, 10));
+    }
+  }
+}
+
+bool SignIn(const Run& run, const std::string& email,
+            const std::string& password, bool register_first,
+            std::string* token, std::string* error) {
+  HttpClient client(run.api.host, run.api.port, run.options.timeout_ms);
+  HttpResponse response;
+  const std::string credentials = "\"email\":\"" + JsonEscape(email) +
+                                  "\",\"password\":\"" + JsonEscape(password) +
+                                  "\"";
+  if (register_first) {
+    const std::string body = "{" + credentials +
+                             ",\"full_name\":\"Load Test\","
+                             "\"phone\":\"+91-9000000000\"}";
+    if (!client.Send("POST", run.api.path + "/auth/register", "",
+                     "application/json", body, &response, error)) {
+      return false;
+    }
+    // An existing account from an earlier run is signed in below.
+    if (response.status == 201 &&
+        JsonStringField(response.body, "accessToken", token)) {
+      return true;
+    }
+  }
+  if (!client.Send("POST", run.api.path + "/auth/login", "",
+                   "application/json", "{" + credentials + "}", &response,
+                   error)) {
+    return false;
+  }
+  if (response.status != 200 ||
+      !JsonStringField(response.body, "accessToken", token)) {
+    *error = "login as " + email + " failed with status " +
+             std::to_string(response.status) + ": " + response.body;
+    return false;
+  }
+  return true;
+}
+
+void Record(Run* run, Endpoint endpoint, bool measured, uint64_t start_ns,
+            uint64_t end_ns, bool ok, const std::string& error) {
+  if (!measured) {
+    return;
+  }
+  EndpointStats& stats = run->stats[endpoint];
+  // Failures are timed too: a timeout is part of the tail users see.
+  stats.latency->Record(end_ns - start_ns);
+  if (ok) {
+    stats.ok.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    if (stats.errors.fetch_add(1, std::memory_order_relaxed) == 0) {
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      stats.first_error = error;
+    }
+  }
+}
+
+// Sends one request and records it under |endpoint|, timed from |since_ns|
+// or, if that is 0, from when it is sent. Returns whether it succeeded with
+// |expected_status|.
+bool Request(Run* run, Endpoint endpoint, bool measured, uint64_t since_ns,
+             HttpClient* client, const char* method, const std::string& path,
+             const std::string& headers, const std::string& content_type,
+             const std::string& body, int expected_status,
+             HttpResponse* response) {
+  const uint64_t start_ns = since_ns != 0 ? since_ns : MetricsNowNs();
+  std::string error;
+  bool ok = client->Send(method, path, headers, content_type, body, response,
+                         &error);
+  if (ok && response->status != expected_status) {
+    error = method + (" " + path) + ": status " +
+            std::to_string(response->status) + ": " +
+            response->body.substr(0, 200);
+    ok = false;
+  }
+  Record(run, endpoint, measured, start_ns, MetricsNowNs(), ok, error);
+  return ok;
+}
+
+// Uploads the photos, then creates the complaint. Returns its id, or -1.
+int64_t SubmitComplaint(Run* run, Worker* worker, bool measured,
+                        std::string* error) {
+  std::vector<std::string> image_urls;
+  HttpResponse response;
+  for (int i = 0; i < run->options.images; ++i) {
+    char boundary[48];
+    snprintf(boundary, sizeof(boundary), "--loadgen-%016" PRIx64,
+             worker->random.Next());
+    const std::string body = run->payloads.ImageUpload(
+        &worker->random, boundary, run->options.upload_preset);
+    std::string url;
+    if (!Request(run, kUploadEndpoint, measured, 0, &worker->upload, "POST",
+                 run->upload.path, "",
+                 std::string("multipart/form-data; boundary=") + boundary,
+                 body, 200, &response) ||
+        !JsonStringField(response.body, "secure_url", &url)) {
+      *error = "upload failed";
+      return -1;
+    }
+    image_urls.push_back(url);
+  }
+  std::vector<int64_t> ids;
+  if (!Request(run, kCreateComplaintEndpoint, measured, 0, &worker->api,
+               "POST", run->api.path + "/complaints", worker->auth_headers,
+               "application/json",
+               run->payloads.ComplaintJson(&worker->random, image_urls), 201,
+               &response)) {
+    *error = "POST /complaints failed";
+    return -1;
+  }
+  JsonIntegers(response.body, "\"complaint_id\":", &ids);
+  if (ids.empty()) {
+    *error = "POST /complaints returned no complaint_id";
+    return -1;
+  }
+  run->complaints.Add(ids.front());
+  return ids.front();
+}
+
+std::string NearbyPath(const Run& run, const LatLng& location, int radius_m) {
+  char query[128];
+  snprintf(query, sizeof(query), "/complaints/nearby?lat=%.6f&lng=%.6f&radius=%d",
+           location.latitude, location.longitude, radius_m);
+  return run.api.path + query;
+}
+
+// Adds the complaints in a nearby listing to the upvote pool. Image ids are
+// told apart by the complaint_number that follows a complaint's id.
+void AddListedComplaints(Run* run, const std::string& body) {
+  std::vector<int64_t> ids;
+  JsonIntegers(body, "\"id\":", &ids);
+  size_t at = 0;
+  for (const int64_t id : ids) {
+    const std::string pattern =
+        "\"id\":" + std::to_string(id) + ",\"complaint_number\"";
+    at = body.find(pattern, at);
+    if (at != std::string::npos) {
+      run->complaints.Add(id);
+    } else {
+      at = 0;
+    }
+  }
+}
+
+void RunOperation(Run* run, Worker* worker, Operation operation,
+                  uint64_t intended_ns, bool measured) {
+  HttpResponse response;
+  switch (operation) {
+    case kSubmit: {
+      std::string error;
+      const bool ok = SubmitComplaint(run, worker, measured, &error) >= 0;
+      Record(run, kSubmitFlowEndpoint, measured, intended_ns, MetricsNowNs(),
+             ok, error);
+      return;
+    }
+    case kNearby: {
+      const std::string path =
+          NearbyPath(*run, run->payloads.RandomLocation(&worker->random),
+                     run->options.nearby_radius_m);
+      if (Request(run, kNearbyEndpoint, measured, intended_ns, &worker->api,
+                  "GET", path, "", "", "", 200, &response)) {
+        AddListedComplaints(run, response.body);
+      }
+      return;
+    }
+    case kMine:
+      // The first page of the app's "All" tab.
+      Request(run, kMyComplaintsEndpoint, measured, intended_ns, &worker->api,
+              "GET",
+              run->api.path + "/complaints/my-complaints?page=1&status=all",
+              worker->auth_headers, "", "", 200, &response);
+      return;
+    case kUpvote: {
+      int64_t id;
+      if (!run->complaints.Pick(&worker->random, &id)) {
+        Record(run, kUpvoteEndpoint, measured, intended_ns, MetricsNowNs(),
+               false, "no complaints to upvote; use --seed-complaints");
+        return;
+      }
+      // Toggles: a second upvote by the same user removes the first.
+      Request(run, kUpvoteEndpoint, measured, intended_ns, &worker->api,
+              "POST",
+              run->api.path + "/complaints/" + std::to_string(id) + "/upvote",
+              worker->auth_headers, "application/json", "", 200, &response);
+      return;
+    }
+    case kOperationCount:
+      return;
+  }
+}
+
+// Sleeps until |time_ns|, waking early if the run is interrupted.
+void SleepUntil(const Run& run, uint64_t time_ns) {
+  constexpr uint64_t kSliceNs = 50000000;
+  while (!run.interrupted.load(std::memory_order_relaxed)) {
+    const uint64_t now_ns = MetricsNowNs();
+    if (time_ns <= now_ns) {
+      return;
+    }
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(std::min(time_ns - now_ns, kSliceNs)));
+  }
+}
+
+void WorkerLoop(Run* run, int index) {
+  Worker worker(*run, index);
+  while (true) {
+    const size_t i = run->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= run->schedule.size()) {
+      return;
+    }
+    const ScheduledOperation& scheduled = run->schedule[i];
+    const uint64_t intended_ns = run->start_ns + scheduled.offset_ns;
+    const bool measured = scheduled.offset_ns >= run->warmup_ns;
+    SleepUntil(*run, intended_ns);
+    if (run->interrupted.load(std::memory_order_relaxed)) {
+      run->not_run.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    const uint64_t now_ns = MetricsNowNs();
+    if (now_ns > run->deadline_ns) {
+      run->dropped.fetch_add(1, std::memory_order_relaxed);
+      Record(run, kOperationEndpoints[scheduled.operation], measured,
+             intended_ns, now_ns, false,
+             "dropped: not started before the end of the run");
+      continue;
+    }
+    if (measured && now_ns - intended_ns > kLateNs) {
+      run->late.fetch_add(1, std::memory_order_relaxed);
+    }
+    RunOperation(run, &worker, scheduled.operation, intended_ns, measured);
+    if (measured) {
+      const uint64_t end_ns = MetricsNowNs();
+      uint64_t last = run->last_end_ns.load(std::memory_order_relaxed);
+      while (end_ns > last && !run->last_end_ns.compare_exchange_weak(
+                                  last, end_ns, std::memory_order_relaxed)) {
+      }
+    }
+  }
+}
+
+std::vector<ScheduledOperation> BuildSchedule(const Options& options) {
+  Random random(options.payloads.seed ^ 0x5eed);
+  double total_weight = 0;
+  for (int i = 0; i < kOperationCount; ++i) {
+    total_weight += options.mix[i];
+  }
+  const double interval_s = 1.0 / options.rate;
+  const double end_s = options.warmup_s + options.duration_s;
+  std::vector<ScheduledOperation> schedule;
+  schedule.reserve(static_cast<size_t>(end_s * options.rate) + 1);
+  double time_s = 0;
+  for (size_t n = 0;; ++n) {
+    time_s = options.poisson ? time_s + random.Exponential(interval_s)
+                             : n * interval_s;
+    if (time_s >= end_s) {
+      break;
+    }
+    double pick = random.Uniform() * total_weight;
+    int operation = 0;
+    while (operation + 1 < kOperationCount && pick >= options.mix[operation]) {
+      pick -= options.mix[operation];
+      ++operation;
+    }
+    schedule.push_back(ScheduledOperation{static_cast<uint64_t>(time_s * 1e9),
+                                          static_cast<Operation>(operation)});
+  }
+  return schedule;
+}
+
+double Milliseconds(uint64_t ns) { return ns / 1e6; }
+
+void Report(const Run& run, const Options& options) {
+  const uint64_t window_ns =
+      run.last_end_ns.load() > run.start_ns + run.warmup_ns
+          ? run.last_end_ns.load() - run.start_ns - run.warmup_ns
+          : 1;
+  const double window_s = window_ns / 1e9;
+  printf("\n%-17s %8s %7s %8s %9s %9s %9s %9s %9s\n", "endpoint", "count",
+         "errors", "req/s", "p50 ms", "p90 ms", "p99 ms", "p999 ms", "max ms");
+  std::string json;
+  char line[512];
+  snprintf(line, sizeof(line),
+           "{\n  \"rate\": %g,\n  \"duration_s\": %g,\n  \"warmup_s\": %g,\n"
+           "  \"connections\": %d,\n  \"arrivals\": \"%s\",\n"
+           "  \"late_starts\": %" PRIu64 ",\n  \"dropped\": %" PRIu64
+           ",\n  \"interrupted\": %s,\n  \"not_run\": %zu"
+           ",\n  \"endpoints\": {",
+           options.rate, options.duration_s, options.warmup_s,
+           options.connections, options.poisson ? "poisson" : "uniform",
+           run.late.load(), run.dropped.load(),
+           run.interrupted.load() ? "true" : "false", run.not_run.load());
+  json.append(line);
+  bool first = true;
+  for (int i = 0; i < kEndpointCount; ++i) {
+    const EndpointStats& stats = run.stats[i];
+    const uint64_t ok = stats.ok.load();
+    const uint64_t errors = stats.errors.load();
+    if (ok + errors == 0) {
+      continue;
+    }
+    const HistogramSnapshot snapshot = stats.latency->Snapshot();
+    const double p50 = Milliseconds(snapshot.ValueAtQuantile(0.5));
+    const double p90 = Milliseconds(snapshot.ValueAtQuantile(0.9));
+    const double p99 = Milliseconds(snapshot.ValueAtQuantile(0.99));
+    const double p999 = Milliseconds(snapshot.ValueAtQuantile(0.999));
+    const double max = Milliseconds(snapshot.max);
+    const double throughput = ok / window_s;
+    printf("%-17s %8" PRIu64 " %7" PRIu64
+           " %8.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+           kEndpointNames[i], ok, errors, throughput, p50, p90, p99, p999,
+           max);
+    snprintf(line, sizeof(line),
+             "%s\n    \"%s\": {\"count\": %" PRIu64 ", \"errors\": %" PRIu64
+             ", \"throughput\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+             "\"p99_ms\": %.3f, \"p999_ms\": %.3f, \"max_ms\": %.3f}",
+             first ? "" : ",", kEndpointNames[i], ok, errors, throughput, p50,
+             p90, p99, p999, max);
+    json.append(line);
+    first = false;
+  }
+  json.append("\n  }\n}\n");
+
+  if (run.late.load() > 0) {
+    printf("\n%" PRIu64
+           " operations started over 1 ms late with all %d connections busy; "
+           "their wait is included above. Raise --connections to see the "
+           "API's own queueing.\n",
+           run.late.load(), options.connections);
+  }
+  if (run.dropped.load() > 0) {
+    printf("%" PRIu64
+           " operations were dropped at the end of the run; they count as "
+           "errors with the time they waited.\n",
+           run.dropped.load());
+  }
+  if (run.interrupted.load()) {
+    printf("Interrupted; %zu scheduled operations were not run.\n",
+           run.not_run.load());
+  }
+  for (int i = 0; i < kEndpointCount; ++i) {
+    if (run.stats[i].errors.load() > 0) {
+      printf("%s: first error: %s\n", kEndpointNames[i],
+             run.stats[i].first_error.c_str());
+    }
+  }
+  if (!options.json_path.empty()) {
+    FILE* file = fopen(options.json_path.c_str(), "w");
+    if (file == nullptr || fputs(json.c_str(), file) < 0) {
+      fprintf(stderr, "error: cannot write %s\n", options.json_path.c_str());
+    }
+    if (file != nullptr) {
+      fclose(file);
+    }
+  }
+}
+
+sigset_t TerminationSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  return signals;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+  // Blocked in every thread and taken with sigwait(), by the main thread with
+  // --serve-uploads and by a dedicated thread during a run.
+  const sigset_t signals = TerminationSignals();
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::string error;
+  UploadServer upload_server(options.upload_delay_ms);
+  if (options.serve_uploads_port >= 0) {
+    if (!upload_server.Start(options.serve_uploads_port, &error)) {
+      fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    printf("Serving uploads at http://localhost:%d/v1_1/local/image/upload\n",
+           upload_server.port());
+    fflush(stdout);
+    int signal_number;
+    sigwait(&signals, &signal_number);
+    upload_server.Stop();
+    printf("%" PRIu64 " uploads\n", upload_server.uploads());
+    return 0;
+  }
+
+  Run run(options);
+  if (!HttpUrl::Parse(options.api_url, &run.api)) {
+    fprintf(stderr, "error: --api must be an http:// URL\n");
+    return 2;
+  }
+  if (options.upload_url.empty() && options.images > 0 &&
+      options.mix[kSubmit] > 0) {
+    if (!upload_server.Start(0, &error)) {
+      fprintf(stderr, "error: upload stand-in: %s\n", error.c_str());
+      return 1;
+    }
+    options.upload_url = "http://127.0.0.1:" +
+                         std::to_string(upload_server.port()) +
+                         "/v1_1/local/image/upload";
+    printf("Uploading photos to the local stand-in at %s\n",
+           options.upload_url.c_str());
+  }
+  if (!options.upload_url.empty() &&
+      !HttpUrl::Parse(options.upload_url, &run.upload)) {
+    fprintf(stderr, "error: --upload-url must be an http:// URL\n");
+    return 2;
+  }
+
+  if (options.images > 0 && options.mix[kSubmit] > 0) {
+    if (!run.payloads.GenerateImages(&error)) {
+      fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    printf("Generated %d %dx%d photos, %zu KB on average\n",
+           options.payloads.image_variants, options.payloads.image_width,
+           options.payloads.image_height,
+           run.payloads.image_bytes() / options.payloads.image_variants /
+               1024);
+  }
+
+  for (int i = 0; i < std::max(options.users, 1); ++i) {
+    std::string email = options.email;
+    if (options.users > 0) {
+      char name[96];
+      snprintf(name, sizeof(name), "loadgen.%" PRIu64 ".%d@example.com",
+               options.payloads.seed, i);
+      email = name;
+    }
+    std::string token;
+    if (!SignIn(run, email, options.password, options.users > 0, &token,
+                &error)) {
+      fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    run.tokens.push_back(token);
+  }
+
+  for (int i = 0; i < kEndpointCount; ++i) {
+    run.stats[i].latency = MetricsRegistry::Get()->GetHistogram(
+        std::string("loadgen_") + kEndpointNames[i] + "_latency",
+        "Load generator latency in nanoseconds.");
+  }
+
+  // Complaints to upvote: what is already listed around the centre, plus any
+  // created up front.
+  {
+    Worker worker(run, 0);
+    HttpResponse response;
+    if (worker.api.Send("GET",
+                        NearbyPath(run, options.payloads.center,
+                                   static_cast<int>(
+                                       options.payloads.radius_m * 2)),
+                        "", "", "", &response, &error) &&
+        response.status == 200) {
+      AddListedComplaints(&run, response.body);
+    }
+    for (int i = 0; i < options.seed_complaints; ++i) {
+      if (SubmitComplaint(&run, &worker, false, &error) < 0) {
+        fprintf(stderr, "error: seeding complaints: %s\n", error.c_str());
+        return 1;
+      }
+    }
+    if (options.mix[kUpvote] > 0 && run.complaints.size() == 0) {
+      fprintf(stderr,
+              "warning: no complaints to upvote yet; upvotes fail until a "
+              "submit succeeds\n");
+    }
+  }
+
+  run.schedule = BuildSchedule(options);
+  run.warmup_ns = static_cast<uint64_t>(options.warmup_s * 1e9);
+  printf("Running %zu operations at %g/s for %gs after %gs warmup on %d "
+         "connections\n",
+         run.schedule.size(), options.rate, options.duration_s,
+         options.warmup_s, options.connections);
+  fflush(stdout);
+  run.start_ns = MetricsNowNs();
+  run.deadline_ns = run.start_ns + run.warmup_ns +
+                    static_cast<uint64_t>(options.duration_s * 1e9) +
+                    static_cast<uint64_t>(options.timeout_ms) * 1000000;
+  std::atomic<bool> finished{false};
+  std::thread signal_thread([&run, &signals, &finished] {
+    int signal_number;
+    sigwait(&signals, &signal_number);
+    if (!finished.load()) {
+      run.interrupted.store(true);
+      fprintf(stderr, "\nInterrupted; waiting for requests in flight\n");
+    }
+  });
+  std::vector<std::thread> workers;
+  for (int i = 0; i < options.connections; ++i) {
+    workers.emplace_back(WorkerLoop, &run, i);
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  // Wakes the signal thread if no signal came.
+  finished.store(true);
+  pthread_kill(signal_thread.native_handle(), SIGTERM);
+  signal_thread.join();
+  Report(run, options);
+  return 0;
+}
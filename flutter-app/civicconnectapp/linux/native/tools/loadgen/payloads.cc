@@ -0,0 +1,284 @@
+#include "native/tools/loadgen/payloads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "native/image_types.h"
+#include "native/jpeg_codec.h"
+
+namespace {
+
+constexpr double kEarthRadiusM = 6371e3;
+constexpr double kPi = 3.14159265358979323846;
+
+struct CategoryText {
+  const char* category;
+  const char* titles[3];
+  const char* details[3];
+};
+
+// Category values from the capture screen's dropdown.
+const CategoryText kCategories[] = {
+    {"pothole",
+     {"Deep pothole on main road", "Potholes near bus stop",
+      "Road surface broken after rain"},
+     {"Two-wheelers are swerving into traffic to avoid it.",
+      "Water collects in it and hides how deep it is.",
+      "It has grown over the last two weeks."}},
+    {"garbage",
+     {"Garbage dumped on footpath", "Overflowing garbage bin",
+      "Construction debris left on road"},
+     {"It has not been collected for several days.",
+      "Stray dogs scatter it across the road every night.",
+      "The smell is affecting nearby shops."}},
+    {"streetlight",
+     {"Streetlight not working", "Flickering streetlights on lane",
+      "Lamp post damaged"},
+     {"The stretch is completely dark after 8 pm.",
+      "Residents have complained of safety issues.",
+      "Wires are hanging low from the post."}},
+    {"drainage",
+     {"Drain blocked near junction", "Waterlogging after rain",
+      "Open drain overflowing"},
+     {"Water has been standing on the road since morning.",
+      "Vehicles are splashing pedestrians.",
+      "It is a mosquito breeding risk."}},
+};
+
+const char* const kStreets[] = {
+    "Shahid Bhagat Singh Road", "Colaba Causeway",  "Mint Road",
+    "Marine Drive",             "Grant Road",       "Lamington Road",
+    "Kalbadevi Road",           "Mohammed Ali Road", "Princess Street",
+    "Walchand Hirachand Marg",
+};
+const char* const kAreas[] = {"Colaba", "Fort", "Marine Lines",
+                              "Girgaon", "Grant Road", "Sandhurst Road"};
+const char* const kLandmarks[] = {"Near bus stop",  "Opposite bank",
+                                  "Next to school", "Near signal",
+                                  "Behind market",  ""};
+
+template <typename T, size_t N>
+constexpr int ArraySize(const T (&)[N]) {
+  return static_cast<int>(N);
+}
+
+// Fills |image| with an asphalt-like texture: grey grain, lane markings and a
+// few dark patches. The grain keeps JPEG sizes close to real photos.
+void PaintRoad(const RgbaImage& image, Random* random) {
+  const int base = 90 + random->Below(40);
+  const int tint = random->Below(12);
+  for (int y = 0; y < image.height; ++y) {
+    uint8_t* row = image.Row(y);
+    // Lighting falls off towards the top, as it does in a photo of a road.
+    const int shade = 30 * y / std::max(image.height, 1);
+    for (int x = 0; x < image.width; ++x) {
+      const int grain = static_cast<int>(random->Next() & 31) - 16;
+      const int value = std::min(255, std::max(0, base + shade + grain));
+      row[x * 4 + 0] = static_cast<uint8_t>(std::min(255, value + tint));
+      row[x * 4 + 1] = static_cast<uint8_t>(value);
+      row[x * 4 + 2] = static_cast<uint8_t>(std::max(0, value - tint));
+      row[x * 4 + 3] = 255;
+    }
+  }
+  // A dashed lane marking.
+  const int lane_x = image.width / 3 + random->Below(image.width / 3 + 1);
+  for (int y = 0; y < image.height; ++y) {
+    if ((y / 60) % 2 != 0) {
+      continue;
+    }
+    uint8_t* row = image.Row(y);
+    for (int x = std::max(0, lane_x - 6);
+         x < std::min(image.width, lane_x + 6); ++x) {
+      row[x * 4 + 0] = row[x * 4 + 1] = 230;
+      row[x * 4 + 2] = 200;
+    }
+  }
+  // Potholes or litter.
+  const int patches = 1 + random->Below(3);
+  for (int p = 0; p < patches; ++p) {
+    const int cx = random->Below(image.width);
+    const int cy = image.height / 2 + random->Below(image.height / 2 + 1);
+    const int rx = image.width / 20 + random->Below(image.width / 10 + 1);
+    const int ry = rx / 2 + 1;
+    for (int y = std::max(0, cy - ry); y < std::min(image.height, cy + ry);
+         ++y) {
+      uint8_t* row = image.Row(y);
+      for (int x = std::max(0, cx - rx); x < std::min(image.width, cx + rx);
+           ++x) {
+        const double dx = static_cast<double>(x - cx) / rx;
+        const double dy = static_cast<double>(y - cy) / ry;
+        if (dx * dx + dy * dy <= 1.0) {
+          for (int c = 0; c < 3; ++c) {
+            row[x * 4 + c] = static_cast<uint8_t>(row[x * 4 + c] / 3);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Random::Random(uint64_t seed)
+    : state_(seed * 0x9e3779b97f4a7c15ULL + 0x2545f4914f6cdd1dULL) {
+  if (state_ == 0) {
+    state_ = 1;
+  }
+}
+
+uint64_t Random::Next() {
+  state_ ^= state_ << 13;
+  state_ ^= state_ >> 7;
+  state_ ^= state_ << 17;
+  return state_;
+}
+
+double Random::Uniform() {
+  return static_cast<double>(Next() >> 11) / 9007199254740992.0;
+}
+
+int Random::Below(int n) {
+  return n <= 0 ? 0 : static_cast<int>(Next() % static_cast<uint64_t>(n));
+}
+
+double Random::Exponential(double mean) {
+  return -std::log(1.0 - Uniform()) * mean;
+}
+
+PayloadGenerator::PayloadGenerator(const PayloadOptions& options)
+    : options_(options) {}
+
+bool PayloadGenerator::GenerateImages(std::string* error) {
+  Random random(options_.seed ^ 0x1234);
+  const int width = options_.image_width;
+  const int height = options_.image_height;
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  const RgbaImage image{pixels.data(), width, height,
+                        static_cast<size_t>(width) * 4};
+  images_.assign(std::max(options_.image_variants, 1), {});
+  for (std::vector<uint8_t>& jpeg : images_) {
+    PaintRoad(image, &random);
+    if (!EncodeJpeg(image, options_.image_quality, &jpeg)) {
+      *error = "JPEG encoding failed";
+      return false;
+    }
+  }
+  return true;
+}
+
+LatLng PayloadGenerator::RandomLocation(Random* random) const {
+  // Uniform over the disc: the distance goes with the square root.
+  const double distance = options_.radius_m * std::sqrt(random->Uniform());
+  const double bearing = 2 * kPi * random->Uniform();
+  const double degrees_per_m = 180.0 / (kPi * kEarthRadiusM);
+  const double latitude =
+      options_.center.latitude + distance * std::cos(bearing) * degrees_per_m;
+  const double longitude =
+      options_.center.longitude +
+      distance * std::sin(bearing) * degrees_per_m /
+          std::cos(options_.center.latitude * kPi / 180.0);
+  return LatLng{latitude, longitude};
+}
+
+std::string PayloadGenerator::ComplaintJson(
+    Random* random, const std::vector<std::string>& image_urls) const {
+  const CategoryText& text = kCategories[random->Below(ArraySize(kCategories))];
+  const LatLng location = RandomLocation(random);
+  char address[256];
+  snprintf(address, sizeof(address), "%d, %s, %s, Mumbai",
+           1 + random->Below(250), kStreets[random->Below(ArraySize(kStreets))],
+           kAreas[random->Below(ArraySize(kAreas))]);
+  std::string description = text.details[random->Below(3)];
+  description.append(" ").append(text.details[random->Below(3)]);
+
+  std::string json;
+  json.reserve(512 + image_urls.size() * 128);
+  char number[64];
+  json.append("{\"title\":\"")
+      .append(JsonEscape(text.titles[random->Below(3)]))
+      .append("\",\"description\":\"")
+      .append(JsonEscape(description))
+      .append("\",\"location_address\":\"")
+      .append(JsonEscape(address))
+      .append("\",\"landmark\":\"")
+      .append(JsonEscape(kLandmarks[random->Below(ArraySize(kLandmarks))]));
+  snprintf(number, sizeof(number), "\",\"latitude\":%.7f", location.latitude);
+  json.append(number);
+  snprintf(number, sizeof(number), ",\"longitude\":%.7f", location.longitude);
+  json.append(number);
+  json.append(",\"category\":\"").append(text.category).append("\"");
+  json.append(",\"images\":[");
+  for (size_t i = 0; i < image_urls.size(); ++i) {
+    json.append(i == 0 ? "\"" : ",\"")
+        .append(JsonEscape(image_urls[i]))
+        .append("\"");
+  }
+  // About one report in ten is anonymous.
+  json.append("],\"is_anonymous\":")
+      .append(random->Below(10) == 0 ? "true" : "false")
+      .append("}");
+  return json;
+}
+
+std::string PayloadGenerator::ImageUpload(
+    Random* random, const std::string& boundary,
+    const std::string& upload_preset) const {
+  const std::vector<uint8_t>& jpeg =
+      images_[random->Below(static_cast<int>(images_.size()))];
+  char filename[64];
+  snprintf(filename, sizeof(filename), "IMG_%08u.jpg",
+           static_cast<unsigned>(random->Next() % 100000000));
+  std::string body;
+  body.reserve(jpeg.size() + 512);
+  body.append("--").append(boundary).append("\r\n");
+  body.append(
+      "Content-Disposition: form-data; name=\"upload_preset\"\r\n\r\n");
+  body.append(upload_preset).append("\r\n");
+  body.append("--").append(boundary).append("\r\n");
+  body.append(
+      "Content-Disposition: form-data; name=\"folder\"\r\n\r\n"
+      "civic_connect/complaints\r\n");
+  body.append("--").append(boundary).append("\r\n");
+  body.append("Content-Disposition: form-data; name=\"file\"; filename=\"")
+      .append(filename)
+      .append("\"\r\nContent-Type: image/jpeg\r\n\r\n");
+  body.append(reinterpret_cast<const char*>(jpeg.data()), jpeg.size());
+  body.append("\r\n--").append(boundary).append("--\r\n");
+  return body;
+}
+
+size_t PayloadGenerator::image_bytes() const {
+  size_t total = 0;
+  for (const std::vector<uint8_t>& jpeg : images_) {
+    total += jpeg.size();
+  }
+  return total;
+}
+
+std::string JsonEscape(const std::string& text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    switch (c) {
+      case '"':
+        escaped.append("\\\"");
+        break;
+      case '\\':
+        escaped.append("\\\\");
+        break;
+      case '\n':
+        escaped.append("\\n");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char code[8];
+          snprintf(code, sizeof(code), "\\u%04x", c);
+          escaped.append(code);
+        } else {
+          escaped.push_back(c);
+        }
+    }
+  }
+  return escaped;
+}
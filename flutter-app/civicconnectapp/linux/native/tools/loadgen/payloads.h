@@ -0,0 +1,77 @@
+#ifndef NATIVE_TOOLS_LOADGEN_PAYLOADS_H_
+#define NATIVE_TOOLS_LOADGEN_PAYLOADS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A small, fast xorshift generator. Each worker owns one, seeded from the
+// run's seed, so runs with the same options send the same requests.
+class Random {
+ public:
+  explicit Random(uint64_t seed);
+
+  uint64_t Next();
+  // Uniform in [0, 1).
+  double Uniform();
+  // Uniform in [0, n).
+  int Below(int n);
+  // Exponentially distributed with the given mean.
+  double Exponential(double mean);
+
+ private:
+  uint64_t state_;
+};
+
+struct LatLng {
+  double latitude;
+  double longitude;
+};
+
+struct PayloadOptions {
+  // Complaints are spread uniformly over a disc around |center|. The default
+  // is south Mumbai, where the seeded wards are.
+  LatLng center = {18.9300, 72.8300};
+  double radius_m = 3000;
+  // Photos as image_picker returns them at imageQuality 80.
+  int image_width = 1600;
+  int image_height = 1200;
+  int image_quality = 80;
+  // Distinct photos generated; uploads cycle through them.
+  int image_variants = 8;
+  uint64_t seed = 1;
+};
+
+// Generates request bodies that look like the app's: complaint JSON as
+// ApiService.submitComplaint sends it, and JPEG photos of road surfaces as
+// multipart uploads in the shape CloudinaryService sends them.
+class PayloadGenerator {
+ public:
+  explicit PayloadGenerator(const PayloadOptions& options);
+
+  // Encodes the photo corpus. Returns false if JPEG encoding fails.
+  bool GenerateImages(std::string* error);
+
+  LatLng RandomLocation(Random* random) const;
+
+  // The POST /complaints body for a complaint with |image_urls|.
+  std::string ComplaintJson(Random* random,
+                            const std::vector<std::string>& image_urls) const;
+
+  // A multipart/form-data body uploading a random photo with
+  // |upload_preset|, delimited by |boundary|.
+  std::string ImageUpload(Random* random, const std::string& boundary,
+                          const std::string& upload_preset) const;
+
+  // Total size of the generated photos.
+  size_t image_bytes() const;
+
+ private:
+  const PayloadOptions options_;
+  std::vector<std::vector<uint8_t>> images_;
+};
+
+// Escapes |text| for use inside a JSON string literal.
+std::string JsonEscape(const std::string& text);
+
+#endif  // NATIVE_TOOLS_LOADGEN_PAYLOADS_H_
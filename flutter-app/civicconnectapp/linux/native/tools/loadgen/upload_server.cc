@@ -0,0 +1,304 @@
+#include "native/tools/loadgen/upload_server.h"
+
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "native/jpeg_codec.h"
+
+namespace {
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+// Cloudinary's free plan limit for images.
+constexpr size_t kMaxUploadBytes = 10 * 1024 * 1024;
+
+bool SendAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t result = send(fd, data.data() + written,
+                                data.size() - written, MSG_NOSIGNAL);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    written += static_cast<size_t>(result);
+  }
+  return true;
+}
+
+// Reads from |fd| until |buffer| holds at least |size| bytes.
+bool ReceiveAtLeast(int fd, size_t size, std::string* buffer) {
+  char chunk[65536];
+  while (buffer->size() < size) {
+    const ssize_t result = recv(fd, chunk, sizeof(chunk), 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    buffer->append(chunk, static_cast<size_t>(result));
+  }
+  return true;
+}
+
+// Returns the value of header |name| (lower case, with the colon) in the
+// header block |headers|, or an empty string.
+std::string HeaderValue(const std::string& headers, const char* name) {
+  const size_t length = strlen(name);
+  size_t line = headers.find("\r\n");
+  while (line != std::string::npos && line + 2 < headers.size()) {
+    const size_t start = line + 2;
+    line = headers.find("\r\n", start);
+    const size_t end = line == std::string::npos ? headers.size() : line;
+    if (end - start > length &&
+        strncasecmp(headers.c_str() + start, name, length) == 0) {
+      size_t value = start + length;
+      while (value < end && headers[value] == ' ') {
+        ++value;
+      }
+      return headers.substr(value, end - value);
+    }
+  }
+  return std::string();
+}
+
+std::string JsonResponse(int status, const char* reason,
+                         const std::string& json) {
+  std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                         "\r\nContent-Type: application/json\r\n"
+                         "Content-Length: " +
+                         std::to_string(json.size()) + "\r\n\r\n";
+  response.append(json);
+  return response;
+}
+
+std::string ErrorResponse(int status, const char* reason,
+                          const char* message) {
+  return JsonResponse(status, reason,
+                      std::string("{\"error\":{\"message\":\"") + message +
+                          "\"}}");
+}
+
+}  // namespace
+
+UploadServer::UploadServer(int delay_ms) : delay_ms_(delay_ms) {}
+
+UploadServer::~UploadServer() { Stop(); }
+
+bool UploadServer::Start(int port, std::string* error) {
+  listen_fd_ = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    *error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  const int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  const int zero = 0;
+  setsockopt(listen_fd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+  sockaddr_in6 address = {};
+  address.sin6_family = AF_INET6;
+  address.sin6_addr = in6addr_any;
+  address.sin6_port = htons(static_cast<uint16_t>(port));
+  socklen_t length = sizeof(address);
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+      listen(listen_fd_, 512) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                  &length) != 0) {
+    *error = "port " + std::to_string(port) + ": " + strerror(errno);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  port_ = ntohs(address.sin6_port);
+  accept_thread_ = std::thread(&UploadServer::AcceptLoop, this);
+  return true;
+}
+
+void UploadServer::Stop() {
+  if (listen_fd_ < 0) {
+    return;
+  }
+  stopping_.store(true);
+  // shutdown() wakes the blocked accept() and recv() calls.
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const int fd : connections_) {
+    shutdown(fd, SHUT_RDWR);
+  }
+  connections_closed_.wait(lock, [this] { return connections_.empty(); });
+}
+
+void UploadServer::AcceptLoop() {
+  while (!stopping_.load()) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_.load()) {
+      close(fd);
+      return;
+    }
+    connections_.push_back(fd);
+    std::thread(&UploadServer::Serve, this, fd).detach();
+  }
+}
+
+void UploadServer::Serve(int fd) {
+  std::string buffer;
+  while (!stopping_.load()) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (buffer.size() > kMaxHeaderBytes ||
+          !ReceiveAtLeast(fd, buffer.size() + 1, &buffer)) {
+        header_end = std::string::npos;
+        break;
+      }
+    }
+    if (header_end == std::string::npos) {
+      break;
+    }
+    const std::string headers = buffer.substr(0, header_end + 2);
+    buffer.erase(0, header_end + 4);
+
+    // "POST /v1_1/local/image/upload HTTP/1.1"
+    const size_t method_end = headers.find(' ');
+    const size_t path_end = headers.find(' ', method_end + 1);
+    if (method_end == std::string::npos || path_end == std::string::npos) {
+      SendAll(fd, ErrorResponse(400, "Bad Request", "Malformed request"));
+      break;
+    }
+    const std::string method = headers.substr(0, method_end);
+    const std::string path =
+        headers.substr(method_end + 1, path_end - method_end - 1);
+    const bool http10 = headers.compare(path_end + 1, 8, "HTTP/1.0") == 0;
+    const std::string connection = HeaderValue(headers, "connection:");
+    const bool keep_alive =
+        http10 ? strcasecmp(connection.c_str(), "keep-alive") == 0
+               : strcasecmp(connection.c_str(), "close") != 0;
+    const size_t content_length =
+        strtoull(HeaderValue(headers, "content-length:").c_str(), nullptr, 10);
+    if (content_length > kMaxUploadBytes) {
+      SendAll(fd, ErrorResponse(413, "Payload Too Large",
+                                "File size too large"));
+      break;
+    }
+    if (strcasecmp(HeaderValue(headers, "expect:").c_str(), "100-continue") ==
+            0 &&
+        !SendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+      break;
+    }
+    if (!ReceiveAtLeast(fd, content_length, &buffer)) {
+      break;
+    }
+    const std::string body = buffer.substr(0, content_length);
+    buffer.erase(0, content_length);
+
+    const std::string response =
+        Respond(method, path, HeaderValue(headers, "host:"),
+                HeaderValue(headers, "content-type:"), body);
+    if (!SendAll(fd, response) || !keep_alive) {
+      break;
+    }
+  }
+
+  // Notified under the lock: once Stop() sees the list empty it may destroy
+  // the server.
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_.erase(std::find(connections_.begin(), connections_.end(), fd));
+  close(fd);
+  connections_closed_.notify_all();
+}
+
+std::string UploadServer::Respond(const std::string& method,
+                                  const std::string& path,
+                                  const std::string& host,
+                                  const std::string& content_type,
+                                  const std::string& body) {
+  // "/v1_1/<cloud>/image/upload"
+  const char kPrefix[] = "/v1_1/";
+  const char kSuffix[] = "/image/upload";
+  const size_t suffix_length = sizeof(kSuffix) - 1;
+  if (path.compare(0, sizeof(kPrefix) - 1, kPrefix) != 0 ||
+      path.size() <= sizeof(kPrefix) - 1 + suffix_length ||
+      path.compare(path.size() - suffix_length, suffix_length, kSuffix) != 0) {
+    return ErrorResponse(404, "Not Found", "Not found");
+  }
+  if (method != "POST") {
+    return ErrorResponse(405, "Method Not Allowed", "Method not allowed");
+  }
+  const size_t boundary_at = content_type.find("boundary=");
+  if (content_type.compare(0, 19, "multipart/form-data") != 0 ||
+      boundary_at == std::string::npos) {
+    return ErrorResponse(400, "Bad Request", "Expected multipart/form-data");
+  }
+  std::string boundary = content_type.substr(boundary_at + 9);
+  if (boundary.size() >= 2 && boundary.front() == '"') {
+    boundary = boundary.substr(1, boundary.size() - 2);
+  }
+
+  // Find the "file" part and its contents.
+  const size_t part = body.find("name=\"file\"");
+  const size_t file_begin =
+      part == std::string::npos ? part : body.find("\r\n\r\n", part);
+  const size_t file_end =
+      file_begin == std::string::npos
+          ? file_begin
+          : body.find("\r\n--" + boundary, file_begin + 4);
+  if (file_end == std::string::npos) {
+    return ErrorResponse(400, "Bad Request",
+                         "Missing required parameter - file");
+  }
+  const uint8_t* file =
+      reinterpret_cast<const uint8_t*>(body.data()) + file_begin + 4;
+  const size_t file_size = file_end - file_begin - 4;
+  int width = 0;
+  int height = 0;
+  if (!ReadJpegSize(file, file_size, &width, &height)) {
+    return ErrorResponse(400, "Bad Request", "Invalid image file");
+  }
+
+  if (delay_ms_ > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+  }
+  const uint64_t id = uploads_.fetch_add(1, std::memory_order_relaxed) + 1;
+  const long long version =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  const std::string cloud_path =
+      path.substr(0, path.size() - sizeof("/upload") + 1);
+  char public_id[64];
+  snprintf(public_id, sizeof(public_id), "civic_connect/complaints/load%010llu",
+           static_cast<unsigned long long>(id));
+  const std::string url = "http://" + (host.empty() ? "localhost" : host) +
+                          cloud_path + "/upload/v" + std::to_string(version) +
+                          "/" + public_id + ".jpg";
+
+  char json[1024];
+  snprintf(json, sizeof(json),
+           "{\"public_id\":\"%s\",\"version\":%lld,\"width\":%d,"
+           "\"height\":%d,\"format\":\"jpg\",\"resource_type\":\"image\","
+           "\"bytes\":%zu,\"url\":\"%s\",\"secure_url\":\"%s\"}",
+           public_id, version, width, height, file_size, url.c_str(),
+           url.c_str());
+  return JsonResponse(200, "OK", json);
+}
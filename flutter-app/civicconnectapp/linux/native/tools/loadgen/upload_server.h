@@ -0,0 +1,61 @@
+#ifndef NATIVE_TOOLS_LOADGEN_UPLOAD_SERVER_H_
+#define NATIVE_TOOLS_LOADGEN_UPLOAD_SERVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A local stand-in for Cloudinary's unsigned upload endpoint, so the whole
+// submit flow can be load tested on one machine without touching the real
+// account. Accepts POST /v1_1/<cloud>/image/upload with a multipart body
+// holding a "file" part and answers with the fields CloudinaryService reads
+// (secure_url) plus the usual metadata. Uploaded bytes are discarded.
+//
+// The app can be pointed at it with
+//   --dart-define=CLOUDINARY_UPLOAD_URL=http://<host>:<port>/v1_1/local/image/upload
+class UploadServer {
+ public:
+  // |delay_ms| is added to every upload to stand in for Cloudinary's own
+  // processing time.
+  explicit UploadServer(int delay_ms);
+  ~UploadServer();
+
+  UploadServer(const UploadServer&) = delete;
+  UploadServer& operator=(const UploadServer&) = delete;
+
+  // Listens on |port| on all interfaces, or on an ephemeral port if |port| is
+  // 0. Returns false with |error| set if the socket cannot be bound.
+  bool Start(int port, std::string* error);
+  // Closes the listening socket and all connections and waits for them.
+  void Stop();
+
+  int port() const { return port_; }
+  uint64_t uploads() const { return uploads_.load(std::memory_order_relaxed); }
+
+ private:
+  void AcceptLoop();
+  void Serve(int fd);
+  // Builds the response to one request.
+  std::string Respond(const std::string& method, const std::string& path,
+                      const std::string& host, const std::string& content_type,
+                      const std::string& body);
+
+  const int delay_ms_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> uploads_{0};
+  std::thread accept_thread_;
+
+  // Each connection is served by a detached thread, which removes its fd from
+  // |connections_| and signals |connections_closed_| as its last step.
+  std::mutex mutex_;
+  std::condition_variable connections_closed_;
+  std::vector<int> connections_;  // Guarded by |mutex_|.
+};
+
+#endif  // NATIVE_TOOLS_LOADGEN_UPLOAD_SERVER_H_
@@ -0,0 +1,198 @@
+// Compares two memtrace snapshots (see native/memtrace.h) of the same run:
+//
+//   memtrace_diff [--top 30] before.txt after.txt
+//
+// Prints the change in smaps_rollup and heap totals, live bytes per subsystem
+// tag and the call sites whose live bytes changed most. Growth in RSS that the
+// heap totals do not account for is outside malloc: the Dart heap, GPU
+// buffers, thread stacks or mapped files.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct SiteEntry {
+  int64_t live_bytes = 0;
+  int64_t count = 0;
+  std::string tag;
+  std::string frames;
+};
+
+struct Snapshot {
+  int64_t time_ms = 0;
+  // "smaps" and "heap" fields, by "<line>.<field>".
+  std::map<std::string, int64_t> totals;
+  std::map<std::string, int64_t> tags;
+  std::map<std::string, SiteEntry> sites;
+};
+
+bool ReadSnapshot(const char* path, Snapshot* snapshot) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  if (!std::getline(file, line) || line != "memtrace 1") {
+    return false;
+  }
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string kind;
+    fields >> kind;
+    if (kind == "time_ms") {
+      fields >> snapshot->time_ms;
+    } else if (kind == "smaps" || kind == "heap") {
+      std::string name;
+      int64_t value;
+      while (fields >> name >> value) {
+        snapshot->totals[kind + "." + name] = value;
+      }
+    } else if (kind == "tag") {
+      std::string name;
+      int64_t bytes = 0;
+      fields >> name >> bytes;
+      snapshot->tags[name] = bytes;
+    } else if (kind == "site") {
+      std::string key;
+      SiteEntry site;
+      fields >> key >> site.live_bytes >> site.count >> site.tag;
+      fields >> std::ws;
+      std::getline(fields, site.frames);
+      snapshot->sites[key] = site;
+    }
+  }
+  return true;
+}
+
+// Formats a signed byte count, or a kB count when |unit| is "kB".
+std::string FormatDelta(int64_t value, const std::string& unit) {
+  char text[64];
+  const double kib = unit == "kB" ? static_cast<double>(value)
+                                  : static_cast<double>(value) / 1024;
+  if (kib >= 1024 || kib <= -1024) {
+    snprintf(text, sizeof(text), "%+.1f MiB", kib / 1024);
+  } else {
+    snprintf(text, sizeof(text), "%+.1f KiB", kib);
+  }
+  return text;
+}
+
+struct Change {
+  std::string name;
+  int64_t before;
+  int64_t after;
+  int64_t delta() const { return after - before; }
+};
+
+// Pairs up the entries of two maps, treating missing entries as zero, ordered
+// by the size of the change.
+std::vector<Change> Changes(const std::map<std::string, int64_t>& before,
+                            const std::map<std::string, int64_t>& after) {
+  std::vector<Change> changes;
+  for (const auto& entry : before) {
+    auto it = after.find(entry.first);
+    changes.push_back(Change{entry.first, entry.second,
+                             it == after.end() ? 0 : it->second});
+  }
+  for (const auto& entry : after) {
+    if (before.find(entry.first) == before.end()) {
+      changes.push_back(Change{entry.first, 0, entry.second});
+    }
+  }
+  std::stable_sort(changes.begin(), changes.end(),
+                   [](const Change& a, const Change& b) {
+                     return std::llabs(a.delta()) > std::llabs(b.delta());
+                   });
+  return changes;
+}
+
+void PrintUsage() {
+  fprintf(stderr, "usage: memtrace_diff [--top N] before.txt after.txt\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int top = 30;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+      top = std::max(atoi(argv[++i]), 1);
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    PrintUsage();
+    return 2;
+  }
+  Snapshot before;
+  Snapshot after;
+  for (int i = 0; i < 2; ++i) {
+    if (!ReadSnapshot(paths[i], i == 0 ? &before : &after)) {
+      fprintf(stderr, "error: %s is not a memtrace snapshot\n", paths[i]);
+      return 1;
+    }
+  }
+
+  printf("interval %.1f s\n\n", (after.time_ms - before.time_ms) / 1000.0);
+  printf("%-28s %14s %14s %14s\n", "total", "before", "after", "change");
+  // Totals are listed by name rather than by change.
+  for (const auto& entry : after.totals) {
+    const auto it = before.totals.find(entry.first);
+    const int64_t old_value = it == before.totals.end() ? 0 : it->second;
+    const bool kilobytes =
+        entry.first.size() > 3 &&
+        entry.first.compare(entry.first.size() - 3, 3, "_kb") == 0;
+    if (entry.first == "heap.dropped_samples") {
+      printf("%-28s %14" PRId64 " %14" PRId64 " %+14" PRId64 "\n",
+             entry.first.c_str(), old_value, entry.second,
+             entry.second - old_value);
+      continue;
+    }
+    printf("%-28s %14" PRId64 " %14" PRId64 " %14s\n", entry.first.c_str(),
+           old_value, entry.second,
+           FormatDelta(entry.second - old_value, kilobytes ? "kB" : "B")
+               .c_str());
+  }
+
+  printf("\n%-28s %14s %14s %14s\n", "tag", "before", "after", "change");
+  for (const Change& change : Changes(before.tags, after.tags)) {
+    printf("%-28s %14" PRId64 " %14" PRId64 " %14s\n", change.name.c_str(),
+           change.before, change.after,
+           FormatDelta(change.delta(), "B").c_str());
+  }
+
+  std::map<std::string, int64_t> before_sites;
+  std::map<std::string, int64_t> after_sites;
+  for (const auto& site : before.sites) {
+    before_sites[site.first] = site.second.live_bytes;
+  }
+  for (const auto& site : after.sites) {
+    after_sites[site.first] = site.second.live_bytes;
+  }
+  // Snapshots only list their largest sites, so a site missing from one side
+  // may just have been below the cut there.
+  printf("\nsites by change in live bytes\n");
+  int printed = 0;
+  for (const Change& change : Changes(before_sites, after_sites)) {
+    if (printed++ == top || change.delta() == 0) {
+      break;
+    }
+    auto it = after.sites.find(change.name);
+    const SiteEntry& site =
+        it != after.sites.end() ? it->second : before.sites[change.name];
+    printf("%14s  %s  %s\n    %s\n", FormatDelta(change.delta(), "B").c_str(),
+           change.name.c_str(), site.tag.c_str(), site.frames.c_str());
+  }
+  return 0;
+}
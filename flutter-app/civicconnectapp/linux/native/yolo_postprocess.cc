@@ -0,0 +1,101 @@
+#include "native/yolo_postprocess.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+struct Candidate {
+  BoundingBox box;
+  float score;
+  int class_id;
+};
+
+}  // namespace
+
+float BoxIou(const BoundingBox& a, const BoundingBox& b) {
+  const float width = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+  const float height = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+  if (width <= 0.0f || height <= 0.0f) {
+    return 0.0f;
+  }
+  const float intersection = width * height;
+  const float area_a = a.width() * a.height();
+  const float area_b = b.width() * b.height();
+  return intersection / (area_a + area_b - intersection);
+}
+
+void ParseYoloDetections(const YoloOutput& output,
+                         const YoloParseOptions& options, TensorArena* arena,
+                         std::vector<Detection>* detections) {
+  detections->clear();
+  const size_t anchors = output.anchors;
+  const float* cx = output.data;
+  const float* cy = cx + anchors;
+  const float* w = cy + anchors;
+  const float* h = w + anchors;
+  const float* scores = h + anchors;
+
+  // Best class per anchor, scanning one class row at a time so every pass is
+  // a contiguous read of the channel-major tensor.
+  float* best_score = arena->AllocateArray<float>(anchors);
+  int* best_class = arena->AllocateArray<int>(anchors);
+  std::copy(scores, scores + anchors, best_score);
+  std::fill(best_class, best_class + anchors, 0);
+  for (int c = 1; c < output.num_classes; ++c) {
+    const float* row = scores + c * anchors;
+    for (size_t i = 0; i < anchors; ++i) {
+      if (row[i] > best_score[i]) {
+        best_score[i] = row[i];
+        best_class[i] = c;
+      }
+    }
+  }
+
+  Candidate* candidates = arena->AllocateArray<Candidate>(anchors);
+  size_t count = 0;
+  for (size_t i = 0; i < anchors; ++i) {
+    if (best_score[i] <= options.conf_threshold) {
+      continue;
+    }
+    Candidate& candidate = candidates[count++];
+    candidate.box.x1 = cx[i] - w[i] / 2;
+    candidate.box.y1 = cy[i] - h[i] / 2;
+    candidate.box.x2 = cx[i] + w[i] / 2;
+    candidate.box.y2 = cy[i] + h[i] / 2;
+    candidate.score = best_score[i];
+    candidate.class_id = best_class[i];
+  }
+  std::sort(candidates, candidates + count,
+            [](const Candidate& a, const Candidate& b) {
+              return a.score > b.score;
+            });
+
+  bool* suppressed = arena->AllocateArray<bool>(count);
+  std::fill(suppressed, suppressed + count, false);
+  for (size_t i = 0; i < count; ++i) {
+    if (suppressed[i]) {
+      continue;
+    }
+    const Candidate& kept = candidates[i];
+    for (size_t j = i + 1; j < count; ++j) {
+      if (!suppressed[j] &&
+          BoxIou(kept.box, candidates[j].box) > options.iou_threshold) {
+        suppressed[j] = true;
+      }
+    }
+
+    Detection detection;
+    detection.class_id = kept.class_id;
+    detection.class_name =
+        options.class_name_count > 0
+            ? options.class_names[kept.class_id % options.class_name_count]
+            : "";
+    detection.confidence = kept.score;
+    detection.box.x1 = kept.box.x1 * options.scale_x;
+    detection.box.y1 = kept.box.y1 * options.scale_y;
+    detection.box.x2 = kept.box.x2 * options.scale_x;
+    detection.box.y2 = kept.box.y2 * options.scale_y;
+    detections->push_back(detection);
+  }
+}
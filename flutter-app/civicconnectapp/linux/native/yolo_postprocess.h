@@ -0,0 +1,46 @@
+#ifndef NATIVE_YOLO_POSTPROCESS_H_
+#define NATIVE_YOLO_POSTPROCESS_H_
+
+#include <vector>
+
+#include "native/image_types.h"
+#include "native/tensor_arena.h"
+
+// A YOLOv8 output tensor without its batch dimension: |channels| rows of
+// |anchors| values, where rows 0-3 are the box centre and size and the next
+// |num_classes| rows are class scores. Segmentation models append mask
+// coefficients after the class scores; they are ignored here.
+struct YoloOutput {
+  const float* data;
+  int channels;
+  int anchors;
+  int num_classes;
+};
+
+struct YoloParseOptions {
+  float conf_threshold = 0.25f;
+  float iou_threshold = 0.45f;
+  // Factors mapping model input coordinates to original image coordinates.
+  float scale_x = 1.0f;
+  float scale_y = 1.0f;
+  // Class ids are mapped to names modulo |class_name_count|, as in
+  // CivicInference._parse_detections.
+  const char* const* class_names = nullptr;
+  int class_name_count = 0;
+};
+
+// Decodes |output| into |detections|, replacing its contents: thresholds on
+// the best class score, converts boxes to corner format, applies greedy
+// class-agnostic NMS and scales to the original image. Detections are ordered
+// by descending confidence.
+//
+// Temporaries come from |arena|; |detections| is reused, so parsing into the
+// same vector does not allocate once its capacity has grown to fit.
+void ParseYoloDetections(const YoloOutput& output,
+                         const YoloParseOptions& options, TensorArena* arena,
+                         std::vector<Detection>* detections);
+
+// Intersection over union of two corner-format boxes.
+float BoxIou(const BoundingBox& a, const BoundingBox& b);
+
+#endif  // NATIVE_YOLO_POSTPROCESS_H_
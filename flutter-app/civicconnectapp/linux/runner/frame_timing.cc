@@ -0,0 +1,122 @@
+#include "frame_timing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "native/frame_timing.h"
+#include "native/metrics.h"
+
+// Created on first start and never destroyed, so Dart may query it from the
+// UI thread at any time, including during shutdown.
+static std::atomic<FrameTimingMonitor*> monitor(nullptr);
+
+static GdkFrameClock* frame_clock = nullptr;
+static gulong after_paint_handler = 0;
+static guint heartbeat_source = 0;
+static guint64 start_time_ns = 0;
+
+static guint64 monotonic_ns() {
+  return static_cast<guint64>(g_get_monotonic_time()) * 1000;
+}
+
+// Called once per painted frame of the window.
+static void after_paint_cb(GdkFrameClock* clock, gpointer user_data) {
+  FrameTimingMonitor* self = static_cast<FrameTimingMonitor*>(user_data);
+  const gint64 frame_time = gdk_frame_clock_get_frame_time(clock);
+  gint64 refresh_interval = 0;
+  gdk_frame_clock_get_refresh_info(clock, frame_time, &refresh_interval,
+                                   nullptr);
+  self->OnFrame(static_cast<uint64_t>(frame_time) * 1000,
+                static_cast<uint64_t>(refresh_interval) * 1000);
+}
+
+static gboolean heartbeat_cb(gpointer user_data) {
+  static_cast<FrameTimingMonitor*>(user_data)->OnMainLoopHeartbeat(
+      monotonic_ns());
+  return G_SOURCE_CONTINUE;
+}
+
+// Records how long the engine took to render the first frame.
+static void first_frame_cb(FlView* view, gpointer user_data) {
+  Histogram* histogram = MetricsRegistry::Get()->GetHistogram(
+      "first_frame_seconds",
+      "Time from creating the Flutter view to its first rendered frame.");
+  if (histogram != nullptr) {
+    histogram->Record(monotonic_ns() - start_time_ns);
+  }
+}
+
+void frame_timing_start(GtkWindow* window, FlView* view) {
+  if (heartbeat_source != 0) {
+    return;
+  }
+  FrameTimingMonitor* self = monitor.load();
+  if (self == nullptr) {
+    self = new FrameTimingMonitor(FrameTimingOptions());
+    monitor.store(self);
+  }
+  start_time_ns = monotonic_ns();
+
+  frame_clock = gtk_widget_get_frame_clock(GTK_WIDGET(window));
+  if (frame_clock != nullptr) {
+    g_object_ref(frame_clock);
+    after_paint_handler = g_signal_connect(frame_clock, "after-paint",
+                                           G_CALLBACK(after_paint_cb), self);
+  } else {
+    g_warning("Window has no frame clock, frame timing is disabled");
+  }
+
+  // Older engines do not have this signal.
+  if (g_signal_lookup("first-frame", G_OBJECT_TYPE(view)) != 0) {
+    g_signal_connect(view, "first-frame", G_CALLBACK(first_frame_cb), nullptr);
+  }
+
+  heartbeat_source =
+      g_timeout_add(FrameTimingOptions().heartbeat_interval.count(),
+                    heartbeat_cb, self);
+  self->Start();
+}
+
+void frame_timing_stop(const gchar* dump_path) {
+  FrameTimingMonitor* self = monitor.load();
+  if (self == nullptr) {
+    return;
+  }
+  if (heartbeat_source != 0) {
+    g_source_remove(heartbeat_source);
+    heartbeat_source = 0;
+  }
+  if (frame_clock != nullptr) {
+    g_signal_handler_disconnect(frame_clock, after_paint_handler);
+    g_clear_object(&frame_clock);
+  }
+  self->Stop();
+
+  if (dump_path == nullptr) {
+    return;
+  }
+  const std::string json = self->Summarize().ToJson();
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_set_contents(dump_path, json.c_str(), json.size(), &error)) {
+    g_warning("Failed to write frame timing summary: %s", error->message);
+  }
+}
+
+// Writes the frame timing summary as JSON to |buffer| and returns its length.
+// Nothing is written if |capacity| is not larger than that length, so callers
+// can retry with a bigger buffer. Returns -1 before monitoring starts.
+extern "C" __attribute__((visibility("default"), used)) int32_t
+civic_frame_timing_summary(char* buffer, int32_t capacity) {
+  FrameTimingMonitor* self = monitor.load();
+  if (self == nullptr) {
+    return -1;
+  }
+  const std::string json = self->Summarize().ToJson();
+  const int32_t length = static_cast<int32_t>(json.size());
+  if (buffer != nullptr && capacity > length) {
+    memcpy(buffer, json.c_str(), json.size() + 1);
+  }
+  return length;
+}
@@ -0,0 +1,25 @@
+#ifndef FLUTTER_FRAME_TIMING_H_
+#define FLUTTER_FRAME_TIMING_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+/**
+ * frame_timing_start:
+ * @window: the application window, already realized.
+ * @view: the #FlView shown in @window.
+ *
+ * Starts recording frame intervals from the frame clock of @window and
+ * main-loop stalls. Must be called on the main thread.
+ */
+void frame_timing_start(GtkWindow* window, FlView* view);
+
+/**
+ * frame_timing_stop:
+ * @dump_path: (nullable): file to write a JSON summary to.
+ *
+ * Stops recording and writes the summary, if a path is given.
+ */
+void frame_timing_stop(const gchar* dump_path);
+
+#endif  // FLUTTER_FRAME_TIMING_H_
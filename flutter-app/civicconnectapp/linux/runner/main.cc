@@ -1,6 +1,64 @@
 #include "my_application.h"
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char kMemtraceLibrary[] = "libcivicconnect_memtrace.so";
+
+// When CIVICCONNECT_MEMTRACE is set, restarts the runner with the bundled
+// allocation tracer preloaded, since it has to replace malloc before anything
+// allocates. Child processes such as file dialogs are started without it.
+static void preload_memtrace(char** argv) {
+  const gchar* setting = g_getenv("CIVICCONNECT_MEMTRACE");
+  if (setting == nullptr || setting[0] == '\0') {
+    return;
+  }
+
+  const gchar* preload = g_getenv("LD_PRELOAD");
+  if (preload != nullptr && strstr(preload, kMemtraceLibrary) != nullptr) {
+    g_auto(GStrv) entries = g_strsplit(preload, ":", -1);
+    g_autoptr(GPtrArray) kept = g_ptr_array_new();
+    for (gchar** entry = entries; *entry != nullptr; ++entry) {
+      if (**entry != '\0' && strstr(*entry, kMemtraceLibrary) == nullptr) {
+        g_ptr_array_add(kept, *entry);
+      }
+    }
+    g_ptr_array_add(kept, nullptr);
+    g_autofree gchar* rest =
+        g_strjoinv(":", reinterpret_cast<gchar**>(kept->pdata));
+    if (rest[0] == '\0') {
+      g_unsetenv("LD_PRELOAD");
+    } else {
+      g_setenv("LD_PRELOAD", rest, TRUE);
+    }
+    return;
+  }
+
+  g_autofree gchar* executable = g_file_read_link("/proc/self/exe", nullptr);
+  if (executable == nullptr) {
+    return;
+  }
+  g_autofree gchar* directory = g_path_get_dirname(executable);
+  g_autofree gchar* library =
+      g_build_filename(directory, "lib", kMemtraceLibrary, nullptr);
+  if (!g_file_test(library, G_FILE_TEST_EXISTS)) {
+    g_warning("CIVICCONNECT_MEMTRACE is set but %s is missing", library);
+    return;
+  }
+  g_autofree gchar* value =
+      preload != nullptr && preload[0] != '\0'
+          ? g_strconcat(library, ":", preload, nullptr)
+          : g_strdup(library);
+  g_setenv("LD_PRELOAD", value, TRUE);
+  execv(executable, argv);
+  g_warning("Failed to restart with the allocation tracer: %s",
+            g_strerror(errno));
+}
+
 int main(int argc, char** argv) {
+  preload_memtrace(argv);
+
   g_autoptr(MyApplication) app = my_application_new();
   return g_application_run(G_APPLICATION(app), argc, argv);
 }
@@ -0,0 +1,55 @@
+// C entry points into the native metrics registry for Dart, looked up with
+// DynamicLibrary.process(). The runner is linked with ENABLE_EXPORTS so these
+// symbols are visible to the Dart VM.
+//
+// Handles are registry ids; a negative handle means registration failed and
+// every call taking one is then a no-op, so Dart never has to check.
+
+#include <cstdint>
+
+#include "native/metrics.h"
+
+#define CIVIC_METRICS_EXPORT \
+  extern "C" __attribute__((visibility("default"), used))
+
+CIVIC_METRICS_EXPORT int32_t civic_metrics_histogram(const char* name,
+                                                     const char* help) {
+  Histogram* histogram =
+      MetricsRegistry::Get()->GetHistogram(name, help != nullptr ? help : "");
+  return histogram != nullptr ? histogram->id() : -1;
+}
+
+CIVIC_METRICS_EXPORT int32_t civic_metrics_counter(const char* name,
+                                                   const char* help) {
+  Counter* counter =
+      MetricsRegistry::Get()->GetCounter(name, help != nullptr ? help : "");
+  return counter != nullptr ? counter->id() : -1;
+}
+
+CIVIC_METRICS_EXPORT void civic_metrics_record(int32_t histogram,
+                                               int64_t value_ns) {
+  if (Histogram* h = MetricsRegistry::Get()->HistogramById(histogram)) {
+    h->Record(value_ns > 0 ? static_cast<uint64_t>(value_ns) : 0);
+  }
+}
+
+CIVIC_METRICS_EXPORT void civic_metrics_increment(int32_t counter,
+                                                  int64_t delta) {
+  if (Counter* c = MetricsRegistry::Get()->CounterById(counter)) {
+    c->Increment(delta > 0 ? static_cast<uint64_t>(delta) : 0);
+  }
+}
+
+// Returns the value at quantile |q| in nanoseconds, or -1 for a bad handle.
+CIVIC_METRICS_EXPORT int64_t civic_metrics_quantile(int32_t histogram,
+                                                    double q) {
+  Histogram* h = MetricsRegistry::Get()->HistogramById(histogram);
+  if (h == nullptr) {
+    return -1;
+  }
+  return static_cast<int64_t>(h->Snapshot().ValueAtQuantile(q));
+}
+
+CIVIC_METRICS_EXPORT int64_t civic_metrics_now_ns() {
+  return static_cast<int64_t>(MetricsNowNs());
+}
@@ -6,10 +6,13 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#include "frame_timing.h"
+#include "native/metrics.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  MetricsExporter* metrics_exporter;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
@@ -59,6 +62,9 @@ static void my_application_activate(GApplication* application) {
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
 
+  // The window is realized by gtk_widget_show(), so it has a frame clock.
+  frame_timing_start(window, view);
+
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
@@ -83,18 +89,39 @@ static gboolean my_application_local_command_line(GApplication* application, gch
 
 // Implements GApplication::startup.
 static void my_application_startup(GApplication* application) {
-  //MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
 
-  // Perform any actions required at application startup.
+  // Dump latency histograms and counters recorded by Dart and native code to
+  // ~/.cache/civicconnect/metrics.prom.
+  g_autofree gchar* metrics_dir =
+      g_build_filename(g_get_user_cache_dir(), "civicconnect", nullptr);
+  if (g_mkdir_with_parents(metrics_dir, 0700) == 0) {
+    g_autofree gchar* metrics_path =
+        g_build_filename(metrics_dir, "metrics.prom", nullptr);
+    MetricsExporterOptions options;
+    options.path = metrics_path;
+    self->metrics_exporter =
+        new MetricsExporter(MetricsRegistry::Get(), options);
+    self->metrics_exporter->Start();
+  } else {
+    g_warning("Failed to create %s, metrics will not be exported",
+              metrics_dir);
+  }
 
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
 }
 
 // Implements GApplication::shutdown.
 static void my_application_shutdown(GApplication* application) {
-  //MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
+
+  g_autofree gchar* frame_timing_path = g_build_filename(
+      g_get_user_cache_dir(), "civicconnect", "frame_timing.json", nullptr);
+  frame_timing_stop(frame_timing_path);
 
-  // Perform any actions required at application shutdown.
+  // Writes a final snapshot.
+  delete self->metrics_exporter;
+  self->metrics_exporter = nullptr;
 
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }